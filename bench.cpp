@@ -0,0 +1,1015 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#include "bench.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/fixed_point.hpp"
+#include "gamma/fixed_point_batch.hpp"
+#include "gamma/fixed_point_math.hpp"
+#include "gamma/transform/translation.hpp"
+#include "gamma/transform/x_rotation.hpp"
+#include "gamma/transform/y_rotation.hpp"
+#include "gamma/transform/z_rotation.hpp"
+#include "gamma/transform/axial_rotation.hpp"
+#include "gamma/transform/orthogonal.hpp"
+#include "gamma/transform/lookat.hpp"
+#include "gamma/mvp.hpp"
+#include "gamma/mvp_batch.hpp"
+#include "gamma/quaternion.hpp"
+#include "gamma/frustum.hpp"
+#include "gamma/expression.hpp"
+#include "gamma/vector_batch.hpp"
+#include "gamma/bvh.hpp"
+#include "gamma/intersect_batch.hpp"
+#include "gamma/broad_phase.hpp"
+#include "gamma/aligned.hpp"
+#include "gamma/binary.hpp"
+#include "gamma/hierarchy.hpp"
+#include "gamma/skinning.hpp"
+#include "gamma/packed.hpp"
+#include "gamma/stream.hpp"
+#include "gamma/transform/perspective.hpp"
+#include <sstream>
+
+using namespace gma;
+
+typedef fixed_point<16,16> fixed16_16;
+typedef fixed_point<24,8> fixed24_8;
+typedef fixed_point<32,32> fixed32_32;
+
+/// Number of distinct operands each benchmark cycles through. Must be a power
+/// of two.
+const size_t N = 256;
+
+/// Generates a non-zero test value of magnitude 1 to 7.5 from a seed.
+template <typename T> T value(int i) { return T((i % 2 ? -1 : 1) * ((i*7) % 13 + 2) * 0.5); }
+
+/// Fills all scalars of a vector or matrix with test values.
+template <typename V> void fill(V& v, int seed)
+{
+	typedef typename V::type T;
+	T* p = (T*)&v;
+	for (size_t i = 0; i < sizeof(V)/sizeof(T); ++i)
+		p[i] = value<T>(seed + (int)i);
+}
+template <int Ia, int Da> void fill(fixed_point<Ia,Da>& v, int seed) { v = value<fixed_point<Ia,Da> >(seed); }
+template <typename T> void fill(quaternion<T>& q, int seed)
+{
+	vector3<T> axis(value<T>(seed), value<T>(seed+1), value<T>(seed+2));
+	q = quaternion<T>::axis_angle(axis.normalized(), value<T>(seed+3));
+}
+inline void fill(float& v, int seed) { v = value<float>(seed); }
+inline void fill(double& v, int seed) { v = value<double>(seed); }
+
+/// Operands shared by the binary benchmarks below.
+template <typename A, typename B> struct operands
+{
+	A a[N];
+	B b[N];
+	operands() { for (size_t i = 0; i < N; ++i) { fill(a[i], (int)i); fill(b[i], (int)i*3+1); } }
+};
+
+template <typename A, typename B> struct product : operands<A,B>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1);
+			bench::do_not_optimize(this->a[j] * this->b[j]);
+		}
+	}
+};
+
+template <typename A, typename B> struct quotient : operands<A,B>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1);
+			bench::do_not_optimize(this->a[j] / this->b[j]);
+		}
+	}
+};
+
+template <typename V> struct cross : operands<V,V>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1);
+			bench::do_not_optimize(this->a[j].cross(this->b[j]));
+		}
+	}
+};
+
+template <typename V> struct normalize : operands<V,V>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1);
+			bench::do_not_optimize(this->a[j].normalized());
+		}
+	}
+};
+
+template <typename V> struct normalize_fast_member : operands<V,V>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1);
+			bench::do_not_optimize(this->a[j].normalized_fast());
+		}
+	}
+};
+
+/// Benchmarks normalizing N vectors as a batch. Reports the time per vector.
+template <typename T, bool fast> struct normalize_batch : operands<vector3<T>, vector3<T> >
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			if (fast) gma::normalize_fast(this->a, this->b, N);
+			else gma::normalize(this->a, this->b, N);
+			bench::clobber(this->b);
+		}
+	}
+};
+
+/// Benchmarks a unary operation on matrices, selected by the functor F.
+template <typename M, typename F> struct unary : operands<M,M>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1);
+			bench::do_not_optimize(F::apply(this->a[j]));
+		}
+	}
+};
+
+struct inverse { template <typename M> static M apply(const M& m) { return m.inverse(); } };
+struct inverse_affine { template <typename M> static M apply(const M& m) { return m.inverse_affine(); } };
+struct inverse_orthonormal { template <typename M> static M apply(const M& m) { return m.inverse_orthonormal(); } };
+
+/// Benchmarks the update() of a single-angle rotation transform. The angle
+/// member is selected by the accessor A.
+template <typename R, typename A> struct rotation_update
+{
+	R r;
+	typename R::scalar_type angles[N];
+	rotation_update() { for (size_t i = 0; i < N; ++i) angles[i] = i * 0.01; }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			A::angle(r) = angles[i & (N-1)];
+			r.update();
+			bench::do_not_optimize(r.m);
+		}
+	}
+};
+
+struct x_angle { template <typename R> static typename R::scalar_type& angle(R& r) { return r.x; } };
+struct y_angle { template <typename R> static typename R::scalar_type& angle(R& r) { return r.y; } };
+struct z_angle { template <typename R> static typename R::scalar_type& angle(R& r) { return r.z; } };
+
+template <typename T> struct axial_rotation_update
+{
+	transform::axial_rotation<T> r;
+	vector3<T> angles[N];
+	axial_rotation_update() { for (size_t i = 0; i < N; ++i) angles[i] = vector3<T>(T(i * 0.01), T(i * 0.02), T(i * 0.03)); }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			r.v = angles[i & (N-1)];
+			r.update();
+			bench::do_not_optimize(r.m);
+		}
+	}
+};
+
+/// Benchmarks the transforms without an update(), which compute their
+/// matrix when constructed. The transform is built by M from a parameter
+/// that varies per iteration.
+template <typename T, typename M> struct transform_construct
+{
+	T p[N];
+	transform_construct() { for (size_t i = 0; i < N; ++i) p[i] = T(1 + i * 0.01); }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			bench::do_not_optimize((matrix4<T>)M::make(p[i & (N-1)]));
+	}
+};
+
+struct make_translation { template <typename T> static transform::translation<T> make(T p) { return transform::translation<T>(vector3<T>(p, -p, p + p)); } };
+struct make_perspective { template <typename T> static transform::perspective<T> make(T p) { return transform::perspective<T>(p, T(1.5), T(0.1), p * 100); } };
+struct make_orthogonal { template <typename T> static transform::orthogonal<T> make(T p) { return transform::orthogonal<T>(-p, p, -p, p, T(1), -p); } };
+struct make_orientation { template <typename T> static transform::orientation<T> make(T p) { return transform::orientation<T>(vector3<T>(p, T(1), -p), vector3<T>(0, 1, 0)); } };
+struct make_lookat { template <typename T> static transform::lookat<T> make(T p) { return transform::lookat<T>(vector3<T>(p, T(2), T(3)), vector3<T>(T(1), -p, T(1)), vector3<T>(0, 1, 0)); } };
+
+/// Benchmarks a per-object model change followed by reading the model view
+/// projection matrix, once through the immutable mvp and once through
+/// lazy_mvp.
+template <typename T> struct mvp_set_model : operands<matrix4<T>, matrix4<T> >
+{
+	mvp<T> m;
+	mvp_set_model(): m(this->b[0], this->b[1], this->b[2]) {}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			m = m.set_model(this->a[i & (N-1)]);
+			bench::do_not_optimize(m.model_view_projection);
+		}
+	}
+};
+
+template <typename T> struct lazy_mvp_set_model : operands<matrix4<T>, matrix4<T> >
+{
+	lazy_mvp<T> m;
+	lazy_mvp_set_model(): m(this->b[0], this->b[1], this->b[2]) {}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			m.set_model(this->a[i & (N-1)]);
+			bench::do_not_optimize(m.get_model_view_projection());
+		}
+	}
+};
+
+/// Benchmarks the model view and model view projection matrices of N double
+/// precision instances uploaded as float, once by computing them in double
+/// and converting, and once in the camera-relative batch. Reports the time
+/// per instance.
+template <bool relative> struct mvp_float_upload : operands<matrix4<double>, matrix4<double> >
+{
+	vector3<double> origin;
+	matrix4<double> mv[N], mvp[N];
+	matrix4<float> mvf[N], mvpf[N];
+	mvp_float_upload(): origin(1e7, 2e6, -3e5) {}
+	void operator() (uint64_t n) {
+		const matrix4<double>& view = this->b[0];
+		const matrix4<double>& projection = this->b[1];
+		for (uint64_t i = 0; i < n; i += N) {
+			if (relative) {
+				mvp_batch(origin, (matrix4<float>)view, (matrix4<float>)projection, this->a, N, mvf, mvpf, (matrix3<float>*)0);
+			} else {
+				mvp_batch(view * (matrix4<double>)transform::translation<double>(-origin), projection, this->a, N, mv, mvp, (matrix3<double>*)0);
+				for (size_t k = 0; k < N; ++k) {
+					mvf[k] = (matrix4<float>)mv[k];
+					mvpf[k] = (matrix4<float>)mvp[k];
+				}
+			}
+			bench::clobber(mvpf);
+		}
+	}
+};
+
+/// Benchmarks the batch update of N axial rotations. Reports the time per
+/// rotation by running n/N batches.
+template <typename T> struct axial_rotation_update_batch
+{
+	transform::axial_rotation<T> r[N];
+	axial_rotation_update_batch() { for (size_t i = 0; i < N; ++i) r[i].v = vector3<T>(i * 0.01, i * 0.02, i * 0.03); }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			transform::update(r, N);
+			bench::clobber(r);
+		}
+	}
+};
+
+/// Benchmarks the slerp between pairs of quaternions, once one at a time and
+/// once as a batch of N. Both report the time per interpolation.
+template <typename T> struct quaternion_slerp : operands<quaternion<T>, quaternion<T> >
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1);
+			bench::do_not_optimize(slerp(this->a[j], this->b[j], T(j) / N));
+		}
+	}
+};
+
+template <typename T> struct quaternion_slerp_batch : operands<quaternion<T>, quaternion<T> >
+{
+	quaternion<T> r[N];
+	T t[N];
+	quaternion_slerp_batch() { for (size_t i = 0; i < N; ++i) t[i] = T(i) / N; }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			slerp(this->a, this->b, t, r, N);
+			bench::clobber(r);
+		}
+	}
+};
+
+/// Benchmarks culling a scene of spheres against a perspective frustum, once
+/// through frustum::intersects and once as a batch. Both report the time per
+/// sphere.
+template <typename T> struct frustum_scene
+{
+	static const size_t M = 1 << 16;
+	frustum<T> f;
+	std::vector<sphere<vector3<T> > > s;
+	std::vector<uint64_t> mask;
+	frustum_scene(): f(matrix4<T>(transform::perspective<T>(1.2, 1.5, 0.1, 100))), s(M), mask(M/64) {
+		for (size_t i = 0; i < M; ++i)
+			s[i] = sphere<vector3<T> >(vector3<T>(T(i*37 % 101) - 50, T(i*53 % 89) - 44, -T(i*29 % 113)), T(i % 7) / 2);
+	}
+};
+
+template <typename T> struct frustum_intersects : frustum_scene<T>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			bench::do_not_optimize(this->f.intersects(this->s[i & (this->M-1)]));
+	}
+};
+
+template <typename T> struct frustum_cull : frustum_scene<T>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += this->M)
+			bench::do_not_optimize(cull(this->f, &this->s[0], this->M, &this->mask[0]));
+	}
+};
+
+/// Benchmarks picking the closest of M spheres along N rays, once by testing
+/// every sphere and once through a bvh. Both report the time per ray.
+template <typename T> struct pick_scene
+{
+	static const size_t M = 1 << 15;
+	std::vector<sphere<vector3<T> > > s;
+	line<vector3<T> > l[N];
+	pick_scene(): s(M) {
+		for (size_t i = 0; i < M; ++i)
+			s[i] = sphere<vector3<T> >(vector3<T>(T(i*37 % 1009), T(i*53 % 997), T(i*29 % 991)) / 10, T(i % 7 + 1) / 8);
+		for (size_t i = 0; i < N; ++i)
+			l[i] = line<vector3<T> >(vector3<T>(T(i % 16) * 6, T(i / 16) * 6, -1), vector3<T>(value<T>(i) / 10, value<T>(i+3) / 10, 1));
+	}
+};
+
+template <typename T> struct pick_brute_force : pick_scene<T>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			const line<vector3<T> >& l = this->l[i & (N-1)];
+			T best = std::numeric_limits<T>::infinity(), t;
+			for (size_t k = 0; k < this->M; ++k)
+				if (intersect(l, this->s[k], t) && t < best)
+					best = t;
+			bench::do_not_optimize(best);
+		}
+	}
+};
+
+/// Benchmarks testing a ray against all M spheres, storing the parameters of
+/// the hits, once in a loop over intersect(line, sphere) and once as a batch.
+/// Both report the time per ray.
+template <typename T> struct ray_spheres_loop : pick_scene<T>
+{
+	std::vector<T> t;
+	ray_spheres_loop(): t(this->M) {}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			const line<vector3<T> >& l = this->l[i & (N-1)];
+			size_t hits = 0;
+			for (size_t k = 0; k < this->M; ++k)
+				hits += intersect(l, this->s[k], t[k]);
+			bench::do_not_optimize(hits);
+		}
+	}
+};
+
+template <typename T> struct ray_spheres_batch : pick_scene<T>
+{
+	std::vector<T> t;
+	std::vector<uint64_t> mask;
+	ray_spheres_batch(): t(this->M), mask(this->M/64) {}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			bench::do_not_optimize(intersect(this->l[i & (N-1)], &this->s[0], this->M, &t[0], &mask[0]));
+	}
+};
+
+template <typename T> struct pick_bvh : pick_scene<T>
+{
+	bvh<T> b;
+	pick_bvh(): b(&this->s[0], this->M) {}
+	void operator() (uint64_t n) {
+		typename bvh<T>::hit h;
+		for (uint64_t i = 0; i < n; ++i)
+			bench::do_not_optimize(b.first_hit(this->l[i & (N-1)], h));
+	}
+};
+
+/// Benchmarks finding the about 66000 overlapping pairs among M randomly
+/// placed spheres per physics step, once by rebuilding a bvh and querying it
+/// with every sphere, and once with a broad_phase that is rebuilt or updated
+/// in place, on all hardware threads or on a fixed number of workers. All
+/// report the time per step.
+template <typename T> struct collision_scene
+{
+	static const size_t M = 1 << 17;
+	std::vector<sphere<vector3<T> > > s;
+	collision_scene(): s(M) {
+		uint32_t seed = 1;
+		for (size_t i = 0; i < M; ++i) {
+			T p[3];
+			for (int k = 0; k < 3; ++k) { seed = seed * 1664525 + 1013904223; p[k] = T(seed >> 8) / (1 << 24) * 90; }
+			s[i] = sphere<vector3<T> >(vector3<T>(p[0], p[1], p[2]), T(i % 7 + 1) / 8);
+		}
+	}
+};
+
+template <typename T> struct collide_bvh : collision_scene<T>
+{
+	bvh<T> b;
+	std::vector<size_t> r;
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			b.build(&this->s[0], this->M);
+			r.clear();
+			for (size_t k = 0; k < this->M; ++k)
+				b.overlap(this->s[k], r);
+			bench::do_not_optimize(r.size());
+		}
+	}
+};
+
+template <typename T, bool rebuild> struct collide_broad_phase : collision_scene<T>
+{
+	broad_phase<T> b;
+	std::vector<std::vector<typename broad_phase<T>::pair> > out;
+	collide_broad_phase(unsigned workers = 0): b(workers) { b.build(&this->s[0], this->M); }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			if (rebuild)
+				b.build(&this->s[0], this->M);
+			else
+				b.update(&this->s[0]);
+			b.pairs(out);
+			bench::do_not_optimize(out[0].size());
+		}
+	}
+};
+
+/// Benchmarks the products of N pairs of matrix4 stored in arrays allocated
+/// by Alloc, such as the default allocator against an aligned_allocator that
+/// keeps each matrix within a cache line. Reports the time per product.
+template <typename T, typename Alloc> struct matrix4_array_product
+{
+	std::vector<matrix4<T>, Alloc> a, b, r;
+	matrix4_array_product(): a(N), b(N), r(N) {
+		for (size_t i = 0; i < N; ++i) { fill(a[i], (int)i); fill(b[i], (int)i + 1); }
+	}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			for (size_t k = 0; k < N; ++k)
+				r[k] = a[k] * b[k];
+			bench::clobber(r[0]);
+		}
+	}
+};
+
+/// Benchmarks dumping N matrices as text with operator<<, as a snapshot
+/// would be written before the binary format. Reports the time per matrix.
+template <typename T> struct matrix4_dump_text
+{
+	matrix4<T> m[N];
+	matrix4_dump_text() { for (size_t i = 0; i < N; ++i) fill(m[i], (int)i); }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			std::ostringstream o;
+			for (size_t k = 0; k < N; ++k)
+				o << m[k] << '\n';
+			bench::do_not_optimize(o.str().size());
+		}
+	}
+};
+
+/// Benchmarks propagating the world matrices of a scene graph of M nodes
+/// with random parents per frame, once by hand in the order of creation, and
+/// with a hierarchy in which all or one percent of the local matrices have
+/// changed. All report the time per frame.
+template <typename T> struct scene_graph
+{
+	static const size_t M = 100000;
+	std::vector<matrix4<T> > local;
+	std::vector<uint32_t> parent;
+	scene_graph(): local(M), parent(M) {
+		uint32_t seed = 1;
+		for (size_t i = 0; i < M; ++i) {
+			seed = seed * 1664525 + 1013904223;
+			parent[i] = i < 16 ? 0xffffffffu : (seed >> 8) % i;
+			fill(local[i], (int)i);
+			local[i] = local[i] * T(0.25);
+		}
+	}
+};
+
+template <typename T> struct scene_graph_manual : scene_graph<T>
+{
+	std::vector<matrix4<T> > world;
+	scene_graph_manual(): world(this->M) {}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			for (size_t k = 0; k < this->M; ++k) {
+				uint32_t p = this->parent[k];
+				world[k] = p == 0xffffffffu ? this->local[k] : world[p] * this->local[k];
+			}
+			bench::clobber(world[0]);
+		}
+	}
+};
+
+template <typename T, size_t every> struct scene_graph_hierarchy : scene_graph<T>
+{
+	hierarchy<T> h;
+	scene_graph_hierarchy() {
+		for (size_t i = 0; i < this->M; ++i)
+			h.add(this->local[i], this->parent[i]);
+		h.update();
+	}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			for (uint32_t k = (uint32_t)(i % every); k < this->M; k += every)
+				h.set_local(k, this->local[k]);
+			h.update();
+			bench::clobber(h.world_matrices[0]);
+		}
+	}
+};
+
+/// Benchmarks skinning a mesh of M vertices with four influences each by a
+/// palette of 64 bones, once by blending the transformed vectors of each
+/// bone per vertex, and once with skin. Both report the time per vertex.
+template <typename T> struct skinned_mesh
+{
+	static const size_t M = 1 << 16;
+	std::vector<matrix4<T> > palette;
+	std::vector<uint16_t> bones;
+	std::vector<T> weights;
+	soa3<T> p, n, op, on;
+	skinned_mesh(): palette(64), bones(4*M), weights(4*M), p(M), n(M), op(M), on(M) {
+		for (size_t b = 0; b < palette.size(); ++b) {
+			fill(palette[b], (int)b);
+			palette[b].m30 = palette[b].m31 = palette[b].m32 = 0; palette[b].m33 = 1;
+		}
+		uint32_t seed = 1;
+		for (size_t i = 0; i < M; ++i) {
+			p.set(i, vector3<T>(value<T>((int)i), value<T>((int)i+1), value<T>((int)i+2)));
+			n.set(i, vector3<T>(0, 1, 0));
+			for (int k = 0; k < 4; ++k) {
+				seed = seed * 1664525 + 1013904223;
+				bones[4*i+k] = (uint16_t)((i / 32 + (seed >> 24) % 4) % palette.size());
+				weights[4*i+k] = T(0.1) * (k + 1);
+			}
+		}
+	}
+};
+
+template <typename T> struct skin_loop : skinned_mesh<T>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += this->M) {
+			for (size_t k = 0; k < this->M; ++k) {
+				vector4<T> rp(0, 0, 0, 0), rn(0, 0, 0, 0);
+				for (int j = 0; j < 4; ++j) {
+					const matrix4<T>& m = this->palette[this->bones[4*k+j]];
+					rp = rp + m * vector4<T>(this->p[k], 1) * this->weights[4*k+j];
+					rn = rn + m * vector4<T>(this->n[k], 0) * this->weights[4*k+j];
+				}
+				this->op.set(k, vector3<T>(rp.x, rp.y, rp.z));
+				this->on.set(k, vector3<T>(rn.x, rn.y, rn.z));
+			}
+			bench::clobber(this->op.x[0]);
+		}
+	}
+};
+
+template <typename T> struct skin_batch : skinned_mesh<T>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += this->M) {
+			skin(&this->palette[0], 4, &this->bones[0], &this->weights[0], this->p, this->n, this->op, this->on);
+			bench::clobber(this->op.x[0]);
+		}
+	}
+};
+
+/// Benchmarks formatting N matrices with to_chars into a buffer. Reports the
+/// time per matrix.
+template <typename T> struct matrix4_format_text
+{
+	matrix4<T> m[N];
+	std::vector<char> buffer;
+	matrix4_format_text(): buffer(max_chars<matrix4<T> >(N)) { for (size_t i = 0; i < N; ++i) fill(m[i], (int)i); }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N)
+			bench::do_not_optimize(to_chars(&buffer[0], &buffer[0] + buffer.size(), m, N));
+	}
+};
+
+/// Benchmarks parsing N matrices from text with operator>> if stream is set,
+/// with from_chars otherwise. Reports the time per matrix.
+template <typename T, bool stream> struct matrix4_parse_text
+{
+	std::string text;
+	matrix4<T> m[N];
+	matrix4_parse_text() {
+		for (size_t i = 0; i < N; ++i) fill(m[i], (int)i);
+		std::vector<char> buffer(max_chars<matrix4<T> >(N));
+		text.assign(&buffer[0], to_chars(&buffer[0], &buffer[0] + buffer.size(), m, N));
+	}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			if (stream) {
+				std::istringstream s(text);
+				for (size_t k = 0; k < N; ++k)
+					s >> m[k];
+			} else {
+				from_chars(text.data(), text.data() + text.size(), m, N);
+			}
+			bench::clobber(m[0]);
+		}
+	}
+};
+
+/// Benchmarks dumping N matrices with binary::write. Reports the time per
+/// matrix.
+template <typename T> struct matrix4_dump_binary
+{
+	matrix4<T> m[N];
+	std::vector<uint64_t> buffer;
+	matrix4_dump_binary(): buffer(binary::size<matrix4<T> >(N) / 8) { for (size_t i = 0; i < N; ++i) fill(m[i], (int)i); }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			binary::write(&buffer[0], m, N);
+			bench::clobber(buffer[0]);
+		}
+	}
+};
+
+/// Benchmarks loading N matrices by reading them from a stream or by viewing
+/// them in place, and summing one scalar of each. Reports the time per
+/// matrix.
+template <typename T, bool copy> struct matrix4_load_binary
+{
+	std::string data;
+	matrix4_load_binary() {
+		matrix4<T> m[N];
+		for (size_t i = 0; i < N; ++i) fill(m[i], (int)i);
+		std::ostringstream o;
+		binary::write(o, m, N);
+		data = o.str();
+	}
+	void operator() (uint64_t n) {
+		std::vector<matrix4<T> > v;
+		for (uint64_t i = 0; i < n; i += N) {
+			const matrix4<T>* m = 0;
+			size_t count = 0;
+			if (copy) {
+				std::istringstream s(data);
+				if (binary::read(s, v) && !v.empty()) {
+					m = &v[0];
+					count = v.size();
+				}
+			} else {
+				m = binary::view<matrix4<T> >(data.data(), data.size(), count);
+			}
+			if (!m) {
+				fprintf(stderr, "matrix4_load_binary: cannot read the encoded matrices\n");
+				abort();
+			}
+			T sum = 0;
+			for (size_t k = 0; k < count; ++k)
+				sum += m[k].m00;
+			bench::do_not_optimize(sum);
+		}
+	}
+};
+
+/// Benchmarks decoding and encoding N unit normals in compact storage Q, as
+/// vector3<I> or octahedral. The decode is compared against copying the
+/// normals stored as vector3f. Reports the time per normal.
+template <typename Q> struct packed_normals
+{
+	vector3<float> v[N], r[N];
+	Q q[N];
+	packed_normals() {
+		for (size_t i = 0; i < N; ++i)
+			v[i] = vector3<float>(value<float>(i), value<float>(i+1), value<float>(i+2)).normalized();
+		pack(v, N, q);
+	}
+};
+template <typename Q> struct packed_decode : packed_normals<Q>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			unpack(this->q, N, this->r);
+			bench::clobber(this->r);
+		}
+	}
+};
+template <typename Q> struct packed_encode : packed_normals<Q>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			pack(this->v, N, this->q);
+			bench::clobber(this->q);
+		}
+	}
+};
+struct packed_copy
+{
+	vector3<float> v[N], r[N];
+	packed_copy() { for (size_t i = 0; i < N; ++i) v[i] = vector3<float>(value<float>(i), 1, 0).normalized(); }
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			std::copy(v, v + N, r);
+			bench::clobber(r);
+		}
+	}
+};
+
+/// Benchmarks the multiplication of N pairs of fixed32_32 numbers, whose
+/// products need 128 bits, once as a widening multiplication of 128 bit
+/// integers and once assembled from 32 bit partial products. Reports the time
+/// per product.
+template <bool portable> struct fixed_point_multiply_wide : operands<fixed32_32, fixed32_32>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1);
+			int64_t a = this->a[j].v, b = this->b[j].v;
+			bench::do_not_optimize(portable ? detail::mul_shift_portable<32>(a, b) : detail::mul_shift<32,128>::apply(a, b));
+		}
+	}
+};
+
+/// Benchmarks the batch multiplication of N pairs of fixed_point numbers.
+/// Reports the time per product.
+template <typename F> struct fixed_point_multiply_batch : operands<F,F>
+{
+	F r[N];
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			mul(this->a, this->b, r, N);
+			bench::clobber(r);
+		}
+	}
+};
+
+/// Benchmarks the sine of a fixed_point number, once computed with integer
+/// CORDIC and once through a round trip to float and sinf, which is what the
+/// fixed_point math used to cost and gives no reproducible bits.
+template <typename F, bool via_float> struct fixed_point_sin : operands<F,F>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			F a = this->a[i & (N-1)];
+			bench::do_not_optimize(via_float ? F(sinf((float)a)) : sin(a));
+		}
+	}
+};
+
+/// Benchmarks the square root of a fixed_point number, once as an integer
+/// square root and once through float and sqrtf.
+template <typename F, bool via_float> struct fixed_point_sqrt : operands<F,F>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			F a = this->a[i & (N-1)];
+			if (a.v < 0) a.v = -a.v;
+			bench::do_not_optimize(via_float ? F(sqrtf((float)a)) : sqrt(a));
+		}
+	}
+};
+
+/// Benchmarks transforming N points held in a soa3 by a matrix4. Reports the
+/// time per point.
+template <typename T> struct soa_transform_points
+{
+	matrix4<T> m;
+	soa3<T> in, out;
+	soa_transform_points(): in(N), out(N) {
+		fill(m, 1);
+		for (size_t i = 0; i < N; ++i) in.set(i, vector3<T>(value<T>(i), value<T>(i+1), value<T>(i+2)));
+	}
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; i += N) {
+			transform_points(m, in, out);
+			bench::clobber(out);
+		}
+	}
+};
+
+/// Benchmarks the chain a*s + b*t - c*u + d on vectors or matrices, once
+/// through the operators of vector.hpp and matrix.hpp, which create a
+/// temporary per operation, and once fused through expression.hpp.
+template <typename V> struct chain : operands<V,V>
+{
+	typedef typename V::type T;
+	T s[N];
+	chain() { for (size_t i = 0; i < N; ++i) s[i] = value<T>(i); }
+};
+
+template <typename V> struct chain_operators : chain<V>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1), k = (i+1) & (N-1);
+			const V &a = this->a[j], &b = this->b[j], &c = this->a[k], &d = this->b[k];
+			bench::do_not_optimize(V(a*this->s[j] + b*this->s[k] - c*this->s[j^1] + d));
+		}
+	}
+};
+
+template <typename V> struct chain_expression : chain<V>
+{
+	void operator() (uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t j = i & (N-1), k = (i+1) & (N-1);
+			const V &a = this->a[j], &b = this->b[j], &c = this->a[k], &d = this->b[k];
+			bench::do_not_optimize(V(expr(a)*this->s[j] + expr(b)*this->s[k] - expr(c)*this->s[j^1] + expr(d)));
+		}
+	}
+};
+
+template <typename T> struct vector4_chain_operators : chain_operators<vector4<T> > {};
+template <typename T> struct vector4_chain_expression : chain_expression<vector4<T> > {};
+template <typename T> struct matrix4_chain_operators : chain_operators<matrix4<T> > {};
+template <typename T> struct matrix4_chain_expression : chain_expression<matrix4<T> > {};
+
+template <typename T> struct matrix2_product : product<matrix2<T>, matrix2<T> > {};
+template <typename T> struct matrix3_product : product<matrix3<T>, matrix3<T> > {};
+template <typename T> struct matrix4_product : product<matrix4<T>, matrix4<T> > {};
+template <typename T> struct matrix2_vector2_product : product<matrix2<T>, vector2<T> > {};
+template <typename T> struct matrix3_vector3_product : product<matrix3<T>, vector3<T> > {};
+template <typename T> struct matrix4_vector4_product : product<matrix4<T>, vector4<T> > {};
+template <typename T> struct matrix3_inverse : unary<matrix3<T>, inverse> {};
+template <typename T> struct matrix4_inverse : unary<matrix4<T>, inverse> {};
+template <typename T> struct matrix4_inverse_affine : unary<matrix4<T>, inverse_affine> {};
+template <typename T> struct matrix4_inverse_orthonormal : unary<matrix4<T>, inverse_orthonormal> {};
+template <typename T> struct vector3_cross : cross<vector3<T> > {};
+template <typename T> struct vector2_normalize : normalize<vector2<T> > {};
+template <typename T> struct vector3_normalize : normalize<vector3<T> > {};
+template <typename T> struct vector4_normalize : normalize<vector4<T> > {};
+
+/// Runs the benchmark B for float, double and int.
+template <template <typename> class B> void run_builtin(bench::runner& r, const std::string& name)
+{
+	r.run(name + "/float", B<float>());
+	r.run(name + "/double", B<double>());
+	r.run(name + "/int", B<int>());
+}
+
+/// Runs the benchmark B for float, double, int and fixed_point.
+template <template <typename> class B> void run_all(bench::runner& r, const std::string& name)
+{
+	run_builtin<B>(r, name);
+	r.run(name + "/fixed16_16", B<fixed16_16>());
+}
+
+int main(int argc, char** argv)
+{
+	bench::options opts;
+	if (!opts.parse(argc, argv))
+		return 1;
+	bench::runner r(opts);
+
+	run_all<matrix2_product>(r, "matrix2_product");
+	run_all<matrix3_product>(r, "matrix3_product");
+	run_all<matrix4_product>(r, "matrix4_product");
+	run_all<matrix2_vector2_product>(r, "matrix2_vector2_product");
+	run_all<matrix3_vector3_product>(r, "matrix3_vector3_product");
+	run_all<matrix4_vector4_product>(r, "matrix4_vector4_product");
+	run_all<vector3_cross>(r, "vector3_cross");
+
+	r.run("matrix3_inverse/float", matrix3_inverse<float>());
+	r.run("matrix3_inverse/double", matrix3_inverse<double>());
+	r.run("matrix4_inverse/float", matrix4_inverse<float>());
+	r.run("matrix4_inverse/double", matrix4_inverse<double>());
+	r.run("matrix4_inverse_affine/float", matrix4_inverse_affine<float>());
+	r.run("matrix4_inverse_affine/double", matrix4_inverse_affine<double>());
+	r.run("matrix4_inverse_orthonormal/float", matrix4_inverse_orthonormal<float>());
+	r.run("matrix4_inverse_orthonormal/double", matrix4_inverse_orthonormal<double>());
+
+	run_all<vector2_normalize>(r, "vector2_normalize");
+	run_all<vector3_normalize>(r, "vector3_normalize");
+	run_all<vector4_normalize>(r, "vector4_normalize");
+
+	r.run("vector3_normalize_fast/float", normalize_fast_member<vector3<float> >());
+	r.run("vector3_normalize_fast/double", normalize_fast_member<vector3<double> >());
+	r.run("vector3_normalize_batch/float", normalize_batch<float, false>());
+	r.run("vector3_normalize_batch/double", normalize_batch<double, false>());
+	r.run("vector3_normalize_fast_batch/float", normalize_batch<float, true>());
+	r.run("vector3_normalize_fast_batch/double", normalize_batch<double, true>());
+
+	r.run("fixed_point_multiply/fixed16_16", product<fixed16_16, fixed16_16>());
+	r.run("fixed_point_multiply/fixed24_8", product<fixed24_8, fixed24_8>());
+#ifdef GAMMA_HAS_INT128
+	r.run("fixed_point_multiply/fixed32_32", product<fixed32_32, fixed32_32>());
+	r.run("fixed_point_multiply_wide/int128", fixed_point_multiply_wide<false>());
+	r.run("fixed_point_multiply_wide/portable", fixed_point_multiply_wide<true>());
+#endif
+	r.run("fixed_point_multiply_batch/fixed16_16", fixed_point_multiply_batch<fixed16_16>());
+	r.run("fixed_point_multiply_batch/fixed24_8", fixed_point_multiply_batch<fixed24_8>());
+	r.run("fixed_point_divide/fixed16_16", quotient<fixed16_16, fixed16_16>());
+	r.run("fixed_point_divide/fixed24_8", quotient<fixed24_8, fixed24_8>());
+#ifdef GAMMA_HAS_INT128
+	r.run("fixed_point_divide/fixed32_32", quotient<fixed32_32, fixed32_32>());
+#endif
+	r.run("fixed_point_sin/cordic", fixed_point_sin<fixed16_16, false>());
+	r.run("fixed_point_sin/float", fixed_point_sin<fixed16_16, true>());
+	r.run("fixed_point_sqrt/integer", fixed_point_sqrt<fixed16_16, false>());
+	r.run("fixed_point_sqrt/float", fixed_point_sqrt<fixed16_16, true>());
+
+	run_all<soa_transform_points>(r, "soa_transform_points");
+
+	run_builtin<vector4_chain_operators>(r, "vector4_chain_operators");
+	run_builtin<vector4_chain_expression>(r, "vector4_chain_expression");
+	run_builtin<matrix4_chain_operators>(r, "matrix4_chain_operators");
+	run_builtin<matrix4_chain_expression>(r, "matrix4_chain_expression");
+
+	r.run("quaternion_product/float", product<quaternion<float>, quaternion<float> >());
+	r.run("quaternion_product/double", product<quaternion<double>, quaternion<double> >());
+	r.run("quaternion_slerp/float", quaternion_slerp<float>());
+	r.run("quaternion_slerp/double", quaternion_slerp<double>());
+	r.run("quaternion_slerp_batch/float", quaternion_slerp_batch<float>());
+	r.run("quaternion_slerp_batch/double", quaternion_slerp_batch<double>());
+
+	r.run("frustum_intersects/float", frustum_intersects<float>());
+	r.run("frustum_intersects/double", frustum_intersects<double>());
+	r.run("frustum_cull/float", frustum_cull<float>());
+	r.run("frustum_cull/double", frustum_cull<double>());
+
+	r.run("pick_brute_force/float", pick_brute_force<float>());
+	r.run("pick_brute_force/double", pick_brute_force<double>());
+	r.run("pick_bvh/float", pick_bvh<float>());
+	r.run("pick_bvh/double", pick_bvh<double>());
+	r.run("collide_bvh/float", collide_bvh<float>());
+	r.run("collide_bvh/double", collide_bvh<double>());
+	r.run("collide_broad_phase_build/float", collide_broad_phase<float, true>());
+	r.run("collide_broad_phase_build/double", collide_broad_phase<double, true>());
+	r.run("collide_broad_phase_update/float", collide_broad_phase<float, false>());
+	r.run("collide_broad_phase_update/double", collide_broad_phase<double, false>());
+	r.run("collide_broad_phase_build_1_worker/float", collide_broad_phase<float, true>(1));
+	r.run("collide_broad_phase_build_4_workers/float", collide_broad_phase<float, true>(4));
+	r.run("collide_broad_phase_update_1_worker/float", collide_broad_phase<float, false>(1));
+	r.run("collide_broad_phase_update_4_workers/float", collide_broad_phase<float, false>(4));
+	r.run("matrix4_array_product/float", matrix4_array_product<float, std::allocator<matrix4<float> > >());
+	r.run("matrix4_array_product/double", matrix4_array_product<double, std::allocator<matrix4<double> > >());
+	r.run("matrix4_array_product_aligned/float", matrix4_array_product<float, aligned_allocator<matrix4<float>, 64> >());
+	r.run("matrix4_array_product_aligned/double", matrix4_array_product<double, aligned_allocator<matrix4<double>, 64> >());
+	r.run("scene_graph_manual/float", scene_graph_manual<float>());
+	r.run("scene_graph_hierarchy/float", scene_graph_hierarchy<float, 1>());
+	r.run("scene_graph_hierarchy_sparse/float", scene_graph_hierarchy<float, 100>());
+	r.run("skin_loop/float", skin_loop<float>());
+	r.run("skin_loop/double", skin_loop<double>());
+	r.run("skin_batch/float", skin_batch<float>());
+	r.run("skin_batch/double", skin_batch<double>());
+	r.run("matrix4_dump_text/float", matrix4_dump_text<float>());
+	r.run("matrix4_format_text/float", matrix4_format_text<float>());
+	r.run("matrix4_parse_text_stream/float", matrix4_parse_text<float, true>());
+	r.run("matrix4_parse_text/float", matrix4_parse_text<float, false>());
+	r.run("matrix4_dump_binary/float", matrix4_dump_binary<float>());
+	r.run("matrix4_load_binary_read/float", matrix4_load_binary<float, true>());
+	r.run("matrix4_load_binary_view/float", matrix4_load_binary<float, false>());
+	r.run("normal_copy/float", packed_copy());
+	r.run("normal_decode/int8", packed_decode<vector3<int8_t> >());
+	r.run("normal_decode/int16", packed_decode<vector3<int16_t> >());
+	r.run("normal_decode/half", packed_decode<vector3<half> >());
+	r.run("normal_decode/octahedral", packed_decode<octahedral>());
+	r.run("normal_encode/int8", packed_encode<vector3<int8_t> >());
+	r.run("normal_encode/int16", packed_encode<vector3<int16_t> >());
+	r.run("normal_encode/half", packed_encode<vector3<half> >());
+	r.run("normal_encode/octahedral", packed_encode<octahedral>());
+	r.run("ray_spheres_loop/float", ray_spheres_loop<float>());
+	r.run("ray_spheres_loop/double", ray_spheres_loop<double>());
+	r.run("ray_spheres_batch/float", ray_spheres_batch<float>());
+	r.run("ray_spheres_batch/double", ray_spheres_batch<double>());
+
+	r.run("mvp_upload_cast/double", mvp_float_upload<false>());
+	r.run("mvp_upload_relative/double", mvp_float_upload<true>());
+	r.run("mvp_set_model/float", mvp_set_model<float>());
+	r.run("mvp_set_model/double", mvp_set_model<double>());
+	r.run("lazy_mvp_set_model/float", lazy_mvp_set_model<float>());
+	r.run("lazy_mvp_set_model/double", lazy_mvp_set_model<double>());
+
+	r.run("x_rotation_update/float", rotation_update<transform::x_rotation<float>, x_angle>());
+	r.run("x_rotation_update/double", rotation_update<transform::x_rotation<double>, x_angle>());
+	r.run("x_rotation_update/fixed16_16", rotation_update<transform::x_rotation<fixed16_16>, x_angle>());
+	r.run("y_rotation_update/float", rotation_update<transform::y_rotation<float>, y_angle>());
+	r.run("y_rotation_update/double", rotation_update<transform::y_rotation<double>, y_angle>());
+	r.run("z_rotation_update/float", rotation_update<transform::z_rotation<float>, z_angle>());
+	r.run("z_rotation_update/double", rotation_update<transform::z_rotation<double>, z_angle>());
+	r.run("axial_rotation_update/float", axial_rotation_update<float>());
+	r.run("axial_rotation_update/double", axial_rotation_update<double>());
+	r.run("axial_rotation_update/fixed16_16", axial_rotation_update<fixed16_16>());
+	r.run("axial_rotation_update_batch/float", axial_rotation_update_batch<float>());
+	r.run("axial_rotation_update_batch/double", axial_rotation_update_batch<double>());
+	r.run("translation_construct/float", transform_construct<float, make_translation>());
+	r.run("translation_construct/double", transform_construct<double, make_translation>());
+	r.run("perspective_construct/float", transform_construct<float, make_perspective>());
+	r.run("perspective_construct/double", transform_construct<double, make_perspective>());
+	r.run("orthogonal_construct/float", transform_construct<float, make_orthogonal>());
+	r.run("orthogonal_construct/double", transform_construct<double, make_orthogonal>());
+	r.run("orientation_construct/float", transform_construct<float, make_orientation>());
+	r.run("orientation_construct/double", transform_construct<double, make_orientation>());
+	r.run("lookat_construct/float", transform_construct<float, make_lookat>());
+	r.run("lookat_construct/double", transform_construct<double, make_lookat>());
+
+	r.finish();
+	return 0;
+}
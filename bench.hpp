@@ -0,0 +1,139 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/// A minimal benchmark harness. Each benchmark is a callable taking the
+/// number of iterations to run. The harness calibrates the iteration count
+/// until a run takes at least min_time seconds, repeats the measurement a few
+/// times and reports the fastest run.
+namespace bench {
+
+/// Prevents the compiler from optimizing away the computation of a value.
+template <typename T> inline void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile char sink;
+	sink = *(const volatile char*)&value;
+#endif
+}
+
+/// Prevents the compiler from assuming anything about a value's contents.
+template <typename T> inline void clobber(T& value)
+{
+#if defined(__GNUC__)
+	asm volatile("" : "+r,m"(value) : : "memory");
+#else
+	do_not_optimize(value);
+#endif
+}
+
+struct result
+{
+	std::string name;
+	uint64_t iterations;
+	double ns_per_op;
+	double ops_per_s;
+};
+
+struct options
+{
+	bool json;
+	double min_time; // [s]
+	int repetitions;
+	std::string filter;
+
+	options(): json(false), min_time(0.05), repetitions(3) {}
+
+	/// Parses --json, --min-time=<seconds>, --repetitions=<n> and
+	/// --filter=<substring> from the command line. Returns false and prints
+	/// a usage message on unknown arguments.
+	bool parse(int argc, char** argv)
+	{
+		for (int i = 1; i < argc; ++i) {
+			const char* a = argv[i];
+			if (strcmp(a, "--json") == 0) json = true;
+			else if (strncmp(a, "--min-time=", 11) == 0) min_time = atof(a+11);
+			else if (strncmp(a, "--repetitions=", 14) == 0) repetitions = atoi(a+14);
+			else if (strncmp(a, "--filter=", 9) == 0) filter = a+9;
+			else {
+				fprintf(stderr, "usage: %s [--json] [--min-time=<seconds>] [--repetitions=<n>] [--filter=<substring>]\n", argv[0]);
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+class runner
+{
+public:
+	explicit runner(const options& opts): opts(opts) {}
+
+	/// Runs the benchmark f, unless it is excluded by the filter.
+	template <typename F> void run(const std::string& name, F f)
+	{
+		if (!opts.filter.empty() && name.find(opts.filter) == std::string::npos)
+			return;
+
+		// Calibrate the number of iterations.
+		uint64_t n = 1;
+		double t = measure(f, n);
+		while (t < opts.min_time) {
+			double scale = t > 0 ? opts.min_time / t * 1.2 : 10;
+			if (scale > 10) scale = 10;
+			n = (uint64_t)(n * scale) + 1;
+			t = measure(f, n);
+		}
+
+		// Keep the fastest of several repetitions.
+		for (int i = 1; i < opts.repetitions; ++i) {
+			double ti = measure(f, n);
+			if (ti < t) t = ti;
+		}
+
+		result r;
+		r.name = name;
+		r.iterations = n;
+		r.ns_per_op = t * 1e9 / n;
+		r.ops_per_s = n / t;
+		results.push_back(r);
+		if (!opts.json)
+			printf("%-48s %12.3f ns/op %16.0f ops/s\n", r.name.c_str(), r.ns_per_op, r.ops_per_s);
+	}
+
+	/// Writes the collected results as JSON to stdout, if requested.
+	void finish() const
+	{
+		if (!opts.json)
+			return;
+		printf("{\n  \"benchmarks\": [");
+		for (size_t i = 0; i < results.size(); ++i) {
+			const result& r = results[i];
+			printf("%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.6g, \"ops_per_s\": %.6g}",
+				i > 0 ? "," : "", r.name.c_str(), (unsigned long long)r.iterations, r.ns_per_op, r.ops_per_s);
+		}
+		printf("\n  ]\n}\n");
+	}
+
+private:
+	options opts;
+	std::vector<result> results;
+
+	template <typename F> static double measure(F& f, uint64_t n)
+	{
+		typedef std::chrono::steady_clock clock;
+		clock::time_point start = clock::now();
+		f(n);
+		return std::chrono::duration<double>(clock::now() - start).count();
+	}
+};
+
+} // namespace bench
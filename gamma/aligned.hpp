@@ -0,0 +1,183 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/simd.hpp"
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#define GAMMA_HAS_ALIGNED
+
+// Opt-in alignment for vectors and matrices. The value types themselves only
+// carry the alignment of their scalars, such that their sizes and layouts
+// stay as tested in the sizes test. Alignment to 16 or more bytes lets
+// arrays of vector4 and matrix4 be loaded with aligned SIMD loads, and keeps
+// a matrix4f within a single 64 byte cache line. There are three ways to
+// request it:
+//
+//     GAMMA_ALIGN(64) matrix4f model;                   // a member or variable
+//     aligned<matrix4f,64> view;                        // a type, see below
+//     std::vector<matrix4f, aligned_allocator<matrix4f,64> > models;
+//
+// and the arena below for many short-lived arrays.
+
+/// Aligns a declaration to n bytes, which must be a power of two.
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#define GAMMA_ALIGN(n) alignas(n)
+#elif defined(__GNUC__)
+#define GAMMA_ALIGN(n) __attribute__((aligned(n)))
+#elif defined(_MSC_VER)
+#define GAMMA_ALIGN(n) __declspec(align(n))
+#endif
+
+/// The alignment of the widest SIMD pack.
+#if defined(GAMMA_SIMD_AVX)
+#define GAMMA_SIMD_ALIGNMENT 32
+#else
+#define GAMMA_SIMD_ALIGNMENT 16
+#endif
+
+namespace gma {
+
+/// Allocates n bytes aligned to a, which must be a power of two. The block
+/// must be released with aligned_free. Returns null if out of memory.
+inline void* aligned_malloc(size_t n, size_t a)
+{
+	if (a < sizeof(void*)) a = sizeof(void*);
+	char* p = (char*)malloc(n + a + sizeof(void*));
+	if (!p) return 0;
+	char* r = (char*)(((uintptr_t)p + sizeof(void*) + a - 1) & ~(uintptr_t)(a - 1));
+	((void**)r)[-1] = p;
+	return r;
+}
+
+inline void aligned_free(void* p)
+{
+	if (p) free(((void**)p)[-1]);
+}
+
+/// A vector or matrix V aligned to A bytes, as a member or array element
+/// type. The value is accessed through value, * or ->. Since the operators
+/// of the value types are templates, which do not consider conversions,
+/// expressions need the value rather than the wrapper. Before C++17 the
+/// standard containers ignore the alignment of their elements, hence arrays
+/// of aligned need an aligned_allocator.
+///
+///     aligned<matrix4f,32> m;
+///     *m = a * b;
+///     vector4f v = *m * x;
+template <typename V, size_t A = GAMMA_SIMD_ALIGNMENT> struct aligned
+{
+	typedef V value_type;
+	typedef typename V::type type;
+	typedef aligned<V,A> self;
+	enum { alignment = A };
+
+	GAMMA_ALIGN(A) V value;
+
+	aligned() {}
+	aligned(const V& v): value(v) {}
+
+	operator V&() { return value; }
+	operator const V&() const { return value; }
+	V& operator* () { return value; }
+	const V& operator* () const { return value; }
+	V* operator-> () { return &value; }
+	const V* operator-> () const { return &value; }
+};
+
+/// A standard allocator whose blocks are aligned to A bytes. Elements whose
+/// size is a multiple of A, such as matrix4f with A = 64, are then all
+/// aligned.
+template <typename T, size_t A = GAMMA_SIMD_ALIGNMENT> struct aligned_allocator
+{
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	template <typename U> struct rebind { typedef aligned_allocator<U,A> other; };
+
+	aligned_allocator() {}
+	template <typename U> aligned_allocator(const aligned_allocator<U,A>&) {}
+
+	T* address(T& r) const { return &r; }
+	const T* address(const T& r) const { return &r; }
+	size_t max_size() const { return (size_t)-1 / sizeof(T); }
+
+	T* allocate(size_t n, const void* = 0)
+	{
+		void* p = aligned_malloc(n * sizeof(T), A);
+		if (!p) throw std::bad_alloc();
+		return (T*)p;
+	}
+	void deallocate(T* p, size_t) { aligned_free(p); }
+
+	void construct(T* p, const T& v) { new((void*)p) T(v); }
+	void destroy(T* p) { p->~T(); }
+};
+
+template <typename T, typename U, size_t A> bool operator== (const aligned_allocator<T,A>&, const aligned_allocator<U,A>&) { return true; }
+template <typename T, typename U, size_t A> bool operator!= (const aligned_allocator<T,A>&, const aligned_allocator<U,A>&) { return false; }
+
+/// Hands out aligned arrays from large blocks, and releases all of them at
+/// once, e.g. for the per-frame transforms of a renderer. Allocation only
+/// bumps a pointer. The elements are default-constructed but never
+/// destroyed, hence the arena is meant for the value types of this library
+/// and other types without destructors.
+class arena
+{
+public:
+	explicit arena(size_t block_size = 1 << 20): block_size(block_size), current(0), used(0) {}
+	~arena() { for (size_t i = 0; i < blocks.size(); ++i) aligned_free(blocks[i].p); }
+
+	/// Returns n bytes aligned to a, which must be a power of two no larger
+	/// than 4096.
+	void* allocate(size_t n, size_t a = GAMMA_SIMD_ALIGNMENT)
+	{
+		size_t offset = (used + a - 1) & ~(a - 1);
+		if (current < blocks.size() && offset + n <= blocks[current].size) {
+			used = offset + n;
+			return blocks[current].p + offset;
+		}
+		// Move on to the next block that fits, keeping the ones skipped for
+		// after the next reset. Requests larger than a block get their own.
+		while (++current < blocks.size() && n > blocks[current].size) {}
+		if (current >= blocks.size()) {
+			block b;
+			b.size = n > block_size ? n : block_size;
+			b.p = (char*)aligned_malloc(b.size, 4096);
+			if (!b.p) throw std::bad_alloc();
+			blocks.push_back(b);
+			current = blocks.size() - 1;
+		}
+		used = n;
+		return blocks[current].p;
+	}
+
+	/// Returns an array of n default-constructed T aligned to A bytes.
+	template <typename T, size_t A> T* allocate(size_t n)
+	{
+		T* p = (T*)allocate(n * sizeof(T), A);
+		for (size_t i = 0; i < n; ++i)
+			new((void*)(p + i)) T();
+		return p;
+	}
+
+	template <typename T> T* allocate(size_t n) { return allocate<T,GAMMA_SIMD_ALIGNMENT>(n); }
+
+	/// Releases all arrays, keeping the blocks for reuse.
+	void reset() { current = 0; used = 0; }
+
+private:
+	struct block { char* p; size_t size; };
+	std::vector<block> blocks;
+	size_t block_size, current, used;
+
+	arena(const arena&);
+	arena& operator= (const arena&);
+};
+
+} // namespace gma
@@ -0,0 +1,227 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/sphere.hpp"
+#include "gamma/fixed_point.hpp"
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+#define GAMMA_HAS_BINARY
+
+// A binary format for arrays of scalars, vectors, matrices, spheres and
+// fixed_point numbers, which can be memory-mapped and used in place. A file
+// consists of a 32 byte header followed by the elements exactly as they are
+// laid out in memory, with all scalars in little-endian byte order:
+//
+//     offset  size  field
+//          0     4  magic "GMAB"
+//          4     2  format version, currently 1
+//          6     1  shape: 0 scalar, 1 vector, 2 matrix, 3 sphere
+//          7     1  dimension: 1 for scalars, N for vectorN, matrixN and
+//                   sphere<vectorN>
+//          8     1  scalar kind: 1 signed integer, 2 unsigned integer,
+//                   3 floating point
+//          9     1  scalar size in bytes
+//         10     1  fraction bits of fixed_point scalars, 0 otherwise
+//         11     1  reserved, 0
+//         12     4  element size in bytes
+//         16     8  number of elements
+//         24     8  reserved, 0
+//
+// Matrices are stored in column-major order, and spheres as their center
+// followed by their radius. The elements start at offset 32, hence a file
+// that is mapped at a page boundary can be viewed in place as an array. On
+// big-endian machines, the elements have to be read into a copy instead.
+
+namespace gma {
+namespace binary {
+
+const uint16_t version = 1;
+const size_t header_size = 32;
+
+enum shape_type { scalar_shape = 0, vector_shape = 1, matrix_shape = 2, sphere_shape = 3 };
+enum scalar_kind { signed_integer = 1, unsigned_integer = 2, floating_point = 3 };
+
+/// Describes the scalar type T. Specialized below for the fundamental types
+/// and fixed_point.
+template <typename T> struct scalar_traits;
+
+#define GAMMA_BINARY_SCALAR(T, k) \
+template <> struct scalar_traits<T> { enum { kind = k, size = sizeof(T), fraction_bits = 0 }; };
+GAMMA_BINARY_SCALAR(int8_t, signed_integer)
+GAMMA_BINARY_SCALAR(int16_t, signed_integer)
+GAMMA_BINARY_SCALAR(int32_t, signed_integer)
+GAMMA_BINARY_SCALAR(int64_t, signed_integer)
+GAMMA_BINARY_SCALAR(uint8_t, unsigned_integer)
+GAMMA_BINARY_SCALAR(uint16_t, unsigned_integer)
+GAMMA_BINARY_SCALAR(uint32_t, unsigned_integer)
+GAMMA_BINARY_SCALAR(uint64_t, unsigned_integer)
+GAMMA_BINARY_SCALAR(float, floating_point)
+GAMMA_BINARY_SCALAR(double, floating_point)
+#undef GAMMA_BINARY_SCALAR
+
+template <int Ia, int Da> struct scalar_traits<fixed_point<Ia,Da> >
+{
+	enum {
+		kind = signed_integer,
+		size = sizeof(typename fixed_point<Ia,Da>::value_type),
+		fraction_bits = Da
+	};
+};
+
+/// Describes the element type T as its shape, dimension and scalar type.
+template <typename T> struct element_traits
+{
+	typedef T scalar_type;
+	enum { shape = scalar_shape, dimension = 1 };
+};
+template <typename T> struct element_traits<vector2<T> > { typedef T scalar_type; enum { shape = vector_shape, dimension = 2 }; };
+template <typename T> struct element_traits<vector3<T> > { typedef T scalar_type; enum { shape = vector_shape, dimension = 3 }; };
+template <typename T> struct element_traits<vector4<T> > { typedef T scalar_type; enum { shape = vector_shape, dimension = 4 }; };
+template <typename T> struct element_traits<matrix2<T> > { typedef T scalar_type; enum { shape = matrix_shape, dimension = 2 }; };
+template <typename T> struct element_traits<matrix3<T> > { typedef T scalar_type; enum { shape = matrix_shape, dimension = 3 }; };
+template <typename T> struct element_traits<matrix4<T> > { typedef T scalar_type; enum { shape = matrix_shape, dimension = 4 }; };
+template <typename V> struct element_traits<sphere<V> >
+{
+	typedef typename V::type scalar_type;
+	enum { shape = sphere_shape, dimension = element_traits<V>::dimension };
+};
+
+namespace detail {
+
+inline bool little_endian() { const uint16_t x = 1; return *(const uint8_t*)&x == 1; }
+
+inline void put(uint8_t* p, uint64_t v, int n) { for (int i = 0; i < n; ++i) p[i] = (uint8_t)(v >> (8*i)); }
+inline uint64_t get(const uint8_t* p, int n) { uint64_t v = 0; for (int i = 0; i < n; ++i) v |= (uint64_t)p[i] << (8*i); return v; }
+
+/// Reverses the byte order of each of the n bytes/size scalars at p.
+inline void swap_bytes(void* p, size_t n, size_t size)
+{
+	uint8_t* b = (uint8_t*)p;
+	for (size_t i = 0; i + size <= n; i += size)
+		for (size_t j = 0; j < size/2; ++j) {
+			uint8_t t = b[i+j]; b[i+j] = b[i+size-1-j]; b[i+size-1-j] = t;
+		}
+}
+
+template <typename T> inline void write_header(uint8_t* h, uint64_t count)
+{
+	typedef element_traits<T> E;
+	typedef scalar_traits<typename E::scalar_type> S;
+	memset(h, 0, header_size);
+	memcpy(h, "GMAB", 4);
+	put(h+4, version, 2);
+	h[6] = E::shape;
+	h[7] = E::dimension;
+	h[8] = S::kind;
+	h[9] = S::size;
+	h[10] = S::fraction_bits;
+	put(h+12, sizeof(T), 4);
+	put(h+16, count, 8);
+}
+
+/// Returns whether h describes an array of T, and stores its length in n.
+template <typename T> inline bool read_header(const uint8_t* h, uint64_t& n)
+{
+	typedef element_traits<T> E;
+	typedef scalar_traits<typename E::scalar_type> S;
+	if (memcmp(h, "GMAB", 4) != 0 || get(h+4, 2) == 0 || get(h+4, 2) > version)
+		return false;
+	if (h[6] != E::shape || h[7] != E::dimension || h[8] != S::kind || h[9] != S::size || h[10] != S::fraction_bits)
+		return false;
+	if (get(h+12, 4) != sizeof(T))
+		return false;
+	n = get(h+16, 8);
+	return true;
+}
+
+} // namespace detail
+
+/// Returns the number of bytes that n elements of type T occupy.
+template <typename T> size_t size(size_t n) { return header_size + n * sizeof(T); }
+
+/// Stores the n elements at v in the memory at p, which must hold size<T>(n)
+/// bytes. Returns the number of bytes written.
+template <typename T> size_t write(void* p, const T* v, size_t n)
+{
+	typedef element_traits<T> E;
+	uint8_t* h = (uint8_t*)p;
+	detail::write_header<T>(h, n);
+	memcpy(h + header_size, v, n * sizeof(T));
+	if (!detail::little_endian())
+		detail::swap_bytes(h + header_size, n * sizeof(T), scalar_traits<typename E::scalar_type>::size);
+	return size<T>(n);
+}
+
+/// Writes the n elements at v to o. Returns whether o is still good.
+template <typename T> bool write(std::ostream& o, const T* v, size_t n)
+{
+	typedef element_traits<T> E;
+	uint8_t h[header_size];
+	detail::write_header<T>(h, n);
+	o.write((const char*)h, header_size);
+	if (detail::little_endian()) {
+		o.write((const char*)v, n * sizeof(T));
+	} else {
+		// Swap in chunks to bound the size of the copy.
+		T buffer[256];
+		for (size_t i = 0; i < n; i += 256) {
+			size_t k = n - i < 256 ? n - i : 256;
+			memcpy(buffer, v + i, k * sizeof(T));
+			detail::swap_bytes(buffer, k * sizeof(T), scalar_traits<typename E::scalar_type>::size);
+			o.write((const char*)buffer, k * sizeof(T));
+		}
+	}
+	return o.good();
+}
+
+/// Returns the elements of the array of T in the size bytes at p, without
+/// copying them, and stores their number in n. Returns null if p holds no
+/// complete array of T, if the elements are not aligned to the size of
+/// their scalars, or on big-endian machines.
+template <typename T> const T* view(const void* p, size_t size, size_t& n)
+{
+	typedef element_traits<T> E;
+	const uint8_t* h = (const uint8_t*)p;
+	uint64_t count;
+	if (!detail::little_endian() || size < header_size || !detail::read_header<T>(h, count))
+		return 0;
+	if (count > (size - header_size) / sizeof(T))
+		return 0;
+	if ((uintptr_t)(h + header_size) % scalar_traits<typename E::scalar_type>::size != 0)
+		return 0;
+	n = (size_t)count;
+	return (const T*)(h + header_size);
+}
+
+/// Reads an array of T from i into v. Returns false, leaving v unspecified,
+/// if i holds no complete array of T.
+template <typename T> bool read(std::istream& i, std::vector<T>& v)
+{
+	typedef element_traits<T> E;
+	uint8_t h[header_size];
+	uint64_t count;
+	if (!i.read((char*)h, header_size) || !detail::read_header<T>(h, count))
+		return false;
+	// Grow in steps, such that a corrupt count fails at the end of i rather
+	// than in a huge allocation.
+	v.clear();
+	const size_t step = (1 << 20) / sizeof(T) + 1;
+	for (uint64_t done = 0; done < count;) {
+		size_t k = (size_t)(count - done < step ? count - done : step);
+		v.resize((size_t)done + k);
+		if (!i.read((char*)&v[(size_t)done], k * sizeof(T)))
+			return false;
+		done += k;
+	}
+	if (!detail::little_endian() && !v.empty())
+		detail::swap_bytes(&v[0], v.size() * sizeof(T), scalar_traits<typename E::scalar_type>::size);
+	return true;
+}
+
+} // namespace binary
+} // namespace gma
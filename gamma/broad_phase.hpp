@@ -0,0 +1,321 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/sphere.hpp"
+#include "gamma/intersect.hpp"
+#include "gamma/parallel.hpp"
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#define GAMMA_HAS_BROAD_PHASE
+
+namespace gma {
+
+/// Default number of objects per worker below which broad_phase does not
+/// spawn any threads.
+const size_t broad_phase_grain = 4096;
+
+/// Finds all pairs of overlapping spheres in a set of moving spheres, as the
+/// broad phase of a physics step. The spheres are sorted into a uniform grid
+/// of cubic cells at least as wide as the largest diameter, by the cell of
+/// their center, such that a sphere can only overlap spheres in the 27 cells
+/// around its own. Cells are looked up in a hash table with a bucket per
+/// sphere, which is stored as one array of entries sorted by bucket. The
+/// table wraps the grid around a box of buckets, such that neighboring cells
+/// are stored close to each other and the cells along x contiguously.
+///
+/// Building the grid and finding the pairs are split across all hardware
+/// threads, each of which emits its pairs into a buffer of its own. Spheres
+/// that stay within their cell are updated in place. Spheres that leave it
+/// are tested separately until too many have done so, at which point the
+/// grid is rebuilt.
+template <typename T> struct broad_phase
+{
+	typedef T scalar_type;
+	typedef vector3<T> vector_type;
+	typedef vector3<int> cell_type;
+	typedef sphere<vector_type> sphere_type;
+	typedef broad_phase<T> self;
+
+	/// Indices of two overlapping spheres, with a < b.
+	struct pair
+	{
+		uint32_t a, b;
+	};
+
+	struct entry
+	{
+		sphere_type s;
+		cell_type cell;
+		uint32_t index; // of the sphere, or invalid if it has moved
+	};
+
+	enum { invalid = 0xffffffffu, moved_flag = 0x80000000u };
+
+	T cell_size;
+	size_t max_moved; // spheres that may leave their cell before a rebuild
+	unsigned max_workers; // see parallel_for
+	size_t grain; // spheres per worker, see parallel_for
+
+	std::vector<entry> items; // sorted by bucket
+	std::vector<uint32_t> start; // of each bucket in items, plus the end
+	std::vector<entry> moved; // spheres that left their cell since the build
+	std::vector<uint32_t> slot; // of each sphere in items, or in moved with moved_flag set
+
+	broad_phase(unsigned max_workers = 0): cell_size(0), max_moved(256), max_workers(max_workers), grain(broad_phase_grain), requested_size(0) {}
+
+	/// Number of spheres.
+	size_t size() const { return slot.size(); }
+
+	/// Returns the cell that contains the point p.
+	cell_type cell(const vector_type& p) const
+	{
+		return cell_type((int)std::floor(p.x * inv_size), (int)std::floor(p.y * inv_size), (int)std::floor(p.z * inv_size));
+	}
+
+	/// Sorts the n spheres at s into the grid. If size is zero, the cells are
+	/// as wide as the largest diameter, otherwise they are size wide, which
+	/// must be at least the largest diameter.
+	void build(const sphere_type* s, size_t n, T size = 0)
+	{
+		requested_size = size;
+		if (size <= 0) {
+			std::vector<T> widest(parallel_workers(n, grain, max_workers), T(0));
+			parallel_for(n, grain, [&](size_t begin, size_t end, unsigned w) {
+				T d = 0;
+				for (size_t i = begin; i < end; ++i)
+					if (2*s[i].r > d) d = 2*s[i].r;
+				widest[w] = d;
+			}, max_workers);
+			for (size_t w = 0; w < widest.size(); ++w)
+				if (widest[w] > size) size = widest[w];
+			if (size <= 0) size = 1;
+		}
+		cell_size = size;
+		inv_size = T(1) / size;
+
+		int bits = 0;
+		while (((size_t)1 << bits) < n) ++bits;
+		const size_t buckets = (size_t)1 << bits;
+		const int bx = (bits + 2) / 3, by = (bits - bx + 1) / 2;
+		shift_y = bx;
+		shift_z = bx + by;
+		mask_x = (1u << bx) - 1;
+		mask_y = (1u << by) - 1;
+		mask_z = (1u << (bits - bx - by)) - 1;
+		items.resize(n);
+		start.resize(buckets + 1);
+		slot.resize(n);
+		moved.clear();
+
+		// Count the spheres per bucket and worker, then turn the counts into
+		// the offset at which each worker stores its spheres in the bucket.
+		// The chunks of spheres and buckets are the same in every pass.
+		const size_t workers = parallel_workers(n, grain, max_workers);
+		counts.assign(workers * buckets, 0);
+		keys.resize(n);
+		parallel_for(n, grain, [&](size_t begin, size_t end, unsigned w) {
+			uint32_t* c = &counts[w * buckets];
+			for (size_t i = begin; i < end; ++i) {
+				entry& e = items[i];
+				e.cell = cell(s[i].c);
+				keys[i] = bucket(e.cell);
+				++c[keys[i]];
+			}
+		}, max_workers);
+
+		std::vector<uint32_t> totals(parallel_workers(buckets, grain, max_workers));
+		parallel_for(buckets, grain, [&](size_t begin, size_t end, unsigned r) {
+			uint32_t total = 0;
+			for (size_t b = begin; b < end; ++b) {
+				uint32_t sum = 0;
+				for (size_t w = 0; w < workers; ++w) {
+					uint32_t c = counts[w * buckets + b];
+					counts[w * buckets + b] = sum;
+					sum += c;
+				}
+				start[b] = sum;
+				total += sum;
+			}
+			totals[r] = total;
+		}, max_workers);
+		uint32_t run = 0;
+		for (size_t r = 0; r < totals.size(); ++r) {
+			uint32_t t = totals[r];
+			totals[r] = run;
+			run += t;
+		}
+		parallel_for(buckets, grain, [&](size_t begin, size_t end, unsigned r) {
+			uint32_t run = totals[r];
+			for (size_t b = begin; b < end; ++b) {
+				uint32_t sum = start[b];
+				start[b] = run;
+				for (size_t w = 0; w < workers; ++w)
+					counts[w * buckets + b] += run;
+				run += sum;
+			}
+		}, max_workers);
+		start[buckets] = (uint32_t)n;
+
+		// The cells were stored in items in the order of the spheres, hence
+		// the scatter goes through a second array.
+		sorted.resize(n);
+		parallel_for(n, grain, [&](size_t begin, size_t end, unsigned w) {
+			uint32_t* c = &counts[w * buckets];
+			for (size_t i = begin; i < end; ++i) {
+				uint32_t p = c[keys[i]]++;
+				entry& e = sorted[p];
+				e.s = s[i];
+				e.cell = items[i].cell;
+				e.index = (uint32_t)i;
+				slot[i] = p;
+			}
+		}, max_workers);
+		items.swap(sorted);
+	}
+
+	/// Updates the grid after the spheres at s, the same number as passed to
+	/// build, have moved. Spheres still in their cell are updated in place.
+	/// The grid is rebuilt if more than max_moved spheres have left their
+	/// cell since the last build, or if a sphere no longer fits into a cell.
+	/// Returns whether the grid was rebuilt.
+	bool update(const sphere_type* s)
+	{
+		const size_t n = slot.size();
+		const size_t workers = parallel_workers(n, grain, max_workers);
+		std::vector<std::vector<uint32_t> > left(workers);
+		std::vector<char> too_large(workers, 0);
+		parallel_for(n, grain, [&](size_t begin, size_t end, unsigned w) {
+			for (size_t i = begin; i < end; ++i) {
+				if (2*s[i].r > cell_size)
+					too_large[w] = 1;
+				cell_type c = cell(s[i].c);
+				uint32_t p = slot[i];
+				if (p & moved_flag) {
+					moved[p & ~moved_flag].s = s[i];
+					moved[p & ~moved_flag].cell = c;
+				} else if (items[p].cell == c) {
+					items[p].s = s[i];
+				} else {
+					left[w].push_back((uint32_t)i);
+				}
+			}
+		}, max_workers);
+
+		size_t count = moved.size();
+		bool rebuild = false;
+		for (size_t w = 0; w < workers; ++w) {
+			count += left[w].size();
+			rebuild |= (too_large[w] != 0);
+		}
+		if (rebuild || count > max_moved) {
+			build(s, n, rebuild ? 0 : requested_size);
+			return true;
+		}
+
+		for (size_t w = 0; w < workers; ++w) {
+			for (size_t k = 0; k < left[w].size(); ++k) {
+				uint32_t i = left[w][k];
+				entry& e = items[slot[i]];
+				e.index = invalid;
+				entry m = { s[i], cell(s[i].c), i };
+				slot[i] = (uint32_t)moved.size() | moved_flag;
+				moved.push_back(m);
+			}
+		}
+		return false;
+	}
+
+	/// Finds all pairs of overlapping or touching spheres. out is resized to
+	/// one buffer per worker, each of which is cleared and filled with the
+	/// pairs found by that worker. Each pair is reported once, in no
+	/// particular order.
+	void pairs(std::vector<std::vector<pair> >& out) const
+	{
+		const size_t n = items.size();
+		out.resize(parallel_workers(n, grain, max_workers));
+		for (size_t w = 0; w < out.size(); ++w)
+			out[w].clear();
+
+		// Pairs in the same cell are found from the entry stored first, pairs
+		// in neighboring cells from the entry whose cell comes first in the
+		// order of z, y and x. Hence only the 13 cells following an entry's
+		// own need to be searched, in one partial and four full rows along x.
+		// Moved entries search all 27 cells.
+		parallel_for(n, grain, [&](size_t begin, size_t end, unsigned w) {
+			std::vector<pair>& o = out[w];
+			for (size_t p = begin; p < end; ++p) {
+				const entry& e = items[p];
+				if (e.index == (uint32_t)invalid)
+					continue;
+				const cell_type& c = e.cell;
+				search(e, c.x, c.x + 1, c.y, c.z, (uint32_t)p + 1, o);
+				search(e, c.x - 1, c.x + 1, c.y + 1, c.z, 0, o);
+				for (int dy = -1; dy <= 1; ++dy)
+					search(e, c.x - 1, c.x + 1, c.y + dy, c.z + 1, 0, o);
+			}
+		}, max_workers);
+
+		std::vector<pair>& o = out[0];
+		for (size_t k = 0; k < moved.size(); ++k) {
+			const entry& e = moved[k];
+			for (int dz = -1; dz <= 1; ++dz)
+				for (int dy = -1; dy <= 1; ++dy)
+					search(e, e.cell.x - 1, e.cell.x + 1, e.cell.y + dy, e.cell.z + dz, 0, o);
+			for (size_t j = k + 1; j < moved.size(); ++j)
+				if (intersects(e.s, moved[j].s))
+					o.push_back(make_pair(e.index, moved[j].index));
+		}
+	}
+
+private:
+	T requested_size, inv_size;
+	int shift_y, shift_z;
+	uint32_t mask_x, mask_y, mask_z;
+	std::vector<uint32_t> counts, keys;
+	std::vector<entry> sorted;
+
+	uint32_t bucket(const cell_type& c) const
+	{
+		return bucket(c.x, c.y, c.z);
+	}
+
+	uint32_t bucket(int x, int y, int z) const
+	{
+		return ((uint32_t)x & mask_x) | ((uint32_t)y & mask_y) << shift_y | ((uint32_t)z & mask_z) << shift_z;
+	}
+
+	static pair make_pair(uint32_t a, uint32_t b)
+	{
+		pair r = { a < b ? a : b, a < b ? b : a };
+		return r;
+	}
+
+	/// Appends the pairs of e with the entries in the cells x0 to x1 of the
+	/// row at y and z, skipping the entries of e's own cell stored before
+	/// first. The buckets of the cells are contiguous unless the row wraps
+	/// around the table, and are then scanned at once.
+	void search(const entry& e, int x0, int x1, int y, int z, uint32_t first, std::vector<pair>& o) const
+	{
+		const uint32_t b = bucket(x0, y, z);
+		if (((uint32_t)x0 & mask_x) + (uint32_t)(x1 - x0) > mask_x) {
+			for (int x = x0; x <= x1; ++x)
+				search(e, x, x, y, z, x == e.cell.x && y == e.cell.y && z == e.cell.z ? first : 0, o);
+			return;
+		}
+		const uint32_t end = start[b + (x1 - x0) + 1];
+		for (uint32_t q = start[b] > first ? start[b] : first; q < end; ++q) {
+			const entry& f = items[q];
+			if (f.index != (uint32_t)invalid && f.cell.y == y && f.cell.z == z &&
+				f.cell.x >= x0 && f.cell.x <= x1 && intersects(e.s, f.s))
+				o.push_back(make_pair(e.index, f.index));
+		}
+	}
+};
+
+namespace convenience {
+	typedef broad_phase<float> broad_phasef;
+	typedef broad_phase<double> broad_phased;
+}
+} // namespace gma
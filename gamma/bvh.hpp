@@ -0,0 +1,324 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/line.hpp"
+#include "gamma/sphere.hpp"
+#include "gamma/intersect.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#define GAMMA_HAS_BVH
+
+namespace gma {
+
+/// A bounding volume hierarchy over an array of spheres, for ray casts and
+/// overlap queries in logarithmic rather than linear time. The tree is built
+/// with the surface area heuristic evaluated over a fixed number of bins
+/// along the axis of largest extent. The nodes are stored in a single array
+/// in depth-first order, and the spheres are copied in the order of the
+/// leaves, such that a query walks memory mostly forwards.
+template <typename T> struct bvh
+{
+	typedef T scalar_type;
+	typedef vector3<T> vector_type;
+	typedef sphere<vector_type> sphere_type;
+	typedef line<vector_type> line_type;
+	typedef bvh<T> self;
+
+	/// A node with the axis-aligned bounds [lo,hi] of its subtree. Inner nodes
+	/// have count == 0; their first child directly follows them, the second
+	/// is at index offset. Leaves cover the spheres [offset,offset+count).
+	struct node
+	{
+		vector_type lo;
+		uint32_t offset;
+		vector_type hi;
+		uint32_t count;
+	};
+
+	/// The closest intersection of a ray cast, as the index of the sphere in
+	/// the array the tree was built from and the ray parameter.
+	struct hit
+	{
+		size_t index;
+		T t;
+	};
+
+	enum { bins = 16, max_leaf = 4, max_depth = 128 };
+
+	std::vector<node> nodes;
+	std::vector<sphere_type> spheres; // in leaf order
+	std::vector<uint32_t> indices; // index of spheres[i] in the original array
+
+	bvh() {}
+	bvh(const sphere_type* s, size_t n) { build(s, n); }
+
+	/// Builds the tree over the n spheres at s.
+	void build(const sphere_type* s, size_t n)
+	{
+		nodes.clear();
+		spheres.assign(s, s + n);
+		indices.resize(n);
+		for (size_t i = 0; i < n; ++i) indices[i] = (uint32_t)i;
+		if (n == 0)
+			return;
+		nodes.reserve(2*n - 1);
+		nodes.push_back(node());
+		build(0, 0, (uint32_t)n, 0);
+	}
+
+	/// Updates the tree after the spheres at s, the same array the tree was
+	/// built from, have moved or changed their radii. The bounds are
+	/// recomputed while the structure is kept, so the queries stay correct
+	/// but become slower the further the spheres move from where they were
+	/// at build time; rebuild at that point.
+	void refit(const sphere_type* s)
+	{
+		for (size_t i = 0; i < spheres.size(); ++i)
+			spheres[i] = s[indices[i]];
+		// Children are stored after their parents.
+		for (size_t i = nodes.size(); i-- > 0;) {
+			node& n = nodes[i];
+			if (n.count) {
+				bounds(n.offset, n.count, n.lo, n.hi);
+			} else {
+				const node &a = nodes[i+1], &b = nodes[n.offset];
+				n.lo = min(a.lo, b.lo);
+				n.hi = max(a.hi, b.hi);
+			}
+		}
+	}
+
+	/// Finds the closest sphere hit by the ray l within the parameters
+	/// [0,tmax], as per intersect(line, sphere).
+	bool first_hit(const line_type& l, hit& h, T tmax = std::numeric_limits<T>::infinity()) const
+	{
+		return cast<false>(l, h, tmax);
+	}
+
+	/// Returns whether the ray l hits any sphere within the parameters
+	/// [0,tmax]. Stops at the first one found.
+	bool any_hit(const line_type& l, T tmax = std::numeric_limits<T>::infinity()) const
+	{
+		hit h;
+		return cast<true>(l, h, tmax);
+	}
+
+	/// Calls f(index) for each sphere that overlaps s, with the index into
+	/// the array the tree was built from.
+	template <typename F> void overlap(const sphere_type& s, F f) const
+	{
+		if (nodes.empty())
+			return;
+		uint32_t stack[max_depth];
+		int sp = 0;
+		uint32_t i = 0;
+		for (;;) {
+			const node& n = nodes[i];
+			if (intersects(s, n.lo, n.hi)) {
+				if (n.count) {
+					for (uint32_t k = n.offset; k < n.offset + n.count; ++k)
+						if (intersects(s, spheres[k]))
+							f((size_t)indices[k]);
+				} else {
+					stack[sp++] = n.offset;
+					i = i + 1;
+					continue;
+				}
+			}
+			if (sp == 0)
+				break;
+			i = stack[--sp];
+		}
+	}
+
+	/// Appends the indices of the spheres that overlap s to r and returns
+	/// their number.
+	size_t overlap(const sphere_type& s, std::vector<size_t>& r) const
+	{
+		size_t n = r.size();
+		overlap(s, appender(r));
+		return r.size() - n;
+	}
+
+private:
+	struct appender
+	{
+		std::vector<size_t>& r;
+		explicit appender(std::vector<size_t>& r): r(r) {}
+		void operator() (size_t i) { r.push_back(i); }
+	};
+
+	static vector_type min(const vector_type& a, const vector_type& b) { return vector_type(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z); }
+	static vector_type max(const vector_type& a, const vector_type& b) { return vector_type(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z); }
+	static T area(const vector_type& lo, const vector_type& hi) { vector_type d = hi - lo; return d.x*d.y + d.y*d.z + d.z*d.x; }
+
+	/// Stores the bounds of the spheres [first,first+count) in lo and hi.
+	void bounds(uint32_t first, uint32_t count, vector_type& lo, vector_type& hi) const
+	{
+		lo = spheres[first].c - spheres[first].r;
+		hi = spheres[first].c + spheres[first].r;
+		for (uint32_t k = first + 1; k < first + count; ++k) {
+			lo = min(lo, spheres[k].c - spheres[k].r);
+			hi = max(hi, spheres[k].c + spheres[k].r);
+		}
+	}
+
+	/// Builds node i over the spheres [first,first+count).
+	void build(size_t i, uint32_t first, uint32_t count, int depth)
+	{
+		vector_type lo, hi;
+		bounds(first, count, lo, hi);
+		nodes[i].lo = lo;
+		nodes[i].hi = hi;
+		nodes[i].offset = first;
+		nodes[i].count = count;
+		if (count <= 1)
+			return;
+
+		// Pick the axis along which the centers spread the most.
+		vector_type clo = spheres[first].c, chi = clo;
+		for (uint32_t k = first + 1; k < first + count; ++k) {
+			clo = min(clo, spheres[k].c);
+			chi = max(chi, spheres[k].c);
+		}
+		vector_type e = chi - clo;
+		int axis = e.x > e.y ? (e.x > e.z ? 0 : 2) : (e.y > e.z ? 1 : 2);
+
+		uint32_t mid = first + count / 2;
+		if (e(axis) > 0 && depth < max_depth / 2) {
+			// Bin the spheres by center and evaluate the cost of splitting
+			// after each bin, from the areas and counts on either side.
+			T scale = T(bins) / e(axis);
+			uint32_t n[bins] = {0};
+			vector_type blo[bins], bhi[bins];
+			for (uint32_t k = first; k < first + count; ++k) {
+				int b = bin(spheres[k].c(axis), clo(axis), scale);
+				vector_type l = spheres[k].c - spheres[k].r, h = spheres[k].c + spheres[k].r;
+				blo[b] = n[b] ? min(blo[b], l) : l;
+				bhi[b] = n[b] ? max(bhi[b], h) : h;
+				++n[b];
+			}
+			T right[bins];
+			uint32_t nr = 0;
+			vector_type rlo, rhi;
+			for (int b = bins - 1; b > 0; --b) {
+				if (n[b]) {
+					rlo = nr ? min(rlo, blo[b]) : blo[b];
+					rhi = nr ? max(rhi, bhi[b]) : bhi[b];
+					nr += n[b];
+				}
+				right[b] = nr ? nr * area(rlo, rhi) : 0;
+			}
+			int best = -1;
+			T best_cost = 0;
+			uint32_t nl = 0;
+			vector_type llo, lhi;
+			for (int b = 0; b < bins - 1; ++b) {
+				if (n[b]) {
+					llo = nl ? min(llo, blo[b]) : blo[b];
+					lhi = nl ? max(lhi, bhi[b]) : bhi[b];
+					nl += n[b];
+				}
+				if (nl == 0 || nl == count)
+					continue;
+				T cost = nl * area(llo, lhi) + right[b+1];
+				if (best < 0 || cost < best_cost) { best = b; best_cost = cost; }
+			}
+
+			// Splitting costs one traversal step plus the expected number of
+			// sphere tests in the children, relative to testing all here.
+			if (best < 0 || (count <= max_leaf && 1 + best_cost / area(lo, hi) >= count))
+				return;
+
+			uint32_t a = first, z = first + count;
+			while (a < z) {
+				if (bin(spheres[a].c(axis), clo(axis), scale) <= best) {
+					++a;
+				} else {
+					--z;
+					std::swap(spheres[a], spheres[z]);
+					std::swap(indices[a], indices[z]);
+				}
+			}
+			mid = a;
+		} else if (count <= max_leaf) {
+			return;
+		}
+
+		// Children are stored depth-first, the first directly after node i.
+		nodes.push_back(node());
+		nodes[i].count = 0;
+		build(i + 1, first, mid - first, depth + 1);
+		nodes[i].offset = (uint32_t)nodes.size();
+		nodes.push_back(node());
+		build(nodes[i].offset, mid, first + count - mid, depth + 1);
+	}
+
+	static int bin(T c, T lo, T scale)
+	{
+		int b = (int)((c - lo) * scale);
+		return b < 0 ? 0 : (b >= bins ? bins - 1 : b);
+	}
+
+	/// Traverses the tree front to back along l, skipping subtrees whose
+	/// bounds lie beyond the closest hit found so far.
+	template <bool any> bool cast(const line_type& l, hit& h, T tmax) const
+	{
+		if (nodes.empty())
+			return false;
+		const vector_type inv(T(1) / l.d.x, T(1) / l.d.y, T(1) / l.d.z);
+		uint32_t stack[max_depth];
+		T entry[max_depth]; // where the ray enters the deferred subtrees
+		int sp = 0;
+		uint32_t i = 0;
+		bool found = false;
+		T t;
+		if (!intersect(l.p, inv, nodes[0].lo, nodes[0].hi, tmax, t))
+			return false;
+		for (;;) {
+			const node& n = nodes[i];
+			if (n.count) {
+				for (uint32_t k = n.offset; k < n.offset + n.count; ++k) {
+					if (intersect(l, spheres[k], t) && t <= tmax) {
+						h.index = indices[k];
+						h.t = tmax = t;
+						found = true;
+						if (any)
+							return true;
+					}
+				}
+			} else {
+				const node &a = nodes[i+1], &b = nodes[n.offset];
+				T ta, tb;
+				bool ha = intersect(l.p, inv, a.lo, a.hi, tmax, ta);
+				bool hb = intersect(l.p, inv, b.lo, b.hi, tmax, tb);
+				if (ha && hb) {
+					if (tb < ta) {
+						stack[sp] = i + 1; entry[sp++] = ta;
+						i = n.offset;
+					} else {
+						stack[sp] = n.offset; entry[sp++] = tb;
+						i = i + 1;
+					}
+					continue;
+				}
+				if (ha) { i = i + 1; continue; }
+				if (hb) { i = n.offset; continue; }
+			}
+			do {
+				if (sp == 0)
+					return found;
+				i = stack[--sp];
+			} while (entry[sp] > tmax);
+		}
+	}
+};
+
+namespace convenience {
+	typedef bvh<float> bvhf;
+	typedef bvh<double> bvhd;
+}
+} // namespace gma
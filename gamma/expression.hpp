@@ -0,0 +1,202 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/simd.hpp"
+#define GAMMA_HAS_EXPRESSION
+
+// Opt-in expression templates for component-wise arithmetic on vectors and
+// matrices. The free operators in vector.hpp and matrix.hpp return a full
+// temporary per operation; wrapping the operands in expr() instead builds a
+// tree of lightweight nodes that is evaluated in a single pass once it is
+// converted to a value:
+//
+//     vector4f r = expr(a)*s + expr(b)*t - expr(c);
+//     m = eval(expr(m0)*(1-t) + expr(m1)*t);
+//
+// Sums and differences involving a product are fused into fmadd, fmsub and
+// fnmadd, which round once if the target supports fused multiply-adds. For
+// float and double the nodes are evaluated on SIMD packs.
+//
+// The nodes refer to their operands, hence an expression must be evaluated
+// within the statement that creates it. Only the component-wise operations
+// are supported: sums, differences, products with scalars, and the mul() and
+// div() of the vector and matrix types. Matrix products are left to
+// matrix.hpp.
+
+namespace gma {
+namespace expression {
+
+/// Fused multiply-adds on scalars, see simd.hpp for the packed versions.
+template <typename T> inline T fmadd(T a, T b, T c) { return a * b + c; }
+template <typename T> inline T fmsub(T a, T b, T c) { return a * b - c; }
+template <typename T> inline T fnmadd(T a, T b, T c) { return c - a * b; }
+#ifdef FP_FAST_FMAF
+inline float fmadd(float a, float b, float c) { return fmaf(a, b, c); }
+inline float fmsub(float a, float b, float c) { return fmaf(a, b, -c); }
+inline float fnmadd(float a, float b, float c) { return fmaf(-a, b, c); }
+#endif
+#ifdef FP_FAST_FMA
+inline double fmadd(double a, double b, double c) { return fma(a, b, c); }
+inline double fmsub(double a, double b, double c) { return fma(a, b, -c); }
+inline double fnmadd(double a, double b, double c) { return fma(-a, b, c); }
+#endif
+
+/// Reads a single component or a pack V of consecutive components. The
+/// primary template handles scalars, the specializations SIMD packs.
+template <typename V> struct access
+{
+	static V load(const V* p) { return *p; }
+	static V splat(V s) { return s; }
+	static void store(V a, V* p) { *p = a; }
+};
+
+#define GAMMA_EXPRESSION_PACK(P) \
+template <> struct access<P> \
+{ \
+	typedef P::scalar_type T; \
+	static P load(const T* p) { return P::load(p); } \
+	static P splat(T s) { return P(s); } \
+	static void store(P a, T* p) { a.store(p); } \
+};
+#ifdef GAMMA_SIMD
+GAMMA_EXPRESSION_PACK(simd::f32x4)
+#endif
+#ifdef GAMMA_SIMD_AVX
+GAMMA_EXPRESSION_PACK(simd::f32x8)
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+GAMMA_EXPRESSION_PACK(simd::f64x4)
+#endif
+#undef GAMMA_EXPRESSION_PACK
+
+/// Base of all nodes. E is the node type itself, R the vector or matrix type
+/// the expression evaluates to. Every node provides the component i, or the
+/// pack of components starting at i, as at<V>(i).
+template <typename E, typename R> struct node
+{
+	typedef R result_type;
+	typedef typename R::type scalar_type;
+	enum { size = sizeof(R) / sizeof(scalar_type) };
+
+	const E& derived() const { return static_cast<const E&>(*this); }
+
+	operator R() const { R r; assign(r, *this); return r; }
+};
+
+/// A vector or matrix operand.
+template <typename R> struct operand : node<operand<R>, R>
+{
+	typedef typename R::type T;
+	const T* p;
+	explicit operand(const R& v): p((const T*)&v) {}
+	template <typename V> V at(int i) const { return access<V>::load(p+i); }
+};
+
+/// A scalar operand, which is broadcast to all components.
+template <typename T> struct scalar
+{
+	T s;
+	explicit scalar(T s): s(s) {}
+	template <typename V> V at(int) const { return access<V>::splat(s); }
+};
+
+struct plus;
+struct minus;
+struct multiplies;
+struct divides;
+
+/// Applies the component-wise operation Op to the nodes or scalars A and B.
+template <typename Op, typename A, typename B, typename R> struct binary : node<binary<Op,A,B,R>, R>
+{
+	A a;
+	B b;
+	binary(const A& a, const B& b): a(a), b(b) {}
+	template <typename V> V at(int i) const { return Op::template apply<V>(a, b, i); }
+};
+
+// The fused variants of plus and minus are picked by overload resolution if
+// either operand is a product.
+template <typename V, typename A, typename B> inline V add_at(const A& a, const B& b, int i) { return a.template at<V>(i) + b.template at<V>(i); }
+template <typename V, typename A1, typename A2, typename R, typename B> inline V add_at(const binary<multiplies,A1,A2,R>& a, const B& b, int i) { return fmadd(a.a.template at<V>(i), a.b.template at<V>(i), b.template at<V>(i)); }
+template <typename V, typename A, typename B1, typename B2, typename R> inline V add_at(const A& a, const binary<multiplies,B1,B2,R>& b, int i) { return fmadd(b.a.template at<V>(i), b.b.template at<V>(i), a.template at<V>(i)); }
+template <typename V, typename A1, typename A2, typename B1, typename B2, typename R> inline V add_at(const binary<multiplies,A1,A2,R>& a, const binary<multiplies,B1,B2,R>& b, int i) { return fmadd(a.a.template at<V>(i), a.b.template at<V>(i), b.template at<V>(i)); }
+
+template <typename V, typename A, typename B> inline V sub_at(const A& a, const B& b, int i) { return a.template at<V>(i) - b.template at<V>(i); }
+template <typename V, typename A1, typename A2, typename R, typename B> inline V sub_at(const binary<multiplies,A1,A2,R>& a, const B& b, int i) { return fmsub(a.a.template at<V>(i), a.b.template at<V>(i), b.template at<V>(i)); }
+template <typename V, typename A, typename B1, typename B2, typename R> inline V sub_at(const A& a, const binary<multiplies,B1,B2,R>& b, int i) { return fnmadd(b.a.template at<V>(i), b.b.template at<V>(i), a.template at<V>(i)); }
+template <typename V, typename A1, typename A2, typename B1, typename B2, typename R> inline V sub_at(const binary<multiplies,A1,A2,R>& a, const binary<multiplies,B1,B2,R>& b, int i) { return fmsub(a.a.template at<V>(i), a.b.template at<V>(i), b.template at<V>(i)); }
+
+struct plus { template <typename V, typename A, typename B> static V apply(const A& a, const B& b, int i) { return add_at<V>(a, b, i); } };
+struct minus { template <typename V, typename A, typename B> static V apply(const A& a, const B& b, int i) { return sub_at<V>(a, b, i); } };
+struct multiplies { template <typename V, typename A, typename B> static V apply(const A& a, const B& b, int i) { return a.template at<V>(i) * b.template at<V>(i); } };
+struct divides { template <typename V, typename A, typename B> static V apply(const A& a, const B& b, int i) { return a.template at<V>(i) / b.template at<V>(i); } };
+
+/// Evaluates the packs of type P that fit into the components [i,size) of
+/// e, and returns the index of the first component left over.
+template <typename P, typename E, typename R> inline int assign_packs(typename R::type* r, const node<E,R>& e, int i)
+{
+	for (; i + P::size <= node<E,R>::size; i += P::size)
+		access<P>::store(e.derived().template at<P>(i), r+i);
+	return i;
+}
+
+template <typename T> struct packs
+{
+	template <typename E, typename R> static int assign(T*, const node<E,R>&) { return 0; }
+};
+#ifdef GAMMA_SIMD
+template <> struct packs<float>
+{
+	template <typename E, typename R> static int assign(float* r, const node<E,R>& e) {
+		return assign_packs<simd::f32x4>(r, e, assign_packs<simd::widest<float>::type>(r, e, 0));
+	}
+};
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+template <> struct packs<double>
+{
+	template <typename E, typename R> static int assign(double* r, const node<E,R>& e) { return assign_packs<simd::f64x4>(r, e, 0); }
+};
+#endif
+
+/// Evaluates e into r in a single pass. Each component of r only depends on
+/// the same component of the operands, so r may be one of them.
+template <typename E, typename R> inline void assign(R& r, const node<E,R>& e)
+{
+	typedef typename R::type T;
+	T* p = (T*)&r;
+	for (int i = packs<T>::assign(p, e); i < node<E,R>::size; ++i)
+		p[i] = e.derived().template at<T>(i);
+}
+
+/// Evaluates e to a value, for use where the implicit conversion does not
+/// apply, such as the assignment to a vector.
+template <typename E, typename R> inline R eval(const node<E,R>& e) { return e; }
+
+template <typename A, typename B, typename R> binary<plus,A,B,R> operator+ (const node<A,R>& a, const node<B,R>& b) { return binary<plus,A,B,R>(a.derived(), b.derived()); }
+template <typename A, typename B, typename R> binary<minus,A,B,R> operator- (const node<A,R>& a, const node<B,R>& b) { return binary<minus,A,B,R>(a.derived(), b.derived()); }
+template <typename A, typename B, typename R> binary<multiplies,A,B,R> mul(const node<A,R>& a, const node<B,R>& b) { return binary<multiplies,A,B,R>(a.derived(), b.derived()); }
+template <typename A, typename B, typename R> binary<divides,A,B,R> div(const node<A,R>& a, const node<B,R>& b) { return binary<divides,A,B,R>(a.derived(), b.derived()); }
+
+template <typename A, typename R> binary<multiplies,A,scalar<typename R::type>,R> operator* (const node<A,R>& a, typename R::type h) { return binary<multiplies,A,scalar<typename R::type>,R>(a.derived(), scalar<typename R::type>(h)); }
+template <typename A, typename R> binary<multiplies,scalar<typename R::type>,A,R> operator* (typename R::type h, const node<A,R>& a) { return binary<multiplies,scalar<typename R::type>,A,R>(scalar<typename R::type>(h), a.derived()); }
+template <typename A, typename R> binary<divides,A,scalar<typename R::type>,R> operator/ (const node<A,R>& a, typename R::type h) { return binary<divides,A,scalar<typename R::type>,R>(a.derived(), scalar<typename R::type>(h)); }
+template <typename A, typename R> binary<multiplies,A,scalar<typename R::type>,R> operator- (const node<A,R>& a) { return a * typename R::type(-1); }
+
+/// Maps the vector and matrix types to their operand node.
+template <typename V> struct leaf {};
+template <typename T> struct leaf<vector2<T> > { typedef operand<vector2<T> > type; };
+template <typename T> struct leaf<vector3<T> > { typedef operand<vector3<T> > type; };
+template <typename T> struct leaf<vector4<T> > { typedef operand<vector4<T> > type; };
+template <typename T> struct leaf<matrix2<T> > { typedef operand<matrix2<T> > type; };
+template <typename T> struct leaf<matrix3<T> > { typedef operand<matrix3<T> > type; };
+template <typename T> struct leaf<matrix4<T> > { typedef operand<matrix4<T> > type; };
+
+} // namespace expression
+
+/// Starts an expression on the vector or matrix v.
+template <typename V> typename expression::leaf<V>::type expr(const V& v) { return typename expression::leaf<V>::type(v); }
+
+} // namespace gma
@@ -6,6 +6,84 @@
 
 namespace gma {
 
+namespace detail {
+
+/// Returns a*b/2^D rounded towards zero, for 64 bit operands whose product
+/// needs more than 64 bits, without 128 bit integers. The magnitude of the
+/// product is assembled from four 32 bit partial products.
+template <int D> inline int64_t mul_shift_portable(int64_t a, int64_t b)
+{
+	uint64_t ua = a < 0 ? 0 - (uint64_t)a : (uint64_t)a;
+	uint64_t ub = b < 0 ? 0 - (uint64_t)b : (uint64_t)b;
+	uint64_t al = ua & 0xffffffffu, ah = ua >> 32, bl = ub & 0xffffffffu, bh = ub >> 32;
+	uint64_t ll = al*bl, lh = al*bh, hl = ah*bl, hh = ah*bh;
+	uint64_t mid = (ll >> 32) + (lh & 0xffffffffu) + (hl & 0xffffffffu);
+	uint64_t lo = (mid << 32) | (ll & 0xffffffffu);
+	uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	uint64_t r;
+	if (D == 0) r = lo;
+	else if (D < 64) r = (lo >> (D & 63)) | (hi << ((64 - D) & 63));
+	else r = hi >> (D & 63);
+	return (a < 0) != (b < 0) ? (int64_t)(0 - r) : (int64_t)r;
+}
+
+/// Returns a*b/2^D rounded towards zero, where the product needs N bits. The
+/// product is formed with a single widening multiplication, which for N up
+/// to 128 on 64 bit targets is one mul instruction yielding the high half,
+/// and the division by 2^D becomes a shift. Products wider than the widest
+/// integer available use mul_shift_portable.
+template <int D, int N, bool fits = (N <= integer::max_bits)> struct mul_shift
+{
+	template <typename A, typename B> static A apply(A a, B b)
+	{
+		typedef typename integer::signed_integer<N>::type P;
+		return (A)((P)a * b / ((P)1 << D));
+	}
+};
+
+/// Defines value as true if A and B fit the 64 bit operands of
+/// mul_shift_portable. Wider operands would be narrowed silently.
+template <typename A, typename B> struct fits_portable { enum { value = sizeof(A) <= 8 && sizeof(B) <= 8 }; };
+
+/// Only defined for true, such that sizeof(static_check<false>) fails to
+/// compile.
+template <bool> struct static_check;
+template <> struct static_check<true> {};
+
+/// Products of fixed_point types wider than 64 bits exceed the portable
+/// multiplication and do not compile.
+template <int D, int N> struct mul_shift<D,N,false>
+{
+	template <typename A, typename B> static A apply(A a, B b)
+	{
+		(void)sizeof(static_check<fits_portable<A,B>::value>);
+		return (A)mul_shift_portable<D>(a, b);
+	}
+};
+
+/// Defines type as T if R is a built-in arithmetic type. Restricts the
+/// operators mixing fixed_point and other scalars below, such that they do
+/// not compete with those of vectors and matrices of fixed_point.
+template <typename R, typename T> struct if_arithmetic {};
+#define declare_arithmetic(R) template <typename T> struct if_arithmetic<R,T> { typedef T type; };
+declare_arithmetic(char)
+declare_arithmetic(signed char)
+declare_arithmetic(unsigned char)
+declare_arithmetic(short)
+declare_arithmetic(unsigned short)
+declare_arithmetic(int)
+declare_arithmetic(unsigned int)
+declare_arithmetic(long)
+declare_arithmetic(unsigned long)
+declare_arithmetic(long long)
+declare_arithmetic(unsigned long long)
+declare_arithmetic(float)
+declare_arithmetic(double)
+declare_arithmetic(long double)
+#undef declare_arithmetic
+
+} // namespace detail
+
 #define recast(bits,thing) ((typename integer::signed_integer<bits>::type)(thing))
 
 /// Class for signed fixed-point arithmetics.
@@ -19,19 +97,17 @@ template<int Ia, int Da> struct fixed_point
 
 	typedef typename integer::signed_integer<bits>::type value_type;
 
-	const static value_type factor = 1 << (value_type)decimal_bits;
+	const static value_type factor = (value_type)1 << decimal_bits;
 	const static value_type decimal_mask = factor - 1;
 
 	value_type v;
 
 	fixed_point() {}
-	fixed_point(const self& f) : v(f.v) {}
 	template<typename R> explicit fixed_point(R r, int db = 0) : v(r * recast(Ia+Da+Da, factor) / (1 << (int64_t)db)) {}
 	template<int Ib, int Db> explicit fixed_point(const fixed_point<Ia,Da>& f) : v(recast(Ib+Db+Da, f.v) * factor / f.factor) {}
 
 	self operator- () const { self r; r.v = -v; return r; }
 	template<typename R> self& operator= (R r) { v = r * recast(Ia+Da+Da, factor); return *this; }
-	self& operator= (const self& f) { v = f.v; return *this; }
 	template<int Ib, int Db> self& operator= (const fixed_point<Ia,Da>& f) { v = recast(Ib+Db+Da, f.v) * factor / f.factor; return *this; }
 
 	template<typename R> self& operator+= (R r) { v += r * (value_type)factor; return *this; }
@@ -41,7 +117,7 @@ template<int Ia, int Da> struct fixed_point
 
 	template<int Ib, int Db> self& operator+= (fixed_point<Ib,Db> f) { v += recast(Ib+Db+Da, f.v) * factor / f.factor; return *this; }
 	template<int Ib, int Db> self& operator-= (fixed_point<Ib,Db> f) { v -= recast(Ib+Db+Da, f.v) * factor / f.factor; return *this; }
-	template<int Ib, int Db> self& operator*= (fixed_point<Ib,Db> f) { v = recast(Ia+Da+Ib+Db, v) * f.v / f.factor; return *this; }
+	template<int Ib, int Db> self& operator*= (fixed_point<Ib,Db> f) { v = detail::mul_shift<Db, Ia+Da+Ib+Db>::apply(v, f.v); return *this; }
 	template<int Ib, int Db> self& operator/= (fixed_point<Ib,Db> f) { v = recast(Ia+Da+Db, v) * f.factor / f.v; return *this; }
 
 	template<typename R> operator R() const { return (R)v / factor; }
@@ -54,19 +130,19 @@ template<int Ia, int Da> struct fixed_point
 
 #define return_wrapped(value) fixed_point<Ia,Da> _r; _r.v = (value); return _r;
 
-template<typename R, int Ia, int Da> fixed_point<Ia,Da> operator+ (R r, fixed_point<Ia,Da> f) { return_wrapped(r * recast(Ia+Da+Da, f.factor) + f.v); }
-template<typename R, int Ia, int Da> fixed_point<Ia,Da> operator- (R r, fixed_point<Ia,Da> f) { return_wrapped(r * recast(Ia+Da+Da, f.factor) - f.v); }
-template<typename R, int Ia, int Da> fixed_point<Ia,Da> operator* (R r, fixed_point<Ia,Da> f) { return_wrapped(r * f.v); }
-template<typename R, int Ia, int Da> fixed_point<Ia,Da> operator/ (R r, fixed_point<Ia,Da> f) { return_wrapped(r * recast(Ia+Da+Da+Da, f.factor) * f.factor / f.v); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, fixed_point<Ia,Da> >::type operator+ (R r, fixed_point<Ia,Da> f) { return_wrapped(r * recast(Ia+Da+Da, f.factor) + f.v); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, fixed_point<Ia,Da> >::type operator- (R r, fixed_point<Ia,Da> f) { return_wrapped(r * recast(Ia+Da+Da, f.factor) - f.v); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, fixed_point<Ia,Da> >::type operator* (R r, fixed_point<Ia,Da> f) { return_wrapped(r * f.v); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, fixed_point<Ia,Da> >::type operator/ (R r, fixed_point<Ia,Da> f) { return_wrapped(r * recast(Ia+Da+Da+Da, f.factor) * f.factor / f.v); }
 
-template<typename R, int Ia, int Da> fixed_point<Ia,Da> operator+ (fixed_point<Ia,Da> f, R r) { return_wrapped(f.v + r * recast(Ia+Da+Da, f.factor)); }
-template<typename R, int Ia, int Da> fixed_point<Ia,Da> operator- (fixed_point<Ia,Da> f, R r) { return_wrapped(f.v - r * recast(Ia+Da+Da, f.factor)); }
-template<typename R, int Ia, int Da> fixed_point<Ia,Da> operator* (fixed_point<Ia,Da> f, R r) { return_wrapped(f.v * r); }
-template<typename R, int Ia, int Da> fixed_point<Ia,Da> operator/ (fixed_point<Ia,Da> f, R r) { return_wrapped(f.v / r); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, fixed_point<Ia,Da> >::type operator+ (fixed_point<Ia,Da> f, R r) { return_wrapped(f.v + r * recast(Ia+Da+Da, f.factor)); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, fixed_point<Ia,Da> >::type operator- (fixed_point<Ia,Da> f, R r) { return_wrapped(f.v - r * recast(Ia+Da+Da, f.factor)); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, fixed_point<Ia,Da> >::type operator* (fixed_point<Ia,Da> f, R r) { return_wrapped(f.v * r); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, fixed_point<Ia,Da> >::type operator/ (fixed_point<Ia,Da> f, R r) { return_wrapped(f.v / r); }
 
 template<int Ia, int Da, int Ib, int Db> fixed_point<Ia,Da> operator+ (fixed_point<Ia,Da> a, fixed_point<Ib,Db> b) { return_wrapped(a.v + (recast(Ib+Db+Da, b.v) * a.factor / b.factor)); }
 template<int Ia, int Da, int Ib, int Db> fixed_point<Ia,Da> operator- (fixed_point<Ia,Da> a, fixed_point<Ib,Db> b) { return_wrapped(a.v - (recast(Ib+Db+Da, b.v) * a.factor / b.factor)); }
-template<int Ia, int Da, int Ib, int Db> fixed_point<Ia,Da> operator* (fixed_point<Ia,Da> a, fixed_point<Ib,Db> b) { return_wrapped(recast(Ia+Da+Ib+Db, a.v) * b.v / b.factor); }
+template<int Ia, int Da, int Ib, int Db> fixed_point<Ia,Da> operator* (fixed_point<Ia,Da> a, fixed_point<Ib,Db> b) { return_wrapped((detail::mul_shift<Db, Ia+Da+Ib+Db>::apply(a.v, b.v))); }
 template<int Ia, int Da, int Ib, int Db> fixed_point<Ia,Da> operator/ (fixed_point<Ia,Da> a, fixed_point<Ib,Db> b) { return_wrapped(recast(Ia+Da+Db, a.v) * b.factor / b.v); }
 
 template<int Ia, int Da, int Ib, int Db> bool operator>  (fixed_point<Ia,Da> a, fixed_point<Ib,Db> b) { return recast(Ia+Da+Db, a.v) * b.factor >  recast(Ib+Db+Da, b.v) * a.factor; }
@@ -76,19 +152,19 @@ template<int Ia, int Da, int Ib, int Db> bool operator<= (fixed_point<Ia,Da> a,
 template<int Ia, int Da, int Ib, int Db> bool operator== (fixed_point<Ia,Da> a, fixed_point<Ib,Db> b) { return recast(Ia+Da+Db, a.v) * b.factor == recast(Ib+Db+Da, b.v) * a.factor; }
 template<int Ia, int Da, int Ib, int Db> bool operator!= (fixed_point<Ia,Da> a, fixed_point<Ib,Db> b) { return recast(Ia+Da+Db, a.v) * b.factor != recast(Ib+Db+Da, b.v) * a.factor; }
 
-template<typename R, int Ia, int Da> bool operator>  (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) >  f.v; }
-template<typename R, int Ia, int Da> bool operator<  (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) <  f.v; }
-template<typename R, int Ia, int Da> bool operator>= (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) >= f.v; }
-template<typename R, int Ia, int Da> bool operator<= (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) <= f.v; }
-template<typename R, int Ia, int Da> bool operator== (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) == f.v; }
-template<typename R, int Ia, int Da> bool operator!= (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) != f.v; }
-
-template<typename R, int Ia, int Da> bool operator>  (fixed_point<Ia,Da> f, R r) { return f.v >  r * recast(Ia+Da+Da, f.factor); }
-template<typename R, int Ia, int Da> bool operator<  (fixed_point<Ia,Da> f, R r) { return f.v <  r * recast(Ia+Da+Da, f.factor); }
-template<typename R, int Ia, int Da> bool operator>= (fixed_point<Ia,Da> f, R r) { return f.v >= r * recast(Ia+Da+Da, f.factor); }
-template<typename R, int Ia, int Da> bool operator<= (fixed_point<Ia,Da> f, R r) { return f.v <= r * recast(Ia+Da+Da, f.factor); }
-template<typename R, int Ia, int Da> bool operator== (fixed_point<Ia,Da> f, R r) { return f.v == r * recast(Ia+Da+Da, f.factor); }
-template<typename R, int Ia, int Da> bool operator!= (fixed_point<Ia,Da> f, R r) { return f.v != r * recast(Ia+Da+Da, f.factor); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator>  (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) >  f.v; }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator<  (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) <  f.v; }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator>= (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) >= f.v; }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator<= (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) <= f.v; }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator== (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) == f.v; }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator!= (R r, fixed_point<Ia,Da> f) { return r * recast(Ia+Da+Da, f.factor) != f.v; }
+
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator>  (fixed_point<Ia,Da> f, R r) { return f.v >  r * recast(Ia+Da+Da, f.factor); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator<  (fixed_point<Ia,Da> f, R r) { return f.v <  r * recast(Ia+Da+Da, f.factor); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator>= (fixed_point<Ia,Da> f, R r) { return f.v >= r * recast(Ia+Da+Da, f.factor); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator<= (fixed_point<Ia,Da> f, R r) { return f.v <= r * recast(Ia+Da+Da, f.factor); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator== (fixed_point<Ia,Da> f, R r) { return f.v == r * recast(Ia+Da+Da, f.factor); }
+template<typename R, int Ia, int Da> typename detail::if_arithmetic<R, bool>::type operator!= (fixed_point<Ia,Da> f, R r) { return f.v != r * recast(Ia+Da+Da, f.factor); }
 
 #undef recast
 
@@ -0,0 +1,222 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/fixed_point.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/soa.hpp"
+#include "gamma/simd.hpp"
+#include <cstddef>
+#define GAMMA_HAS_FIXED_POINT_BATCH
+
+// Bulk arithmetic on arrays of fixed_point numbers. Every kernel produces
+// exactly the same bits as applying the scalar operators of fixed_point.hpp
+// element by element, including the wrap-around on overflow and the rounding
+// towards zero of products. Types stored in 32 bits, such as
+// fixed_point<16,16> and fixed_point<24,8>, are processed with the widest
+// 32 bit integer SIMD packs available; all others fall back to the scalar
+// operators.
+
+namespace gma {
+namespace detail {
+
+/// SIMD parts of the kernels below. Each processes a prefix of the arrays
+/// whose length is a multiple of the pack size and returns that length.
+template <int Ia, int Da, bool = (Ia + Da == 32)> struct fixed_batch
+{
+	typedef fixed_point<Ia,Da> F;
+	static size_t add(const F*, const F*, F*, size_t) { return 0; }
+	static size_t sub(const F*, const F*, F*, size_t) { return 0; }
+	static size_t mul(const F*, const F*, F*, size_t) { return 0; }
+	static size_t dot(const F* const*, const F* const*, F*, size_t) { return 0; }
+	static size_t cross(const F* const*, const F* const*, F* const*, size_t) { return 0; }
+	template <bool translate> static size_t transform(const matrix4<F>&, const F* const*, F* const*, size_t) { return 0; }
+	static size_t from_float(const float*, F*, size_t) { return 0; }
+	static size_t to_float(const F*, float*, size_t) { return 0; }
+};
+
+#ifdef GAMMA_SIMD
+template <int Ia, int Da> struct fixed_batch<Ia,Da,true>
+{
+	typedef fixed_point<Ia,Da> F;
+	typedef simd::widest<int32_t>::type P;
+	typedef P::float_type Q;
+
+	static P load(const F* p) { return P::load(&p->v); }
+	static void store(P a, F* p) { a.store(&p->v); }
+	static P mul(P a, P b) { return simd::mulshift<Da>(a, b); }
+
+	static size_t add(const F* a, const F* b, F* r, size_t n) {
+		size_t i = 0, end = n - n % P::size;
+		for (; i < end; i += P::size) store(load(a+i) + load(b+i), r+i);
+		return i;
+	}
+
+	static size_t sub(const F* a, const F* b, F* r, size_t n) {
+		size_t i = 0, end = n - n % P::size;
+		for (; i < end; i += P::size) store(load(a+i) - load(b+i), r+i);
+		return i;
+	}
+
+	static size_t mul(const F* a, const F* b, F* r, size_t n) {
+		size_t i = 0, end = n - n % P::size;
+		for (; i < end; i += P::size) store(mul(load(a+i), load(b+i)), r+i);
+		return i;
+	}
+
+	static size_t dot(const F* const* a, const F* const* b, F* r, size_t n) {
+		size_t i = 0, end = n - n % P::size;
+		for (; i < end; i += P::size)
+			store(mul(load(a[0]+i), load(b[0]+i)) + mul(load(a[1]+i), load(b[1]+i)) + mul(load(a[2]+i), load(b[2]+i)), r+i);
+		return i;
+	}
+
+	static size_t cross(const F* const* a, const F* const* b, F* const* r, size_t n) {
+		size_t i = 0, end = n - n % P::size;
+		for (; i < end; i += P::size) {
+			P ax = load(a[0]+i), ay = load(a[1]+i), az = load(a[2]+i);
+			P bx = load(b[0]+i), by = load(b[1]+i), bz = load(b[2]+i);
+			store(mul(ay, bz) - mul(az, by), r[0]+i);
+			store(mul(az, bx) - mul(ax, bz), r[1]+i);
+			store(mul(ax, by) - mul(ay, bx), r[2]+i);
+		}
+		return i;
+	}
+
+	/// Only used with eight lanes. With four, the emulated signed
+	/// multiplication makes this slower than the scalar loop.
+	template <bool translate> static size_t transform(const matrix4<F>& m, const F* const* v, F* const* r, size_t n) {
+		if (P::size < 8)
+			return 0;
+		const P m00(m.m00.v), m01(m.m01.v), m02(m.m02.v), m03(m.m03.v);
+		const P m10(m.m10.v), m11(m.m11.v), m12(m.m12.v), m13(m.m13.v);
+		const P m20(m.m20.v), m21(m.m21.v), m22(m.m22.v), m23(m.m23.v);
+		size_t i = 0, end = n - n % P::size;
+		for (; i < end; i += P::size) {
+			P x = load(v[0]+i), y = load(v[1]+i), z = load(v[2]+i);
+			P rx = mul(m00, x) + mul(m01, y) + mul(m02, z);
+			P ry = mul(m10, x) + mul(m11, y) + mul(m12, z);
+			P rz = mul(m20, x) + mul(m21, y) + mul(m22, z);
+			if (translate) { rx = rx + m03; ry = ry + m13; rz = rz + m23; }
+			store(rx, r[0]+i); store(ry, r[1]+i); store(rz, r[2]+i);
+		}
+		return i;
+	}
+
+	// The scaling by the power of two factor is exact in both directions.
+	static size_t from_float(const float* a, F* r, size_t n) {
+		const Q f((float)F::factor);
+		size_t i = 0, end = n - n % P::size;
+		for (; i < end; i += P::size) store(simd::to_int_trunc(Q::load(a+i) * f), r+i);
+		return i;
+	}
+
+	static size_t to_float(const F* a, float* r, size_t n) {
+		const Q f(1.0f / F::factor);
+		size_t i = 0, end = n - n % P::size;
+		for (; i < end; i += P::size) (simd::to_float(load(a+i)) * f).store(r+i);
+		return i;
+	}
+};
+#endif
+
+} // namespace detail
+
+template <int Ia, int Da> void add(const fixed_point<Ia,Da>* a, const fixed_point<Ia,Da>* b, fixed_point<Ia,Da>* r, size_t n)
+{
+	for (size_t i = detail::fixed_batch<Ia,Da>::add(a, b, r, n); i < n; ++i) r[i] = a[i] + b[i];
+}
+
+template <int Ia, int Da> void sub(const fixed_point<Ia,Da>* a, const fixed_point<Ia,Da>* b, fixed_point<Ia,Da>* r, size_t n)
+{
+	for (size_t i = detail::fixed_batch<Ia,Da>::sub(a, b, r, n); i < n; ++i) r[i] = a[i] - b[i];
+}
+
+template <int Ia, int Da> void mul(const fixed_point<Ia,Da>* a, const fixed_point<Ia,Da>* b, fixed_point<Ia,Da>* r, size_t n)
+{
+	for (size_t i = detail::fixed_batch<Ia,Da>::mul(a, b, r, n); i < n; ++i) r[i] = a[i] * b[i];
+}
+
+/// Component-wise sum of n pairs of vectors. The output may alias the inputs.
+template <int Ia, int Da> void add(const vector3<fixed_point<Ia,Da> >* a, const vector3<fixed_point<Ia,Da> >* b, vector3<fixed_point<Ia,Da> >* r, size_t n)
+{
+	add(&a->x, &b->x, &r->x, 3*n);
+}
+
+template <int Ia, int Da> void sub(const vector3<fixed_point<Ia,Da> >* a, const vector3<fixed_point<Ia,Da> >* b, vector3<fixed_point<Ia,Da> >* r, size_t n)
+{
+	sub(&a->x, &b->x, &r->x, 3*n);
+}
+
+/// Stores the dot products a[i].dot(b[i]) in r, which must hold a.size()
+/// elements.
+template <int Ia, int Da> void dot(const soa3<fixed_point<Ia,Da> >& a, const soa3<fixed_point<Ia,Da> >& b, fixed_point<Ia,Da>* r)
+{
+	typedef fixed_point<Ia,Da> F;
+	const F* pa[3] = { a.x.data(), a.y.data(), a.z.data() };
+	const F* pb[3] = { b.x.data(), b.y.data(), b.z.data() };
+	const size_t n = a.size();
+	for (size_t i = detail::fixed_batch<Ia,Da>::dot(pa, pb, r, n); i < n; ++i) r[i] = a[i].dot(b[i]);
+}
+
+/// Stores the cross products a[i].cross(b[i]) in r.
+template <int Ia, int Da> void cross(const soa3<fixed_point<Ia,Da> >& a, const soa3<fixed_point<Ia,Da> >& b, soa3<fixed_point<Ia,Da> >& r)
+{
+	typedef fixed_point<Ia,Da> F;
+	const size_t n = a.size();
+	r.resize(n);
+	const F* pa[3] = { a.x.data(), a.y.data(), a.z.data() };
+	const F* pb[3] = { b.x.data(), b.y.data(), b.z.data() };
+	F* pr[3] = { r.x.data(), r.y.data(), r.z.data() };
+	for (size_t i = detail::fixed_batch<Ia,Da>::cross(pa, pb, pr, n); i < n; ++i) r.set(i, a[i].cross(b[i]));
+}
+
+// Overloads of the transforms in soa.hpp. They are picked over the generic
+// versions for fixed_point, and produce the same result.
+template <int Ia, int Da> void transform_points(
+	const matrix4<fixed_point<Ia,Da> >& m, size_t n,
+	const fixed_point<Ia,Da>* x, const fixed_point<Ia,Da>* y, const fixed_point<Ia,Da>* z,
+	fixed_point<Ia,Da>* ox, fixed_point<Ia,Da>* oy, fixed_point<Ia,Da>* oz)
+{
+	typedef fixed_point<Ia,Da> F;
+	const F* v[3] = { x, y, z };
+	F* r[3] = { ox, oy, oz };
+	size_t i = detail::fixed_batch<Ia,Da>::template transform<true>(m, v, r, n);
+	detail::transform_soa_scalar<true>(m, i, n, x, y, z, ox, oy, oz);
+}
+
+template <int Ia, int Da> void transform_directions(
+	const matrix4<fixed_point<Ia,Da> >& m, size_t n,
+	const fixed_point<Ia,Da>* x, const fixed_point<Ia,Da>* y, const fixed_point<Ia,Da>* z,
+	fixed_point<Ia,Da>* ox, fixed_point<Ia,Da>* oy, fixed_point<Ia,Da>* oz)
+{
+	typedef fixed_point<Ia,Da> F;
+	const F* v[3] = { x, y, z };
+	F* r[3] = { ox, oy, oz };
+	size_t i = detail::fixed_batch<Ia,Da>::template transform<false>(m, v, r, n);
+	detail::transform_soa_scalar<false>(m, i, n, x, y, z, ox, oy, oz);
+}
+
+/// Converts n numbers to fixed_point, as fixed_point(a[i]) would. Values out
+/// of the representable range are undefined, as for the scalar conversion.
+template <typename R, int Ia, int Da> void convert(const R* a, fixed_point<Ia,Da>* r, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) r[i] = fixed_point<Ia,Da>(a[i]);
+}
+
+template <int Ia, int Da> void convert(const float* a, fixed_point<Ia,Da>* r, size_t n)
+{
+	for (size_t i = detail::fixed_batch<Ia,Da>::from_float(a, r, n); i < n; ++i) r[i] = fixed_point<Ia,Da>(a[i]);
+}
+
+/// Converts n fixed_point numbers to R, as (R)a[i] would.
+template <typename R, int Ia, int Da> void convert(const fixed_point<Ia,Da>* a, R* r, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) r[i] = (R)a[i];
+}
+
+template <int Ia, int Da> void convert(const fixed_point<Ia,Da>* a, float* r, size_t n)
+{
+	for (size_t i = detail::fixed_batch<Ia,Da>::to_float(a, r, n); i < n; ++i) r[i] = (float)a[i];
+}
+
+} // namespace gma
@@ -0,0 +1,228 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/integer.hpp"
+#include "gamma/fixed_point.hpp"
+#define GAMMA_HAS_FIXED_POINT_MATH
+
+// Elementary functions of fixed_point numbers, computed with integer
+// arithmetic only, such that every platform produces the same bits. sin, cos
+// and atan2 use CORDIC with Da+2 iterations, whose table of angles is fixed
+// in size, and are accurate to about one unit in the last place. sqrt is
+// correctly rounded, rsqrt accurate to one unit in the last place, and
+// reciprocal rounds towards zero as the division does. Results outside the
+// range of the type wrap around, as for the arithmetic operators.
+//
+// With sqrt_of and rsqrt_fast overloaded below, vector normalization and the
+// rotation transforms can be instantiated on fixed_point. Types of more than
+// 32 bits need 128 bit integers for everything but atan2.
+
+namespace gma {
+namespace detail {
+
+/// The CORDIC iterations work on 64 bit integers with 60 fractional bits.
+const int cordic_bits = 60;
+const int64_t cordic_pi = 3622009729038561421ll;
+const int64_t cordic_half_pi_62 = 7244019458077122842ll; // 62 fractional bits
+
+/// The gain 1/prod(sqrt(1+2^-2i)) of the iterations, rounded. Running only n
+/// iterations changes it by less than 2^-2n.
+const int64_t cordic_gain = 700114967507363238ll;
+
+/// Returns atan(2^-i) with 60 fractional bits. For i >= 20 this rounds to
+/// 2^-i, such that only the first angles are tabled.
+inline int64_t cordic_angle(int i)
+{
+	static const int64_t angles[20] = {
+		905502432259640355ll, 534549298976576474ll, 282441168888798124ll, 143371547418228444ll,
+		71963988336308046ll, 36017075762092179ll, 18012932708689205ll, 9007016009513623ll,
+		4503576721087964ll, 2251796950380271ll, 1125899548928887ll, 562949908682076ll,
+		281474971118251ll, 140737487656277ll, 70368744090283ll, 35184372077909ll,
+		17592186043051ll, 8796093022037ll, 4398046511083ll, 2199023255549ll };
+	return i < 20 ? angles[i] : (int64_t)1 << (cordic_bits - i);
+}
+
+/// Rotates (x, y) by the angle z, which must lie within [-pi/2, pi/2], in n
+/// steps. The vector grows by 1/cordic_gain.
+inline void cordic_rotate(int64_t& x, int64_t& y, int64_t z, int n)
+{
+	for (int i = 0; i < n; ++i) {
+		int64_t dx = y >> i, dy = x >> i, dz = cordic_angle(i);
+		if (z >= 0) { x -= dx; y += dy; z -= dz; }
+		else        { x += dx; y -= dy; z += dz; }
+	}
+}
+
+/// Rotates (x, y), where x >= 0, onto the x axis in n steps and returns the
+/// angle rotated by, i.e. atan(y/x).
+inline int64_t cordic_vector(int64_t x, int64_t y, int n)
+{
+	int64_t z = 0;
+	for (int i = 0; i < n; ++i) {
+		int64_t dx = y >> i, dy = x >> i, dz = cordic_angle(i);
+		if (y < 0) { x -= dx; y += dy; z -= dz; }
+		else       { x += dx; y -= dy; z += dz; }
+	}
+	return z;
+}
+
+/// Converts from 60 fractional bits to D, rounding to nearest.
+template <int D> inline int64_t from_cordic(int64_t v)
+{
+	return (v + ((int64_t)1 << (cordic_bits - D - 1))) >> (cordic_bits - D);
+}
+
+/// Returns the cosine and sine of the angle a, given with Da fractional bits,
+/// with 60 fractional bits. The angle is reduced to a quadrant and a
+/// remainder in [0, pi/2) with as many fractional bits as the wider integer
+/// type holds, at most 62.
+template <int Ia, int Da> inline void cordic_sincos(typename fixed_point<Ia,Da>::value_type a, int64_t& c, int64_t& s)
+{
+	enum {
+		wide_bits = Ia + Da <= 32 ? 64 : 128,
+		F = wide_bits - 1 - Ia < 62 ? wide_bits - 1 - Ia : 62,
+		S = 62 - F
+	};
+	typedef typename integer::signed_integer<wide_bits>::type W;
+	W y = (W)a * ((W)1 << (F - Da));
+	W p = (W)((cordic_half_pi_62 + ((int64_t)1 << S >> 1)) >> S);
+	W q = y / p, r = y - q * p;
+	if (r < 0) { r += p; --q; }
+	int64_t z = F >= cordic_bits ? (int64_t)(r >> (F >= cordic_bits ? F - cordic_bits : 0)) : (int64_t)r << (F < cordic_bits ? cordic_bits - F : 0);
+
+	int64_t x = cordic_gain, v = 0;
+	cordic_rotate(x, v, z, Da + 2 < cordic_bits ? Da + 2 : cordic_bits);
+	switch ((int)(q & 3)) {
+		case 0: c =  x; s =  v; break;
+		case 1: c = -v; s =  x; break;
+		case 2: c = -x; s = -v; break;
+		default: c = v; s = -x; break;
+	}
+}
+
+/// Returns the integer square root of n, rounded to nearest.
+template <typename U> inline U isqrt(U n)
+{
+	U r = 0, bit = (U)1 << (sizeof(U) * 8 - 2);
+	while (bit > n) bit >>= 2;
+	while (bit) {
+		if (n >= r + bit) { n -= r + bit; r = (r >> 1) + bit; }
+		else r >>= 1;
+		bit >>= 2;
+	}
+	return n > r ? r + 1 : r;
+}
+
+/// Returns 1/sqrt(a) with Da fractional bits, as the integer square root of
+/// 2^(3*Da)/a, which needs 3*Da+1 bits.
+template <int Ia, int Da, bool exact = (3*Da+1 <= integer::max_bits)> struct rsqrt_bits
+{
+	typedef typename fixed_point<Ia,Da>::value_type V;
+	static V apply(V a)
+	{
+		typedef typename integer::unsigned_integer<(3*Da+1 > Ia+Da ? 3*Da+1 : Ia+Da)>::type U;
+		return (V)isqrt(((U)1 << 3*Da) / (U)a);
+	}
+};
+
+/// Without an integer that wide, divides by the rounded square root and
+/// refines the result with one Newton step r += r*(1 - a*r*r)/2. The residual
+/// carries G extra bits, and the products exceeding 64 bits go through
+/// mul_shift_portable. Requires Ia+Da <= 32.
+template <int Ia, int Da> struct rsqrt_bits<Ia,Da,false>
+{
+	typedef typename fixed_point<Ia,Da>::value_type V;
+	static V apply(V a)
+	{
+		enum { G = Da/2 + 2 };
+		int64_t s = (int64_t)isqrt((uint64_t)a << Da);
+		int64_t r = ((int64_t)1 << 2*Da) / s;
+		int64_t e = mul_shift_portable<2*Da - G>((int64_t)a * r, r);
+		r += mul_shift_portable<Da + G + 1>(r, ((int64_t)1 << (Da + G)) - e);
+		return (V)r;
+	}
+};
+
+} // namespace detail
+
+template<int Ia, int Da> fixed_point<Ia,Da> sin(fixed_point<Ia,Da> a)
+{
+	int64_t c, s;
+	detail::cordic_sincos<Ia,Da>(a.v, c, s);
+	fixed_point<Ia,Da> r; r.v = (typename fixed_point<Ia,Da>::value_type)detail::from_cordic<Da>(s); return r;
+}
+
+template<int Ia, int Da> fixed_point<Ia,Da> cos(fixed_point<Ia,Da> a)
+{
+	int64_t c, s;
+	detail::cordic_sincos<Ia,Da>(a.v, c, s);
+	fixed_point<Ia,Da> r; r.v = (typename fixed_point<Ia,Da>::value_type)detail::from_cordic<Da>(c); return r;
+}
+
+/// Computes the sine and cosine of a at once.
+template<int Ia, int Da> void sincos(fixed_point<Ia,Da> a, fixed_point<Ia,Da>& s, fixed_point<Ia,Da>& c)
+{
+	int64_t vc, vs;
+	detail::cordic_sincos<Ia,Da>(a.v, vc, vs);
+	c.v = (typename fixed_point<Ia,Da>::value_type)detail::from_cordic<Da>(vc);
+	s.v = (typename fixed_point<Ia,Da>::value_type)detail::from_cordic<Da>(vs);
+}
+
+/// Returns the angle of (x, y) in [-pi, pi], and 0 for the origin. Requires
+/// Ia >= 3 to represent pi.
+template<int Ia, int Da> fixed_point<Ia,Da> atan2(fixed_point<Ia,Da> y, fixed_point<Ia,Da> x)
+{
+	fixed_point<Ia,Da> r;
+	int64_t vx = (int64_t)x.v, vy = (int64_t)y.v;
+	// Scale the larger magnitude to [2^57, 2^58), leaving room for the gain.
+	uint64_t m = vx < 0 ? 0 - (uint64_t)vx : (uint64_t)vx, my = vy < 0 ? 0 - (uint64_t)vy : (uint64_t)vy;
+	if (my > m) m = my;
+	if (m == 0) { r.v = 0; return r; }
+	int shift = 0;
+	while (m >= (uint64_t)1 << 58) { m >>= 1; --shift; }
+	for (int step = 32; step > 0; step >>= 1)
+		if (m < (uint64_t)1 << (58 - step)) { m <<= step; shift += step; }
+	if (shift >= 0) { vx *= (int64_t)1 << shift; vy *= (int64_t)1 << shift; }
+	else { vx >>= -shift; vy >>= -shift; }
+
+	int64_t base = 0;
+	if (vx < 0) {
+		base = vy >= 0 ? detail::cordic_pi : -detail::cordic_pi;
+		vx = -vx;
+		vy = -vy;
+	}
+	int64_t z = base + detail::cordic_vector(vx, vy, Da + 2 < detail::cordic_bits ? Da + 2 : detail::cordic_bits);
+	r.v = (typename fixed_point<Ia,Da>::value_type)detail::from_cordic<Da>(z);
+	return r;
+}
+
+/// Returns the square root of a, correctly rounded, or 0 if a is negative.
+template<int Ia, int Da> fixed_point<Ia,Da> sqrt(fixed_point<Ia,Da> a)
+{
+	typedef typename integer::unsigned_integer<Ia+Da+Da>::type U;
+	fixed_point<Ia,Da> r;
+	r.v = a.v <= 0 ? 0 : (typename fixed_point<Ia,Da>::value_type)detail::isqrt((U)a.v << Da);
+	return r;
+}
+
+/// Returns 1/sqrt(a) for positive a.
+template<int Ia, int Da> fixed_point<Ia,Da> rsqrt(fixed_point<Ia,Da> a)
+{
+	fixed_point<Ia,Da> r;
+	r.v = detail::rsqrt_bits<Ia,Da>::apply(a.v);
+	return r;
+}
+
+/// Returns 1/a, rounded towards zero.
+template<int Ia, int Da> fixed_point<Ia,Da> reciprocal(fixed_point<Ia,Da> a)
+{
+	typedef typename integer::signed_integer<Ia+Da+Da>::type W;
+	fixed_point<Ia,Da> r;
+	r.v = (typename fixed_point<Ia,Da>::value_type)(((W)1 << 2*Da) / a.v);
+	return r;
+}
+
+template<int Ia, int Da> fixed_point<Ia,Da> sqrt_of(fixed_point<Ia,Da> a) { return sqrt(a); }
+template<int Ia, int Da> fixed_point<Ia,Da> rsqrt_fast(fixed_point<Ia,Da> a) { return rsqrt(a); }
+
+} // namespace gma
@@ -0,0 +1,156 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/sphere.hpp"
+#include "gamma/simd.hpp"
+#include <cstddef>
+#include <cstring>
+#define GAMMA_HAS_FRUSTUM
+
+namespace gma {
+
+/// The view frustum of a projection, as six planes (a,b,c,d) with normals
+/// pointing inwards. A point p lies inside the plane if a*p.x + b*p.y + c*p.z
+/// + d >= 0. The planes are normalized such that this expression is the
+/// signed distance to the plane.
+template <typename T> struct frustum
+{
+	typedef T scalar_type;
+	typedef vector3<T> vector_type;
+	typedef vector4<T> plane_type;
+	typedef sphere<vector_type> sphere_type;
+	typedef frustum<T> self;
+
+	enum { left_plane, right_plane, bottom_plane, top_plane, near_plane, far_plane };
+	plane_type planes[6];
+
+	frustum() {}
+
+	/// Extracts the planes from the matrix m which maps into OpenGL clip
+	/// space, where -w <= x,y,z <= w (Gribb and Hartmann). For a projection
+	/// matrix this yields the frustum in view space; for a model view
+	/// projection matrix in model space.
+	explicit frustum(const matrix4<T>& m) {
+		plane_type r0(m.m00, m.m01, m.m02, m.m03);
+		plane_type r1(m.m10, m.m11, m.m12, m.m13);
+		plane_type r2(m.m20, m.m21, m.m22, m.m23);
+		plane_type r3(m.m30, m.m31, m.m32, m.m33);
+		planes[left_plane]   = r3 + r0;
+		planes[right_plane]  = r3 - r0;
+		planes[bottom_plane] = r3 + r1;
+		planes[top_plane]    = r3 - r1;
+		planes[near_plane]   = r3 + r2;
+		planes[far_plane]    = r3 - r2;
+		for (int i = 0; i < 6; ++i) {
+			plane_type& p = planes[i];
+			p /= sqrt(p.x*p.x + p.y*p.y + p.z*p.z);
+		}
+	}
+
+	/// Returns the signed distance of p to plane i.
+	T distance(int i, const vector_type& p) const {
+		const plane_type& q = planes[i];
+		return q.x*p.x + q.y*p.y + q.z*p.z + q.w;
+	}
+
+	bool contains(const vector_type& p) const {
+		for (int i = 0; i < 6; ++i)
+			if (distance(i, p) < 0) return false;
+		return true;
+	}
+
+	/// Returns whether s is at least partially inside the frustum. Spheres
+	/// near the corners may be reported as intersecting although they are
+	/// outside, which is conservative for culling.
+	bool intersects(const sphere_type& s) const {
+		for (int i = 0; i < 6; ++i)
+			if (distance(i, s.c) + s.r < 0) return false;
+		return true;
+	}
+};
+
+namespace detail {
+
+template <typename T> inline size_t cull_scalar(const frustum<T>& f, size_t i, size_t n,
+	const sphere<vector3<T> >* s, uint64_t* mask)
+{
+	for (; i < n; ++i)
+		if (f.intersects(s[i]))
+			mask[i/64] |= uint64_t(1) << (i%64);
+	return i;
+}
+
+#ifdef GAMMA_SIMD
+/// Tests four spheres at a time. Each sphere (x, y, z, r) is loaded as one
+/// pack and the four are transposed such that each pack holds one component
+/// of all of them. A sphere is outside if its distance plus radius is negative
+/// for any plane, which is read off the sign bits of the minimum.
+template <typename P> inline size_t cull_simd(const frustum<typename P::scalar_type>& f, size_t n,
+	const sphere<vector3<typename P::scalar_type> >* s, uint64_t* mask)
+{
+	typedef typename P::scalar_type T;
+	P px[6], py[6], pz[6], pw[6];
+	for (int j = 0; j < 6; ++j) {
+		px[j] = P(f.planes[j].x); py[j] = P(f.planes[j].y);
+		pz[j] = P(f.planes[j].z); pw[j] = P(f.planes[j].w);
+	}
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4) {
+		const T* p = &s[i].c.x;
+		P x = P::load(p), y = P::load(p+4), z = P::load(p+8), r = P::load(p+12);
+		simd::transpose4(x, y, z, r);
+		P d = px[0]*x + py[0]*y + pz[0]*z + pw[0];
+		for (int j = 1; j < 6; ++j)
+			d = simd::min(d, px[j]*x + py[j]*y + pz[j]*z + pw[j]);
+		int outside = simd::signmask(d + r);
+		mask[i/64] |= uint64_t(~outside & 0xf) << (i%64);
+	}
+	return i;
+}
+#endif
+
+template <typename T> inline void cull(const frustum<T>& f, size_t n, const sphere<vector3<T> >* s, uint64_t* mask)
+{
+	cull_scalar(f, 0, n, s, mask);
+}
+
+#ifdef GAMMA_SIMD
+inline void cull(const frustum<float>& f, size_t n, const sphere<vector3<float> >* s, uint64_t* mask)
+{
+	size_t i = cull_simd<simd::f32x4>(f, n, s, mask);
+	cull_scalar(f, i, n, s, mask);
+}
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+inline void cull(const frustum<double>& f, size_t n, const sphere<vector3<double> >* s, uint64_t* mask)
+{
+	size_t i = cull_simd<simd::f64x4>(f, n, s, mask);
+	cull_scalar(f, i, n, s, mask);
+}
+#endif
+
+} // namespace detail
+
+/// Tests the n spheres at s against the frustum f. Bit i%64 of mask[i/64] is
+/// set if sphere i is at least partially inside, as per frustum::intersects,
+/// and cleared otherwise. The mask must hold (n+63)/64 words. Returns the
+/// number of visible spheres.
+template <typename T> size_t cull(const frustum<T>& f, const sphere<vector3<T> >* s, size_t n, uint64_t* mask)
+{
+	const size_t words = (n + 63) / 64;
+	memset(mask, 0, words * sizeof(uint64_t));
+	detail::cull(f, n, s, mask);
+	size_t visible = 0;
+	for (size_t i = 0; i < words; ++i)
+		for (uint64_t w = mask[i]; w; w &= w - 1)
+			++visible;
+	return visible;
+}
+
+namespace convenience {
+	typedef frustum<float> frustumf;
+	typedef frustum<double> frustumd;
+}
+} // namespace gma
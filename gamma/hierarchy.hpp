@@ -0,0 +1,242 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/parallel.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#define GAMMA_HAS_HIERARCHY
+
+namespace gma {
+
+/// Number of nodes per worker below which hierarchy does not spawn any
+/// threads for a level.
+const size_t hierarchy_grain = 4096;
+
+namespace detail {
+
+template <typename T> struct hierarchy_kernel
+{
+	const matrix4<T>* local;
+	matrix4<T>* world;
+	const uint32_t* parents;
+	uint8_t* dirty;
+
+	/// Recomputes the world matrices of the nodes that are dirty or whose
+	/// parent was recomputed, and marks them for their children. The
+	/// parents are on the previous level, which is complete.
+	void operator() (size_t begin, size_t end, unsigned) const
+	{
+		for (size_t i = begin; i < end; ++i) {
+			uint32_t p = parents[i];
+			if (p == 0xffffffffu) {
+				if (dirty[i])
+					world[i] = local[i];
+			} else if (dirty[i] | dirty[p]) {
+				dirty[i] = 1;
+				world[i] = world[p] * local[i];
+			}
+		}
+	}
+};
+
+} // namespace detail
+
+/// A forest of transforms, each with a local matrix relative to its parent
+/// and a world matrix world(parent) * local. Nodes are identified by the
+/// ids add returns, but stored in breadth-first order, such that each level
+/// of the tree is a contiguous range and the parents of a level precede it.
+/// update propagates the world matrices level by level, recomputing only the
+/// nodes whose local matrix or ancestry has changed, and splits large levels
+/// across all hardware threads.
+///
+/// Adding nodes level by level keeps the order without further work. Other
+/// insertions and set_parent reorder the nodes on the next update.
+template <typename T> struct hierarchy
+{
+	typedef T scalar_type;
+	typedef matrix4<T> matrix_type;
+	typedef hierarchy<T> self;
+
+	enum { none = 0xffffffffu };
+
+	unsigned max_workers; // see parallel_for
+
+	// Indexed by slot, in breadth-first order.
+	std::vector<matrix_type> local_matrices;
+	std::vector<matrix_type> world_matrices;
+	std::vector<uint32_t> parents; // slot of the parent, or none
+	std::vector<uint32_t> ids; // id of the node in each slot
+	std::vector<uint8_t> dirty; // local matrix or parent changed
+
+	// Indexed by id.
+	std::vector<uint32_t> slots;
+	std::vector<uint32_t> parent_ids;
+
+	/// Level d spans the slots [levels[d],levels[d+1]).
+	std::vector<size_t> levels;
+
+	hierarchy(unsigned max_workers = 0): max_workers(max_workers), first_dirty(0), ordered(true) { levels.push_back(0); }
+
+	size_t size() const { return ids.size(); }
+
+	/// Adds a node with the given local matrix below parent, or as a root if
+	/// parent is none, and returns its id.
+	uint32_t add(const matrix_type& local, uint32_t parent = none)
+	{
+		uint32_t id = (uint32_t)ids.size(), s = id;
+		size_t depth = parent == none ? 0 : depth_of(slots[parent]) + 1;
+		size_t last = levels.size() - 2; // only valid if size() > 0
+		if (ordered && s > 0 && depth != last && depth != last + 1)
+			ordered = false;
+		if (ordered && (s == 0 || depth == last + 1))
+			levels.push_back(s + 1);
+		else if (ordered)
+			levels.back() = s + 1;
+		local_matrices.push_back(local);
+		world_matrices.push_back(local);
+		parents.push_back(parent == none ? (uint32_t)none : slots[parent]);
+		ids.push_back(id);
+		dirty.push_back(1);
+		slots.push_back(s);
+		parent_ids.push_back(parent);
+		mark(s);
+		return id;
+	}
+
+	/// Moves the node id below parent, or makes it a root if parent is none.
+	/// Returns false, changing nothing, if parent lies in the subtree of id.
+	bool set_parent(uint32_t id, uint32_t parent)
+	{
+		for (uint32_t p = parent; p != none; p = parent_ids[p])
+			if (p == id)
+				return false;
+		parent_ids[id] = parent;
+		parents[slots[id]] = parent == none ? (uint32_t)none : slots[parent];
+		dirty[slots[id]] = 1;
+		ordered = false;
+		return true;
+	}
+
+	uint32_t parent(uint32_t id) const { return parent_ids[id]; }
+
+	void set_local(uint32_t id, const matrix_type& m)
+	{
+		uint32_t s = slots[id];
+		local_matrices[s] = m;
+		dirty[s] = 1;
+		mark(s);
+	}
+
+	const matrix_type& local(uint32_t id) const { return local_matrices[slots[id]]; }
+
+	/// Returns the world matrix of id as of the last update.
+	const matrix_type& world(uint32_t id) const { return world_matrices[slots[id]]; }
+
+	/// Recomputes the world matrices of all nodes whose local matrix or any
+	/// ancestor's has changed since the last update.
+	void update()
+	{
+		if (!ordered)
+			reorder();
+		if (first_dirty >= levels.size() - 1)
+			return;
+		detail::hierarchy_kernel<T> k;
+		k.local = &local_matrices[0];
+		k.world = &world_matrices[0];
+		k.parents = &parents[0];
+		k.dirty = &dirty[0];
+		for (size_t d = first_dirty; d + 1 < levels.size(); ++d)
+			parallel_for(levels[d+1] - levels[d], hierarchy_grain, offset_kernel(k, levels[d]), max_workers);
+		memset(&dirty[levels[first_dirty]], 0, levels.back() - levels[first_dirty]);
+		first_dirty = levels.size();
+	}
+
+private:
+	size_t first_dirty; // no level above has dirty nodes
+	bool ordered; // slots are in breadth-first order and levels valid
+
+	/// Runs a hierarchy_kernel on a level starting at slot base.
+	struct offset_kernel
+	{
+		detail::hierarchy_kernel<T> k;
+		size_t base;
+		offset_kernel(const detail::hierarchy_kernel<T>& k, size_t base): k(k), base(base) {}
+		void operator() (size_t begin, size_t end, unsigned w) const { k(base + begin, base + end, w); }
+	};
+
+	size_t depth_of(uint32_t s) const
+	{
+		if (!ordered) return 0;
+		return std::upper_bound(levels.begin(), levels.end(), (size_t)s) - levels.begin() - 1;
+	}
+
+	void mark(uint32_t s)
+	{
+		if (first_dirty + 1 < levels.size() && s >= levels[first_dirty])
+			return;
+		size_t d = depth_of(s);
+		if (d < first_dirty) first_dirty = d;
+	}
+
+	/// Sorts the nodes into breadth-first order, keeping the relative order
+	/// of the nodes within a level.
+	void reorder()
+	{
+		const size_t n = ids.size();
+		std::vector<uint32_t> depth(n, (uint32_t)none), chain;
+		for (uint32_t id = 0; id < n; ++id) {
+			uint32_t p = id;
+			while (p != none && depth[p] == none) {
+				chain.push_back(p);
+				p = parent_ids[p];
+			}
+			uint32_t d = p == none ? 0 : depth[p] + 1;
+			while (!chain.empty()) {
+				depth[chain.back()] = d++;
+				chain.pop_back();
+			}
+		}
+
+		levels.assign(1, 0);
+		for (size_t id = 0; id < n; ++id) {
+			if (depth[id] + 2 > levels.size()) levels.resize(depth[id] + 2, 0);
+			++levels[depth[id] + 1];
+		}
+		for (size_t d = 1; d < levels.size(); ++d)
+			levels[d] += levels[d-1];
+
+		std::vector<size_t> next(levels.begin(), levels.end() - 1);
+		std::vector<matrix_type> local(n), world(n);
+		std::vector<uint8_t> changed(n);
+		std::vector<uint32_t> order(n);
+		first_dirty = levels.size();
+		for (size_t s = 0; s < n; ++s) {
+			uint32_t id = ids[s], d = depth[id];
+			size_t t = next[d]++;
+			local[t] = local_matrices[s];
+			world[t] = world_matrices[s];
+			changed[t] = dirty[s];
+			order[t] = id;
+			slots[id] = (uint32_t)t;
+			if (dirty[s] && d < first_dirty) first_dirty = d;
+		}
+		local_matrices.swap(local);
+		world_matrices.swap(world);
+		dirty.swap(changed);
+		ids.swap(order);
+		for (size_t s = 0; s < n; ++s) {
+			uint32_t p = parent_ids[ids[s]];
+			parents[s] = p == none ? (uint32_t)none : slots[p];
+		}
+		ordered = true;
+	}
+};
+
+namespace convenience {
+	typedef hierarchy<float> hierarchyf;
+	typedef hierarchy<double> hierarchyd;
+}
+} // namespace gma
@@ -23,6 +23,19 @@ declare_unsigned_integer(uint16_t)
 declare_unsigned_integer(uint32_t)
 declare_unsigned_integer(uint64_t)
 
+// 128 bit integers, where the compiler provides them. Define GAMMA_NO_INT128
+// to leave them out, e.g. to exercise the fallbacks that do without.
+#if defined(__SIZEOF_INT128__) && !defined(GAMMA_NO_INT128)
+#define GAMMA_HAS_INT128
+__extension__ typedef __int128 int128_t;
+__extension__ typedef unsigned __int128 uint128_t;
+declare_signed_integer(int128_t)
+declare_unsigned_integer(uint128_t)
+const int max_bits = 128;
+#else
+const int max_bits = 64;
+#endif
+
 #undef declare_integer
 #undef declare_signed_integer
 #undef declare_unsigned_integer
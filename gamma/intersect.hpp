@@ -0,0 +1,75 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/line.hpp"
+#include "gamma/sphere.hpp"
+#define GAMMA_HAS_INTERSECT
+
+// Intersection tests between the geometric primitives. Lines are treated as
+// rays l.p + t*l.d with t >= 0, whose direction need not be normalized; the
+// returned parameters t are in units of l.d.
+
+namespace gma {
+
+/// Intersects the ray l with the sphere s. Stores the parameter of the first
+/// intersection in t, or 0 if l.p lies inside s.
+template <typename V> bool intersect(const line<V>& l, const sphere<V>& s, typename V::type& t)
+{
+	typedef typename V::type T;
+	V m = l.p - s.c;
+	T b = m.dot(l.d);
+	T c = m.dot(m) - s.r*s.r;
+	if (c > 0 && b > 0)
+		return false; // outside and pointing away
+	T a = l.d.dot(l.d);
+	T disc = b*b - a*c;
+	if (disc < 0)
+		return false;
+	t = (-b - sqrt_of(disc)) / a;
+	if (t < 0)
+		t = 0;
+	return true;
+}
+
+/// Returns whether the spheres a and b overlap or touch.
+template <typename V> bool intersects(const sphere<V>& a, const sphere<V>& b)
+{
+	V d = a.c - b.c;
+	typename V::type r = a.r + b.r;
+	return d.dot(d) <= r*r;
+}
+
+/// Returns whether the sphere s overlaps or touches the axis-aligned box
+/// [lo,hi].
+template <typename T> bool intersects(const sphere<vector3<T> >& s, const vector3<T>& lo, const vector3<T>& hi)
+{
+	T d = 0;
+	for (int i = 0; i < 3; ++i) {
+		T c = s.c(i);
+		if (c < lo(i)) d += (lo(i) - c) * (lo(i) - c);
+		else if (c > hi(i)) d += (c - hi(i)) * (c - hi(i));
+	}
+	return d <= s.r*s.r;
+}
+
+/// Intersects the ray from p along a direction whose componentwise inverse is
+/// inv with the axis-aligned box [lo,hi], within the parameters [0,tmax].
+/// Stores the parameter where the ray enters the box, or 0 if p lies inside,
+/// in t. Infinite components of inv, i.e. rays parallel to an axis, are
+/// handled by IEEE arithmetic.
+template <typename T> bool intersect(const vector3<T>& p, const vector3<T>& inv,
+	const vector3<T>& lo, const vector3<T>& hi, T tmax, T& t)
+{
+	T t0 = 0, t1 = tmax;
+	for (int i = 0; i < 3; ++i) {
+		T a = (lo(i) - p(i)) * inv(i), b = (hi(i) - p(i)) * inv(i);
+		if (a > b) { T h = a; a = b; b = h; }
+		if (a > t0) t0 = a;
+		if (b < t1) t1 = b;
+	}
+	t = t0;
+	return t0 <= t1;
+}
+
+} // namespace gma
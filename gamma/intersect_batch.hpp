@@ -0,0 +1,150 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/line.hpp"
+#include "gamma/sphere.hpp"
+#include "gamma/intersect.hpp"
+#include "gamma/simd.hpp"
+#include <cstddef>
+#include <cstring>
+#define GAMMA_HAS_INTERSECT_BATCH
+
+// Ray-sphere tests of one ray against an array of spheres, or of an array of
+// rays against one sphere, as used by hit-scans and visibility checks. They
+// agree with intersect(line, sphere) in intersect.hpp, up to the rounding
+// differences of fused multiply-adds and rays that touch a sphere exactly.
+// For float and double, four tests are evaluated at a time in SIMD packs.
+
+namespace gma {
+namespace detail {
+
+template <typename T> inline size_t intersect_scalar(size_t i, size_t n, const line<vector3<T> >& l,
+	const sphere<vector3<T> >* s, T* t, uint64_t* mask)
+{
+	for (; i < n; ++i)
+		if (intersect(l, s[i], t[i]))
+			mask[i/64] |= uint64_t(1) << (i%64);
+	return i;
+}
+
+template <typename T> inline size_t intersect_scalar(size_t i, size_t n, const line<vector3<T> >* l,
+	const sphere<vector3<T> >& s, T* t, uint64_t* mask)
+{
+	for (; i < n; ++i)
+		if (intersect(l[i], s, t[i]))
+			mask[i/64] |= uint64_t(1) << (i%64);
+	return i;
+}
+
+#ifdef GAMMA_SIMD
+/// Solves the quadratic of intersect(line, sphere) for four rays or spheres,
+/// given m = p - c, the direction d, its squared length a, and the squared
+/// radii r2. The ray misses if the discriminant is negative, or if the far
+/// root (q-b)/a is, which is the case the scalar version rejects early as
+/// outside and pointing away. Stores the near roots, clamped to zero, and
+/// returns a bit per hit.
+template <typename P> inline int intersect_packs(P mx, P my, P mz, P dx, P dy, P dz, P a, P r2,
+	typename P::scalar_type* t)
+{
+	const P zero(0);
+	P b = mx*dx + my*dy + mz*dz;
+	P c = mx*mx + my*my + mz*mz - r2;
+	P disc = b*b - a*c;
+	P q = simd::sqrt(disc);
+	P t0 = (zero - b - q) / a;
+	(zero - simd::min(zero - t0, zero)).store(t);
+	return ~(simd::signmask(disc) | simd::signmask(q - b)) & 0xf;
+}
+
+/// Tests the ray l against four spheres at a time, which are transposed as
+/// in cull_simd.
+template <typename P> inline size_t intersect_simd(size_t n, const line<vector3<typename P::scalar_type> >& l,
+	const sphere<vector3<typename P::scalar_type> >* s, typename P::scalar_type* t, uint64_t* mask)
+{
+	typedef typename P::scalar_type T;
+	const P px(l.p.x), py(l.p.y), pz(l.p.z), dx(l.d.x), dy(l.d.y), dz(l.d.z), a(l.d.dot(l.d));
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4) {
+		const T* p = &s[i].c.x;
+		P x = P::load(p), y = P::load(p+4), z = P::load(p+8), r = P::load(p+12);
+		simd::transpose4(x, y, z, r);
+		int hit = intersect_packs(px - x, py - y, pz - z, dx, dy, dz, a, r*r, t+i);
+		mask[i/64] |= uint64_t(hit) << (i%64);
+	}
+	return i;
+}
+
+/// Tests four rays at a time against the sphere s. A ray (p, d) occupies six
+/// scalars, which are loaded as (px py pz dx) and (pz dx dy dz), such that
+/// the loads of the last ray stay within the array, and transposed.
+template <typename P> inline size_t intersect_simd(size_t n, const line<vector3<typename P::scalar_type> >* l,
+	const sphere<vector3<typename P::scalar_type> >& s, typename P::scalar_type* t, uint64_t* mask)
+{
+	typedef typename P::scalar_type T;
+	const P cx(s.c.x), cy(s.c.y), cz(s.c.z), r2(s.r*s.r);
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4) {
+		const T* p = &l[i].p.x;
+		P px = P::load(p), py = P::load(p+6), pz = P::load(p+12), dx = P::load(p+18);
+		P ez = P::load(p+2), ex = P::load(p+8), dy = P::load(p+14), dz = P::load(p+20);
+		simd::transpose4(px, py, pz, dx);
+		simd::transpose4(ez, ex, dy, dz);
+		int hit = intersect_packs(px - cx, py - cy, pz - cz, ex, dy, dz, ex*ex + dy*dy + dz*dz, r2, t+i);
+		mask[i/64] |= uint64_t(hit) << (i%64);
+	}
+	return i;
+}
+#endif
+
+template <typename T, typename A, typename B> inline void intersect(size_t n, const A& a, const B& b, T* t, uint64_t* mask)
+{
+	intersect_scalar(0, n, a, b, t, mask);
+}
+
+#ifdef GAMMA_SIMD
+template <typename A, typename B> inline void intersect(size_t n, const A& a, const B& b, float* t, uint64_t* mask)
+{
+	size_t i = intersect_simd<simd::f32x4>(n, a, b, t, mask);
+	intersect_scalar(i, n, a, b, t, mask);
+}
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+template <typename A, typename B> inline void intersect(size_t n, const A& a, const B& b, double* t, uint64_t* mask)
+{
+	size_t i = intersect_simd<simd::f64x4>(n, a, b, t, mask);
+	intersect_scalar(i, n, a, b, t, mask);
+}
+#endif
+
+/// Clears the mask for n results, runs the tests, and counts the hits.
+template <typename T, typename A, typename B> inline size_t intersect_count(size_t n, const A& a, const B& b, T* t, uint64_t* mask)
+{
+	const size_t words = (n + 63) / 64;
+	memset(mask, 0, words * sizeof(uint64_t));
+	intersect(n, a, b, t, mask);
+	size_t hits = 0;
+	for (size_t i = 0; i < words; ++i)
+		for (uint64_t w = mask[i]; w; w &= w - 1)
+			++hits;
+	return hits;
+}
+
+} // namespace detail
+
+/// Intersects the ray l with the n spheres at s, as per intersect(line,
+/// sphere). Bit i%64 of mask[i/64] is set if sphere i is hit, and t[i] holds
+/// the parameter of the first intersection; for misses t[i] is unspecified.
+/// The mask must hold (n+63)/64 words. Returns the number of hits.
+template <typename T> size_t intersect(const line<vector3<T> >& l, const sphere<vector3<T> >* s, size_t n, T* t, uint64_t* mask)
+{
+	return detail::intersect_count(n, l, s, t, mask);
+}
+
+/// Intersects the n rays at l with the sphere s, with results as above.
+template <typename T> size_t intersect(const line<vector3<T> >* l, size_t n, const sphere<vector3<T> >& s, T* t, uint64_t* mask)
+{
+	return detail::intersect_count(n, l, s, t, mask);
+}
+
+} // namespace gma
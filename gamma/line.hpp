@@ -8,7 +8,7 @@ namespace gma {
 /// A line in arbitrary dimensions, as defined by a point and a direection.
 template <typename T> struct line
 {
-	typedef typename T::Type scalar_type;
+	typedef typename T::type scalar_type;
 	typedef T vector_type;
 	typedef line<T> self;
 
@@ -6,3 +6,67 @@
 extern "C" {
 	#include <stdint.h>
 }
+#if !defined(GAMMA_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define GAMMA_HAS_RSQRT_ESTIMATE
+#include <xmmintrin.h>
+#endif
+
+/// Marks the value types and their closed-form operations as usable in
+/// constant expressions where the compiler supports it. Only functions that
+/// consist of a single return statement are marked, as required by C++11.
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#define GAMMA_CONSTEXPR constexpr
+#else
+#define GAMMA_CONSTEXPR
+#endif
+
+/// Operators with a SIMD implementation can only be constexpr if the
+/// compiler is able to tell constant evaluation apart from a regular call, in
+/// which case they fall back to the generic scalar code.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define GAMMA_HAS_IS_CONSTANT_EVALUATED
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+#define GAMMA_HAS_IS_CONSTANT_EVALUATED
+#endif
+
+#ifdef GAMMA_HAS_IS_CONSTANT_EVALUATED
+#define GAMMA_SIMD_CONSTEXPR GAMMA_CONSTEXPR
+#else
+#define GAMMA_SIMD_CONSTEXPR
+#endif
+
+namespace gma {
+
+/// The functions overloaded for custom scalar types within gma, such as
+/// fixed_point in fixed_point_math.hpp, must not hide those for float and
+/// double from the code in gma.
+using ::sin;
+using ::cos;
+using ::atan2;
+using ::sqrt;
+
+/// Square root in the precision of T, such that float is never widened to
+/// double. Overload for custom scalar types.
+template <typename T> inline T sqrt_of(T v) { return T(sqrt(double(v))); }
+inline float sqrt_of(float v) { return sqrtf(v); }
+inline double sqrt_of(double v) { return sqrt(v); }
+
+/// Approximate reciprocal square root, as used to normalize by
+/// multiplications only. In general this is 1/sqrt_of(v), overload for custom
+/// scalar types that have a faster way to compute it.
+template <typename T> inline T rsqrt_fast(T v) { return T(1) / sqrt_of(v); }
+
+#ifdef GAMMA_HAS_RSQRT_ESTIMATE
+/// For float on SSE, the 12 bit hardware estimate refined by one
+/// Newton-Raphson step, as simd::rsqrt does for four lanes. The relative
+/// error is below 2^-21.
+inline float rsqrt_fast(float v)
+{
+	float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(v)));
+	return y * (1.5f - 0.5f * v * y * y);
+}
+#endif
+
+} // namespace gma
@@ -1,6 +1,7 @@
 /* Copyright (c) 2013-2014 Fabian Schuiki */
 #pragma once
 #include "gamma/vector.hpp"
+#include "gamma/simd.hpp"
 #define GAMMA_HAS_MATRIX
 
 namespace gma {
@@ -24,22 +25,22 @@ template <typename T> struct matrix2
 	};
 
 	matrix2() {}
-	explicit matrix2(T d) : m00(d), m01(0), m10(0), m11(d) {}
-	explicit matrix2(const column& c0, const column& c1) : m00(c0.x), m10(c0.y), m01(c1.x), m11(c1.y) {}
-	explicit matrix2(T m00, T m01, T m10, T m11) : m00(m00), m01(m01), m10(m10), m11(m11) {}
-	template<typename R> explicit matrix2(const matrix2<R>& h) : m00(h.m00), m10(h.m10), m01(h.m01), m11(h.m11) {}
+	GAMMA_CONSTEXPR explicit matrix2(T d) : m00(d), m10(0), m01(0), m11(d) {}
+	GAMMA_CONSTEXPR explicit matrix2(const column& c0, const column& c1) : m00(c0.x), m10(c0.y), m01(c1.x), m11(c1.y) {}
+	GAMMA_CONSTEXPR explicit matrix2(T m00, T m01, T m10, T m11) : m00(m00), m10(m10), m01(m01), m11(m11) {}
+	template<typename R> GAMMA_CONSTEXPR explicit matrix2(const matrix2<R>& h) : m00(h.m00), m10(h.m10), m01(h.m01), m11(h.m11) {}
 
-	template<typename R> operator matrix2<R>() const { return matrix2<R>(*this); }
+	template<typename R> GAMMA_CONSTEXPR operator matrix2<R>() const { return matrix2<R>(*this); }
 	operator T*() const { return (T*)this; }
 	T& operator() (int row, int column) { return a[column][row]; }
 	T operator() (int row, int column) const { return a[column][row]; }
 	column operator() (int column) const { return column(a[column][0], a[column][1]); }
 
-	self operator- () const { return self(-m00, -m01, -m10, -m11); }
+	GAMMA_CONSTEXPR self operator- () const { return self(-m00, -m01, -m10, -m11); }
 	template<typename R> self& operator= (const matrix2<R>& h) { m00=h.m00; m01=h.m01; m10=h.m10; m11=h.m11; return *this; }
 
-	template<typename R> self mul(const matrix2<R>& h) const { return self(m00*h.m00, m01*h.m01, m10*h.m10, m11*h.m11); }
-	template<typename R> self div(const matrix2<R>& h) const { return self(m00/h.m00, m01/h.m01, m10/h.m10, m11/h.m11); }
+	template<typename R> GAMMA_CONSTEXPR self mul(const matrix2<R>& h) const { return self(m00*h.m00, m01*h.m01, m10*h.m10, m11*h.m11); }
+	template<typename R> GAMMA_CONSTEXPR self div(const matrix2<R>& h) const { return self(m00/h.m00, m01/h.m01, m10/h.m10, m11/h.m11); }
 
 	template<typename R> self& operator+= (const vector2<R>& h) { m00+=h.m00; m01+=h.m01; m10+=h.m10; m11+=h.m11; return *this; }
 	template<typename R> self& operator-= (const vector2<R>& h) { m00-=h.m00; m01-=h.m01; m10-=h.m10; m11-=h.m11; return *this; }
@@ -54,29 +55,29 @@ template <typename T> struct matrix2
 	template<typename R> self& operator*= (const matrix2<R>& h) const {	return *this = *this * h; }
 };
 
-template<typename T, typename R> matrix2<T> operator+ (const matrix2<T>& v, const matrix2<R>& h) { return matrix2<T>(v.m00+h.m00, v.m01+h.m01, v.m10+h.m10, v.m11+h.m11); }
-template<typename T, typename R> matrix2<T> operator- (const matrix2<T>& v, const matrix2<R>& h) { return matrix2<T>(v.m00-h.m00, v.m01-h.m01, v.m10-h.m10, v.m11-h.m11); }
-template<typename T, typename R> matrix2<T> operator* (const matrix2<T>& v, const matrix2<R>& h) { return matrix2<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator+ (const matrix2<T>& v, const matrix2<R>& h) { return matrix2<T>(v.m00+h.m00, v.m01+h.m01, v.m10+h.m10, v.m11+h.m11); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator- (const matrix2<T>& v, const matrix2<R>& h) { return matrix2<T>(v.m00-h.m00, v.m01-h.m01, v.m10-h.m10, v.m11-h.m11); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator* (const matrix2<T>& v, const matrix2<R>& h) { return matrix2<T>(
 	v.m00*h.m01 + v.m01*h.m11, // m01
 	v.m00*h.m00 + v.m01*h.m10, // m00
 
 	v.m10*h.m00 + v.m11*h.m10, // m10
 	v.m10*h.m01 + v.m11*h.m11  // m11
 ); }
-template<typename T, typename R> vector2<R> operator* (const matrix2<T>& v, const vector2<R>& h) { return vector2<R>(
+template<typename T, typename R> GAMMA_CONSTEXPR vector2<R> operator* (const matrix2<T>& v, const vector2<R>& h) { return vector2<R>(
 	v.m00*h.x + v.m01*h.y, // x
 	v.m10*h.x + v.m11*h.y  // y
 ); }
 
-template<typename T, typename R> matrix2<T> operator+ (R h, const matrix2<T>& v) { return matrix2<T>(h+v.m00, h+v.m01, h+v.m10, h+v.m11); }
-template<typename T, typename R> matrix2<T> operator- (R h, const matrix2<T>& v) { return matrix2<T>(h-v.m00, h-v.m01, h-v.m10, h-v.m11); }
-template<typename T, typename R> matrix2<T> operator* (R h, const matrix2<T>& v) { return matrix2<T>(h*v.m00, h*v.m01, h*v.m10, h*v.m11); }
-template<typename T, typename R> matrix2<T> operator/ (R h, const matrix2<T>& v) { return matrix2<T>(h/v.m00, h/v.m01, h/v.m10, h/v.m11); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator+ (R h, const matrix2<T>& v) { return matrix2<T>(h+v.m00, h+v.m01, h+v.m10, h+v.m11); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator- (R h, const matrix2<T>& v) { return matrix2<T>(h-v.m00, h-v.m01, h-v.m10, h-v.m11); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator* (R h, const matrix2<T>& v) { return matrix2<T>(h*v.m00, h*v.m01, h*v.m10, h*v.m11); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator/ (R h, const matrix2<T>& v) { return matrix2<T>(h/v.m00, h/v.m01, h/v.m10, h/v.m11); }
 
-template<typename T, typename R> matrix2<T> operator+ (const matrix2<T>& v, R h) { return matrix2<T>(v.m00+h, v.m01+h, v.m10+h, v.m11+h); }
-template<typename T, typename R> matrix2<T> operator- (const matrix2<T>& v, R h) { return matrix2<T>(v.m00-h, v.m01-h, v.m10-h, v.m11-h); }
-template<typename T, typename R> matrix2<T> operator* (const matrix2<T>& v, R h) { return matrix2<T>(v.m00*h, v.m01*h, v.m10*h, v.m11*h); }
-template<typename T, typename R> matrix2<T> operator/ (const matrix2<T>& v, R h) { return matrix2<T>(v.m00/h, v.m01/h, v.m10/h, v.m11/h); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator+ (const matrix2<T>& v, R h) { return matrix2<T>(v.m00+h, v.m01+h, v.m10+h, v.m11+h); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator- (const matrix2<T>& v, R h) { return matrix2<T>(v.m00-h, v.m01-h, v.m10-h, v.m11-h); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator* (const matrix2<T>& v, R h) { return matrix2<T>(v.m00*h, v.m01*h, v.m10*h, v.m11*h); }
+template<typename T, typename R> GAMMA_CONSTEXPR matrix2<T> operator/ (const matrix2<T>& v, R h) { return matrix2<T>(v.m00/h, v.m01/h, v.m10/h, v.m11/h); }
 
 
 /// 3x3 column-major matrix.
@@ -93,33 +94,33 @@ template <typename T> struct matrix3
 	};
 
 	matrix3() {}
-	explicit matrix3(T d):
-		m00(d), m01(0), m02(0),
-		m10(0), m11(d), m12(0),
-		m20(0), m21(0), m22(d) {}
-	explicit matrix3(const column& c0, const column& c1, const column& c2):
+	GAMMA_CONSTEXPR explicit matrix3(T d):
+		m00(d), m10(0), m20(0),
+		m01(0), m11(d), m21(0),
+		m02(0), m12(0), m22(d) {}
+	GAMMA_CONSTEXPR explicit matrix3(const column& c0, const column& c1, const column& c2):
 		m00(c0.x), m10(c0.y), m20(c0.z),
 		m01(c1.x), m11(c1.y), m21(c1.z),
 		m02(c2.x), m12(c2.y), m22(c2.z) {}
-	explicit matrix3(
+	GAMMA_CONSTEXPR explicit matrix3(
 		T m00, T m01, T m02,
 		T m10, T m11, T m12,
 		T m20, T m21, T m22):
-		m00(m00), m01(m01), m02(m02),
-		m10(m10), m11(m11), m12(m12),
-		m20(m20), m21(m21), m22(m22) {}
-	template<typename R> explicit matrix3(const matrix3<R>& h):
-		m00(h.m00), m01(h.m01), m02(h.m02),
-		m10(h.m10), m11(h.m11), m12(h.m12),
-		m20(h.m20), m21(h.m21), m22(h.m22) {}
-
-	template<typename R> operator matrix3<R>() const { return matrix3<R>(*this); }
+		m00(m00), m10(m10), m20(m20),
+		m01(m01), m11(m11), m21(m21),
+		m02(m02), m12(m12), m22(m22) {}
+	template<typename R> GAMMA_CONSTEXPR explicit matrix3(const matrix3<R>& h):
+		m00(h.m00), m10(h.m10), m20(h.m20),
+		m01(h.m01), m11(h.m11), m21(h.m21),
+		m02(h.m02), m12(h.m12), m22(h.m22) {}
+
+	template<typename R> GAMMA_CONSTEXPR operator matrix3<R>() const { return matrix3<R>(*this); }
 	operator T*() const { return (T*)this; }
 	T& operator() (int row, int column) { return a[column][row]; }
 	T operator() (int row, int column) const { return a[column][row]; }
 	column operator() (int column) const { return column(a[column][0], a[column][1], a[column][2]); }
 
-	self operator- () const { return self(
+	GAMMA_CONSTEXPR self operator- () const { return self(
 		-m00, -m01, -m02,
 		-m10, -m11, -m12,
 		-m20, -m21, -m22); }
@@ -129,11 +130,11 @@ template <typename T> struct matrix3
 		m20=h.m20; m21=h.m21; m22=h.m22;
 		return *this; }
 
-	template<typename R> self mul(const matrix3<R>& h) const { return self(
+	template<typename R> GAMMA_CONSTEXPR self mul(const matrix3<R>& h) const { return self(
 		m00*h.m00, m01*h.m01, m02*h.m02,
 		m10*h.m10, m11*h.m11, m12*h.m12,
 		m20*h.m20, m21*h.m21, m22*h.m22); }
-	template<typename R> self div(const matrix3<R>& h) const { return self(
+	template<typename R> GAMMA_CONSTEXPR self div(const matrix3<R>& h) const { return self(
 		m00/h.m00, m01/h.m01, m02/h.m02,
 		m10/h.m10, m11/h.m11, m12/h.m12,
 		m20/h.m20, m21/h.m21, m22/h.m22); }
@@ -181,17 +182,64 @@ template <typename T> struct matrix3
 		return *this; }
 
 	template<typename R> self& operator*= (const matrix3<R>& h) const {	return *this = *this * h; }
+
+	GAMMA_CONSTEXPR self transposed() const { return self(
+		m00, m10, m20,
+		m01, m11, m21,
+		m02, m12, m22); }
+
+	GAMMA_CONSTEXPR T determinant() const { return m00*(m11*m22 - m12*m21) + m01*(m12*m20 - m10*m22) + m02*(m10*m21 - m11*m20); }
+
+	/// General inverse via the adjugate. The result is undefined for singular
+	/// matrices.
+	self inverse() const {
+		T c00 = m11*m22 - m12*m21, c01 = m02*m21 - m01*m22, c02 = m01*m12 - m02*m11;
+		T c10 = m12*m20 - m10*m22, c11 = m00*m22 - m02*m20, c12 = m02*m10 - m00*m12;
+		T c20 = m10*m21 - m11*m20, c21 = m01*m20 - m00*m21, c22 = m00*m11 - m01*m10;
+		T f = T(1) / (m00*c00 + m01*c10 + m02*c20);
+		return self(
+			c00*f, c01*f, c02*f,
+			c10*f, c11*f, c12*f,
+			c20*f, c21*f, c22*f); }
+
+	/// Inverse of a linear 3D transformation, which as matrix3 carries no
+	/// translation, such that this is the general inverse.
+	self inverse_affine() const { return inverse(); }
+
+	/// Inverse of an orthonormal matrix, i.e. a 3D rotation, which is its
+	/// transpose.
+	GAMMA_CONSTEXPR self inverse_orthonormal() const { return transposed(); }
+
+	/// Inverse of a 2D affine transformation in homogeneous coordinates, i.e.
+	/// a matrix whose last row is (0,0,1). The upper 2x2 part may contain any
+	/// invertible combination of rotation, scale and shear.
+	self inverse_affine_2d() const {
+		T f = T(1) / (m00*m11 - m01*m10);
+		T a00 = m11*f, a01 = -m01*f;
+		T a10 = -m10*f, a11 = m00*f;
+		return self(
+			a00, a01, -(a00*m02 + a01*m12),
+			a10, a11, -(a10*m02 + a11*m12),
+			0, 0, 1); }
+
+	/// Inverse of a 2D affine transformation in homogeneous coordinates whose
+	/// upper 2x2 part is orthonormal, i.e. a rotation followed by a
+	/// translation.
+	self inverse_orthonormal_2d() const { return self(
+		m00, m10, -(m00*m02 + m10*m12),
+		m01, m11, -(m01*m02 + m11*m12),
+		0, 0, 1); }
 };
 
-template<typename T, typename R> matrix3<T> operator+ (const matrix3<T>& v, const matrix3<R>& h) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator+ (const matrix3<T>& v, const matrix3<R>& h) { return matrix3<T>(
 	v.m00+h.m00, v.m01+h.m01, v.m02+h.m02,
 	v.m10+h.m10, v.m11+h.m11, v.m12+h.m12,
 	v.m20+h.m20, v.m21+h.m21, v.m22+h.m22); }
-template<typename T, typename R> matrix3<T> operator- (const matrix3<T>& v, const matrix3<R>& h) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator- (const matrix3<T>& v, const matrix3<R>& h) { return matrix3<T>(
 	v.m00-h.m00, v.m01-h.m01, v.m02-h.m02,
 	v.m10-h.m10, v.m11-h.m11, v.m12-h.m12,
 	v.m20-h.m20, v.m21-h.m21, v.m22-h.m22); }
-template<typename T, typename R> matrix3<T> operator* (const matrix3<T>& v, const matrix3<R>& h) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator* (const matrix3<T>& v, const matrix3<R>& h) { return matrix3<T>(
 	v.m00*h.m00 + v.m01*h.m10 + v.m02*h.m20, // m00
 	v.m00*h.m01 + v.m01*h.m11 + v.m02*h.m21, // m01
 	v.m00*h.m02 + v.m01*h.m12 + v.m02*h.m22, // m02
@@ -204,42 +252,42 @@ template<typename T, typename R> matrix3<T> operator* (const matrix3<T>& v, cons
 	v.m20*h.m01 + v.m21*h.m11 + v.m22*h.m21, // m21
 	v.m20*h.m02 + v.m21*h.m12 + v.m22*h.m22  // m22
 ); }
-template<typename T, typename R> vector3<R> operator* (const matrix3<T>& v, const vector3<R>& h) { return vector3<R>(
+template<typename T, typename R> GAMMA_CONSTEXPR vector3<R> operator* (const matrix3<T>& v, const vector3<R>& h) { return vector3<R>(
 	v.m00*h.x + v.m01*h.y + v.m02*h.z, // x
 	v.m10*h.x + v.m11*h.y + v.m12*h.z, // y
 	v.m20*h.x + v.m21*h.y + v.m22*h.z  // z
 ); }
 
-template<typename T, typename R> matrix3<T> operator+ (R h, const matrix3<T>& v) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator+ (R h, const matrix3<T>& v) { return matrix3<T>(
 	h+v.m00, h+v.m01, h+v.m02,
 	h+v.m10, h+v.m11, h+v.m12,
 	h+v.m20, h+v.m21, h+v.m22); }
-template<typename T, typename R> matrix3<T> operator- (R h, const matrix3<T>& v) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator- (R h, const matrix3<T>& v) { return matrix3<T>(
 	h-v.m00, h-v.m01, h-v.m02,
 	h-v.m10, h-v.m11, h-v.m12,
 	h-v.m20, h-v.m21, h-v.m22); }
-template<typename T, typename R> matrix3<T> operator* (R h, const matrix3<T>& v) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator* (R h, const matrix3<T>& v) { return matrix3<T>(
 	h*v.m00, h*v.m01, h*v.m02,
 	h*v.m10, h*v.m11, h*v.m12,
 	h*v.m20, h*v.m21, h*v.m22); }
-template<typename T, typename R> matrix3<T> operator/ (R h, const matrix3<T>& v) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator/ (R h, const matrix3<T>& v) { return matrix3<T>(
 	h/v.m00, h/v.m01, h/v.m02,
 	h/v.m10, h/v.m11, h/v.m12,
 	h/v.m20, h/v.m21, h/v.m22); }
 
-template<typename T, typename R> matrix3<T> operator+ (const matrix3<T>& v, R h) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator+ (const matrix3<T>& v, R h) { return matrix3<T>(
 	v.m00+h, v.m01+h, v.m02+h,
 	v.m10+h, v.m11+h, v.m12+h,
 	v.m20+h, v.m21+h, v.m22+h); }
-template<typename T, typename R> matrix3<T> operator- (const matrix3<T>& v, R h) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator- (const matrix3<T>& v, R h) { return matrix3<T>(
 	v.m00-h, v.m01-h, v.m02-h,
 	v.m10-h, v.m11-h, v.m12-h,
 	v.m20-h, v.m21-h, v.m22-h); }
-template<typename T, typename R> matrix3<T> operator* (const matrix3<T>& v, R h) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator* (const matrix3<T>& v, R h) { return matrix3<T>(
 	v.m00*h, v.m01*h, v.m02*h,
 	v.m10*h, v.m11*h, v.m12*h,
 	v.m20*h, v.m21*h, v.m22*h); }
-template<typename T, typename R> matrix3<T> operator/ (const matrix3<T>& v, R h) { return matrix3<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix3<T> operator/ (const matrix3<T>& v, R h) { return matrix3<T>(
 	v.m00/h, v.m01/h, v.m02/h,
 	v.m10/h, v.m11/h, v.m12/h,
 	v.m20/h, v.m21/h, v.m22/h); }
@@ -259,38 +307,38 @@ template <typename T> struct matrix4
 	};
 
 	matrix4() {}
-	explicit matrix4(T d):
-		m00(d), m01(0), m02(0), m03(0),
-		m10(0), m11(d), m12(0), m13(0),
-		m20(0), m21(0), m22(d), m23(0),
-		m30(0), m31(0), m32(0), m33(d) {}
-	explicit matrix4(const column& c0, const column& c1, const column& c2, const column& c3):
+	GAMMA_CONSTEXPR explicit matrix4(T d):
+		m00(d), m10(0), m20(0), m30(0),
+		m01(0), m11(d), m21(0), m31(0),
+		m02(0), m12(0), m22(d), m32(0),
+		m03(0), m13(0), m23(0), m33(d) {}
+	GAMMA_CONSTEXPR explicit matrix4(const column& c0, const column& c1, const column& c2, const column& c3):
 		m00(c0.x), m10(c0.y), m20(c0.z), m30(c0.w),
 		m01(c1.x), m11(c1.y), m21(c1.z), m31(c1.w),
 		m02(c2.x), m12(c2.y), m22(c2.z), m32(c2.w),
 		m03(c3.x), m13(c3.y), m23(c3.z), m33(c3.w) {}
-	explicit matrix4(
+	GAMMA_CONSTEXPR explicit matrix4(
 		T m00, T m01, T m02, T m03,
 		T m10, T m11, T m12, T m13,
 		T m20, T m21, T m22, T m23,
 		T m30, T m31, T m32, T m33):
-		m00(m00), m01(m01), m02(m02), m03(m03),
-		m10(m10), m11(m11), m12(m12), m13(m13),
-		m20(m20), m21(m21), m22(m22), m23(m23),
-		m30(m30), m31(m31), m32(m32), m33(m33) {}
-	template<typename R> explicit matrix4(const matrix4<R>& h):
-		m00(h.m00), m01(h.m01), m02(h.m02), m03(h.m03),
-		m10(h.m10), m11(h.m11), m12(h.m12), m13(h.m13),
-		m20(h.m20), m21(h.m21), m22(h.m22), m23(h.m23),
-		m30(h.m30), m31(h.m31), m32(h.m32), m33(h.m33) {}
-
-	template<typename R> operator matrix4<R>() const { return matrix4<R>(*this); }
+		m00(m00), m10(m10), m20(m20), m30(m30),
+		m01(m01), m11(m11), m21(m21), m31(m31),
+		m02(m02), m12(m12), m22(m22), m32(m32),
+		m03(m03), m13(m13), m23(m23), m33(m33) {}
+	template<typename R> GAMMA_CONSTEXPR explicit matrix4(const matrix4<R>& h):
+		m00(h.m00), m10(h.m10), m20(h.m20), m30(h.m30),
+		m01(h.m01), m11(h.m11), m21(h.m21), m31(h.m31),
+		m02(h.m02), m12(h.m12), m22(h.m22), m32(h.m32),
+		m03(h.m03), m13(h.m13), m23(h.m23), m33(h.m33) {}
+
+	template<typename R> GAMMA_CONSTEXPR operator matrix4<R>() const { return matrix4<R>(*this); }
 	operator T*() const { return (T*)this; }
 	T& operator() (int row, int column) { return a[column][row]; }
 	T operator() (int row, int column) const { return a[column][row]; }
 	column operator() (int column) const { return column(a[column][0], a[column][1], a[column][2], a[column][3]); }
 
-	self operator- () const { return self(
+	GAMMA_CONSTEXPR self operator- () const { return self(
 		-m00, -m01, -m02, -m03,
 		-m10, -m11, -m12, -m13,
 		-m20, -m21, -m22, -m23,
@@ -302,12 +350,12 @@ template <typename T> struct matrix4
 		m30=h.m30; m31=h.m31; m32=h.m32; m33=h.m33;
 		return *this; }
 
-	template<typename R> self mul(const matrix4<R>& h) const { return self(
+	template<typename R> GAMMA_CONSTEXPR self mul(const matrix4<R>& h) const { return self(
 		m00*h.m00, m01*h.m01, m02*h.m02, m03*h.m03,
 		m10*h.m10, m11*h.m11, m12*h.m12, m13*h.m13,
 		m20*h.m20, m21*h.m21, m22*h.m22, m23*h.m23,
 		m30*h.m30, m31*h.m31, m32*h.m32, m33*h.m33); }
-	template<typename R> self div(const matrix4<R>& h) const { return self(
+	template<typename R> GAMMA_CONSTEXPR self div(const matrix4<R>& h) const { return self(
 		m00/h.m00, m01/h.m01, m02/h.m02, m03/h.m03,
 		m10/h.m10, m11/h.m11, m12/h.m12, m13/h.m13,
 		m20/h.m20, m21/h.m21, m22/h.m22, m23/h.m23,
@@ -364,19 +412,73 @@ template <typename T> struct matrix4
 		return *this; }
 
 	template<typename R> self& operator*= (const matrix4<R>& h) const {	return *this = *this * h; }
+
+	GAMMA_CONSTEXPR self transposed() const { return self(
+		m00, m10, m20, m30,
+		m01, m11, m21, m31,
+		m02, m12, m22, m32,
+		m03, m13, m23, m33); }
+
+	T determinant() const {
+		T s0 = m00*m11 - m10*m01, s1 = m00*m12 - m10*m02, s2 = m00*m13 - m10*m03;
+		T s3 = m01*m12 - m11*m02, s4 = m01*m13 - m11*m03, s5 = m02*m13 - m12*m03;
+		T c0 = m20*m31 - m30*m21, c1 = m20*m32 - m30*m22, c2 = m20*m33 - m30*m23;
+		T c3 = m21*m32 - m31*m22, c4 = m21*m33 - m31*m23, c5 = m22*m33 - m32*m23;
+		return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0; }
+
+	/// General inverse via the Laplace expansion over the 2x2 sub-determinants
+	/// of the upper and lower two rows. The result is undefined for singular
+	/// matrices. Specialized with SIMD for float and double.
+	self inverse() const {
+		T s0 = m00*m11 - m10*m01, s1 = m00*m12 - m10*m02, s2 = m00*m13 - m10*m03;
+		T s3 = m01*m12 - m11*m02, s4 = m01*m13 - m11*m03, s5 = m02*m13 - m12*m03;
+		T c0 = m20*m31 - m30*m21, c1 = m20*m32 - m30*m22, c2 = m20*m33 - m30*m23;
+		T c3 = m21*m32 - m31*m22, c4 = m21*m33 - m31*m23, c5 = m22*m33 - m32*m23;
+		T f = T(1) / (s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0);
+		return self(
+			( m11*c5 - m12*c4 + m13*c3)*f, (-m01*c5 + m02*c4 - m03*c3)*f, ( m31*s5 - m32*s4 + m33*s3)*f, (-m21*s5 + m22*s4 - m23*s3)*f,
+			(-m10*c5 + m12*c2 - m13*c1)*f, ( m00*c5 - m02*c2 + m03*c1)*f, (-m30*s5 + m32*s2 - m33*s1)*f, ( m20*s5 - m22*s2 + m23*s1)*f,
+			( m10*c4 - m11*c2 + m13*c0)*f, (-m00*c4 + m01*c2 - m03*c0)*f, ( m30*s4 - m31*s2 + m33*s0)*f, (-m20*s4 + m21*s2 - m23*s0)*f,
+			(-m10*c3 + m11*c1 - m12*c0)*f, ( m00*c3 - m01*c1 + m02*c0)*f, (-m30*s3 + m31*s1 - m32*s0)*f, ( m20*s3 - m21*s1 + m22*s0)*f); }
+
+	/// Inverse of an affine transformation, i.e. a matrix whose last row is
+	/// (0,0,0,1). The upper 3x3 part may contain any invertible combination of
+	/// rotation, scale and shear. Specialized with SIMD for float.
+	self inverse_affine() const {
+		T c00 = m11*m22 - m12*m21, c01 = m02*m21 - m01*m22, c02 = m01*m12 - m02*m11;
+		T c10 = m12*m20 - m10*m22, c11 = m00*m22 - m02*m20, c12 = m02*m10 - m00*m12;
+		T c20 = m10*m21 - m11*m20, c21 = m01*m20 - m00*m21, c22 = m00*m11 - m01*m10;
+		T f = T(1) / (m00*c00 + m01*c10 + m02*c20);
+		c00 = c00*f; c01 = c01*f; c02 = c02*f;
+		c10 = c10*f; c11 = c11*f; c12 = c12*f;
+		c20 = c20*f; c21 = c21*f; c22 = c22*f;
+		return self(
+			c00, c01, c02, -(c00*m03 + c01*m13 + c02*m23),
+			c10, c11, c12, -(c10*m03 + c11*m13 + c12*m23),
+			c20, c21, c22, -(c20*m03 + c21*m13 + c22*m23),
+			0, 0, 0, 1); }
+
+	/// Inverse of an affine transformation whose upper 3x3 part is
+	/// orthonormal, i.e. a rotation followed by a translation, such as a view
+	/// matrix built by lookat. Specialized with SIMD for float.
+	self inverse_orthonormal() const { return self(
+		m00, m10, m20, -(m00*m03 + m10*m13 + m20*m23),
+		m01, m11, m21, -(m01*m03 + m11*m13 + m21*m23),
+		m02, m12, m22, -(m02*m03 + m12*m13 + m22*m23),
+		0, 0, 0, 1); }
 };
 
-template<typename T, typename R> matrix4<T> operator+ (const matrix4<T>& v, const matrix4<R>& h) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator+ (const matrix4<T>& v, const matrix4<R>& h) { return matrix4<T>(
 	v.m00+h.m00, v.m01+h.m01, v.m02+h.m02, v.m03+h.m03,
 	v.m10+h.m10, v.m11+h.m11, v.m12+h.m12, v.m13+h.m13,
 	v.m20+h.m20, v.m21+h.m21, v.m22+h.m22, v.m23+h.m23,
 	v.m30+h.m30, v.m31+h.m31, v.m32+h.m32, v.m33+h.m33); }
-template<typename T, typename R> matrix4<T> operator- (const matrix4<T>& v, const matrix4<R>& h) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator- (const matrix4<T>& v, const matrix4<R>& h) { return matrix4<T>(
 	v.m00-h.m00, v.m01-h.m01, v.m02-h.m02, v.m03-h.m03,
 	v.m10-h.m10, v.m11-h.m11, v.m12-h.m12, v.m13-h.m13,
 	v.m20-h.m20, v.m21-h.m21, v.m22-h.m22, v.m23-h.m23,
 	v.m30-h.m30, v.m31-h.m31, v.m32-h.m32, v.m33-h.m33); }
-template<typename T, typename R> matrix4<T> operator* (const matrix4<T>& v, const matrix4<R>& h) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator* (const matrix4<T>& v, const matrix4<R>& h) { return matrix4<T>(
 	v.m00*h.m00 + v.m01*h.m10 + v.m02*h.m20 + v.m03*h.m30, // m00
 	v.m00*h.m01 + v.m01*h.m11 + v.m02*h.m21 + v.m03*h.m31, // m01
 	v.m00*h.m02 + v.m01*h.m12 + v.m02*h.m22 + v.m03*h.m32, // m02
@@ -397,55 +499,100 @@ template<typename T, typename R> matrix4<T> operator* (const matrix4<T>& v, cons
 	v.m30*h.m02 + v.m31*h.m12 + v.m32*h.m22 + v.m33*h.m32, // m32
 	v.m30*h.m03 + v.m31*h.m13 + v.m32*h.m23 + v.m33*h.m33  // m33
 ); }
-template<typename T, typename R> vector4<R> operator* (const matrix4<T>& v, const vector4<R>& h) { return vector4<R>(
+template<typename T, typename R> GAMMA_CONSTEXPR vector4<R> operator* (const matrix4<T>& v, const vector4<R>& h) { return vector4<R>(
 	v.m00*h.x + v.m01*h.y + v.m02*h.z + v.m03*h.w, // x
 	v.m10*h.x + v.m11*h.y + v.m12*h.z + v.m13*h.w, // y
 	v.m20*h.x + v.m21*h.y + v.m22*h.z + v.m23*h.w, // z
 	v.m30*h.x + v.m31*h.y + v.m32*h.z + v.m33*h.w  // w
 ); }
 
-template<typename T, typename R> matrix4<T> operator+ (R h, const matrix4<T>& v) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator+ (R h, const matrix4<T>& v) { return matrix4<T>(
 	h+v.m00, h+v.m01, h+v.m02, h+v.m03,
 	h+v.m10, h+v.m11, h+v.m12, h+v.m13,
 	h+v.m20, h+v.m21, h+v.m22, h+v.m23,
 	h+v.m30, h+v.m31, h+v.m32, h+v.m33); }
-template<typename T, typename R> matrix4<T> operator- (R h, const matrix4<T>& v) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator- (R h, const matrix4<T>& v) { return matrix4<T>(
 	h-v.m00, h-v.m01, h-v.m02, h-v.m03,
 	h-v.m10, h-v.m11, h-v.m12, h-v.m13,
 	h-v.m20, h-v.m21, h-v.m22, h-v.m23,
 	h-v.m30, h-v.m31, h-v.m32, h-v.m33); }
-template<typename T, typename R> matrix4<T> operator* (R h, const matrix4<T>& v) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator* (R h, const matrix4<T>& v) { return matrix4<T>(
 	h*v.m00, h*v.m01, h*v.m02, h*v.m03,
 	h*v.m10, h*v.m11, h*v.m12, h*v.m13,
 	h*v.m20, h*v.m21, h*v.m22, h*v.m23,
 	h*v.m30, h*v.m31, h*v.m32, h*v.m33); }
-template<typename T, typename R> matrix4<T> operator/ (R h, const matrix4<T>& v) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator/ (R h, const matrix4<T>& v) { return matrix4<T>(
 	h/v.m00, h/v.m01, h/v.m02, h/v.m03,
 	h/v.m10, h/v.m11, h/v.m12, h/v.m13,
 	h/v.m20, h/v.m21, h/v.m22, h/v.m23,
 	h/v.m30, h/v.m31, h/v.m32, h/v.m33); }
 
-template<typename T, typename R> matrix4<T> operator+ (const matrix4<T>& v, R h) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator+ (const matrix4<T>& v, R h) { return matrix4<T>(
 	v.m00+h, v.m01+h, v.m02+h, v.m03+h,
 	v.m10+h, v.m11+h, v.m12+h, v.m13+h,
 	v.m20+h, v.m21+h, v.m22+h, v.m23+h,
 	v.m30+h, v.m31+h, v.m32+h, v.m33+h); }
-template<typename T, typename R> matrix4<T> operator- (const matrix4<T>& v, R h) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator- (const matrix4<T>& v, R h) { return matrix4<T>(
 	v.m00-h, v.m01-h, v.m02-h, v.m03-h,
 	v.m10-h, v.m11-h, v.m12-h, v.m13-h,
 	v.m20-h, v.m21-h, v.m22-h, v.m23-h,
 	v.m30-h, v.m31-h, v.m32-h, v.m33-h); }
-template<typename T, typename R> matrix4<T> operator* (const matrix4<T>& v, R h) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator* (const matrix4<T>& v, R h) { return matrix4<T>(
 	v.m00*h, v.m01*h, v.m02*h, v.m03*h,
 	v.m10*h, v.m11*h, v.m12*h, v.m13*h,
 	v.m20*h, v.m21*h, v.m22*h, v.m23*h,
 	v.m30*h, v.m31*h, v.m32*h, v.m33*h); }
-template<typename T, typename R> matrix4<T> operator/ (const matrix4<T>& v, R h) { return matrix4<T>(
+template<typename T, typename R> GAMMA_CONSTEXPR matrix4<T> operator/ (const matrix4<T>& v, R h) { return matrix4<T>(
 	v.m00/h, v.m01/h, v.m02/h, v.m03/h,
 	v.m10/h, v.m11/h, v.m12/h, v.m13/h,
 	v.m20/h, v.m21/h, v.m22/h, v.m23/h,
 	v.m30/h, v.m31/h, v.m32/h, v.m33/h); }
 
+// SIMD specializations of the 4x4 products for float and double. These take
+// precedence over the templates above as they are exact matches. The results
+// are bit-identical to the scalar templates, as long as the compiler does not
+// contract the scalar expressions into fused multiply-adds (-ffp-contract). If
+// it does, the two paths may differ by up to one rounding error per addition,
+// i.e. a relative difference of 4*epsilon of the element's magnitude. In
+// constant expressions the scalar templates are used instead.
+namespace detail {
+#ifdef GAMMA_SIMD
+inline matrix4<float> mul_simd(const matrix4<float>& v, const matrix4<float>& h) { matrix4<float> r; simd::mul_matrix4<simd::f32x4>(v.v, h.v, r.v); return r; }
+inline vector4<float> mul_simd(const matrix4<float>& v, const vector4<float>& h) { vector4<float> r; simd::mul_matrix4_vector4<simd::f32x4>(v.v, h, r); return r; }
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+inline matrix4<double> mul_simd(const matrix4<double>& v, const matrix4<double>& h) { matrix4<double> r; simd::mul_matrix4<simd::f64x4>(v.v, h.v, r.v); return r; }
+inline vector4<double> mul_simd(const matrix4<double>& v, const vector4<double>& h) { vector4<double> r; simd::mul_matrix4_vector4<simd::f64x4>(v.v, h, r); return r; }
+#endif
+} // namespace detail
+
+#ifdef GAMMA_HAS_IS_CONSTANT_EVALUATED
+#define GAMMA_MUL_SIMD(T, v, h) (__builtin_is_constant_evaluated() ? gma::operator*<T,T>(v, h) : detail::mul_simd(v, h))
+#else
+#define GAMMA_MUL_SIMD(T, v, h) detail::mul_simd(v, h)
+#endif
+
+#ifdef GAMMA_SIMD
+GAMMA_SIMD_CONSTEXPR inline matrix4<float> operator* (const matrix4<float>& v, const matrix4<float>& h) { return GAMMA_MUL_SIMD(float, v, h); }
+GAMMA_SIMD_CONSTEXPR inline vector4<float> operator* (const matrix4<float>& v, const vector4<float>& h) { return GAMMA_MUL_SIMD(float, v, h); }
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+GAMMA_SIMD_CONSTEXPR inline matrix4<double> operator* (const matrix4<double>& v, const matrix4<double>& h) { return GAMMA_MUL_SIMD(double, v, h); }
+GAMMA_SIMD_CONSTEXPR inline vector4<double> operator* (const matrix4<double>& v, const vector4<double>& h) { return GAMMA_MUL_SIMD(double, v, h); }
+#endif
+
+// SIMD specializations of the 4x4 inverses. The affine and orthonormal
+// inverses of double matrices are left to the scalar code, which the compiler
+// vectorizes better than the cross-lane shuffles of the packed version.
+#ifdef GAMMA_SIMD
+template<> inline matrix4<float> matrix4<float>::inverse() const { matrix4<float> r; simd::inverse_matrix4<simd::f32x4>(v, r.v); return r; }
+template<> inline matrix4<float> matrix4<float>::inverse_affine() const { matrix4<float> r; simd::inverse_affine_matrix4<simd::f32x4>(v, r.v); return r; }
+template<> inline matrix4<float> matrix4<float>::inverse_orthonormal() const { matrix4<float> r; simd::inverse_orthonormal_matrix4<simd::f32x4>(v, r.v); return r; }
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+template<> inline matrix4<double> matrix4<double>::inverse() const { matrix4<double> r; simd::inverse_matrix4<simd::f64x4>(v, r.v); return r; }
+#endif
+
 
 namespace convenience {
 	typedef matrix2<uint8_t> matrix2b;
@@ -4,6 +4,17 @@
 
 namespace gma {
 
+/// Returns the matrix that transforms normals under the model view matrix m,
+/// which is the cofactor matrix of m's upper-left 3x3 part. This equals the
+/// inverse transpose up to the determinant, which normalization cancels.
+template <typename T> matrix3<T> normal_matrix(const matrix4<T>& m)
+{
+	return matrix3<T>(
+		m.m11*m.m22-m.m21*m.m12, m.m20*m.m12-m.m10*m.m22, m.m10*m.m21-m.m20*m.m11,
+		m.m21*m.m02-m.m01*m.m22, m.m00*m.m22-m.m20*m.m02, m.m20*m.m01-m.m00*m.m21,
+		m.m01*m.m12-m.m11*m.m02, m.m10*m.m02-m.m00*m.m12, m.m00*m.m11-m.m10*m.m01);
+}
+
 template <typename T> struct mvp
 {
 	typedef mvp<T> self;
@@ -35,13 +46,7 @@ template <typename T> struct mvp
 		projection(projection),
 		model_view(view*model),
 		model_view_projection(projection*model_view),
-		normal(
-			#define m model_view
-			m.m11*m.m22-m.m21*m.m12, m.m20*m.m12-m.m10*m.m22, m.m10*m.m21-m.m20*m.m11,
-			m.m21*m.m02-m.m01*m.m22, m.m00*m.m22-m.m20*m.m02, m.m20*m.m01-m.m00*m.m21,
-			m.m01*m.m12-m.m11*m.m02, m.m10*m.m02-m.m00*m.m12, m.m00*m.m11-m.m10*m.m01
-			#undef m
-		) {}
+		normal(normal_matrix(model_view)) {}
 
 	mvp set            (const matrix4_type& m, const matrix4_type& v, const matrix4_type& p) const { return mvp(m, v, p); }
 	mvp set_model      (const matrix4_type& m) const { return mvp(m, view, projection); }
@@ -61,4 +66,99 @@ template <typename T> struct mvp
 typedef mvp<float>  mvpf;
 typedef mvp<double> mvpd;
 
+
+/// A mutable variant of mvp that is updated in place. Changes only mark the
+/// derived matrices as stale, which are then recomputed individually when
+/// read. The view projection product is cached, such that a change of the
+/// model matrix costs a single matrix product per derived matrix read, and
+/// none at all for derived matrices that are not read.
+///
+/// Note that the model view projection matrix is computed as (P*V)*M rather
+/// than P*(V*M) as in mvp, which may differ in the last bits.
+template <typename T> struct lazy_mvp
+{
+	typedef lazy_mvp<T> self;
+	typedef T scalar_type;
+	typedef matrix3<T> matrix3_type;
+	typedef matrix4<T> matrix4_type;
+
+	lazy_mvp():
+		model(1),
+		view(1),
+		projection(1),
+		stale(all) {}
+	lazy_mvp(
+		const matrix4_type& model,
+		const matrix4_type& view,
+		const matrix4_type& projection):
+		model(model),
+		view(view),
+		projection(projection),
+		stale(all) {}
+	explicit lazy_mvp(const mvp<T>& h):
+		model(h.model),
+		view(h.view),
+		projection(h.projection),
+		stale(all) {}
+
+	operator mvp<T>() const { return mvp<T>(model, view, projection); }
+
+	self& set            (const matrix4_type& m, const matrix4_type& v, const matrix4_type& p) { model = m; view = v; projection = p; stale = all; return *this; }
+	self& set_model      (const matrix4_type& m) { model = m; return model_changed(); }
+	self& set_view       (const matrix4_type& v) { view = v; return view_changed(); }
+	self& set_projection (const matrix4_type& p) { projection = p; return projection_changed(); }
+
+	self& mul_model      (const matrix4_type& m) { model = model*m; return model_changed(); }
+	self& mul_view       (const matrix4_type& v) { view = view*v; return view_changed(); }
+	self& mul_projection (const matrix4_type& p) { projection = projection*p; return projection_changed(); }
+
+	self& reset()            { return set(matrix4_type(1), matrix4_type(1), matrix4_type(1)); }
+	self& reset_model()      { return set_model(matrix4_type(1)); }
+	self& reset_view()       { return set_view(matrix4_type(1)); }
+	self& reset_projection() { return set_projection(matrix4_type(1)); }
+
+	const matrix4_type& get_model()      const { return model; }
+	const matrix4_type& get_view()       const { return view; }
+	const matrix4_type& get_projection() const { return projection; }
+
+	const matrix4_type& get_view_projection() const {
+		if (stale & stale_view_projection) { view_projection = projection*view; stale &= ~stale_view_projection; }
+		return view_projection; }
+	const matrix4_type& get_model_view() const {
+		if (stale & stale_model_view) { model_view = view*model; stale &= ~stale_model_view; }
+		return model_view; }
+	const matrix4_type& get_model_view_projection() const {
+		if (stale & stale_model_view_projection) { model_view_projection = get_view_projection()*model; stale &= ~stale_model_view_projection; }
+		return model_view_projection; }
+	const matrix3_type& get_normal() const {
+		if (stale & stale_normal) { normal = normal_matrix(get_model_view()); stale &= ~stale_normal; }
+		return normal; }
+
+private:
+	enum {
+		stale_view_projection       = 1 << 0,
+		stale_model_view            = 1 << 1,
+		stale_model_view_projection = 1 << 2,
+		stale_normal                = 1 << 3,
+		all = stale_view_projection | stale_model_view | stale_model_view_projection | stale_normal
+	};
+
+	matrix4_type model;
+	matrix4_type view;
+	matrix4_type projection;
+
+	mutable matrix4_type view_projection;
+	mutable matrix4_type model_view;
+	mutable matrix4_type model_view_projection;
+	mutable matrix3_type normal;
+	mutable unsigned stale;
+
+	self& model_changed()      { stale |= stale_model_view | stale_model_view_projection | stale_normal; return *this; }
+	self& view_changed()       { stale = all; return *this; }
+	self& projection_changed() { stale |= stale_view_projection | stale_model_view_projection; return *this; }
+};
+
+typedef lazy_mvp<float>  lazy_mvpf;
+typedef lazy_mvp<double> lazy_mvpd;
+
 } // namespace gma
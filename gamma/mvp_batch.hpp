@@ -0,0 +1,130 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/mvp.hpp"
+#include "gamma/parallel.hpp"
+#define GAMMA_HAS_MVP_BATCH
+
+namespace gma {
+
+namespace detail {
+
+template <typename T> struct mvp_batch_kernel
+{
+	matrix4<T> view, view_projection;
+	const matrix4<T>* models;
+	matrix4<T>* model_view;
+	matrix4<T>* model_view_projection;
+	matrix3<T>* normal;
+
+	void operator() (size_t begin, size_t end, unsigned) const
+	{
+		for (size_t i = begin; i < end; ++i)
+			compute(i, models[i]);
+	}
+
+	/// Writes the derived matrices of instance i with the given model matrix.
+	void compute(size_t i, const matrix4<T>& model) const
+	{
+		if (model_view_projection)
+			model_view_projection[i] = view_projection * model;
+		if (model_view || normal) {
+			matrix4<T> mv = view * model;
+			if (model_view) model_view[i] = mv;
+			if (normal) normal[i] = normal_matrix(mv);
+		}
+	}
+};
+
+template <typename T> struct mvp_relative_kernel
+{
+	mvp_batch_kernel<T> k;
+	vector3<double> origin;
+	const matrix4<double>* models;
+
+	/// Moves each model matrix into the space centered at origin, as
+	/// translation(-origin) * model. The rows of the product only differ in
+	/// the subtracted multiples of the last row, which for affine models is
+	/// just the translation. The large coordinates cancel in double, and the
+	/// rest of the product is done in T on small values.
+	void operator() (size_t begin, size_t end, unsigned) const
+	{
+		for (size_t i = begin; i < end; ++i) {
+			const matrix4<double>& m = models[i];
+			matrix4<T> r(
+				T(m.m00 - origin.x*m.m30), T(m.m01 - origin.x*m.m31), T(m.m02 - origin.x*m.m32), T(m.m03 - origin.x*m.m33),
+				T(m.m10 - origin.y*m.m30), T(m.m11 - origin.y*m.m31), T(m.m12 - origin.y*m.m32), T(m.m13 - origin.y*m.m33),
+				T(m.m20 - origin.z*m.m30), T(m.m21 - origin.z*m.m31), T(m.m22 - origin.z*m.m32), T(m.m23 - origin.z*m.m33),
+				T(m.m30), T(m.m31), T(m.m32), T(m.m33));
+			k.compute(i, r);
+		}
+	}
+};
+
+} // namespace detail
+
+/// Number of instances below which mvp_batch does not spawn any threads.
+const size_t mvp_batch_grain = 4096;
+
+/// Computes the derived matrices of an mvp for count instances sharing one
+/// view and projection. Instance i's model matrix is read from models[i] and
+/// its model view, model view projection and normal matrices are written to
+/// the corresponding index of the output arrays. Any of the output arrays
+/// may be null, in which case the corresponding matrices are not computed.
+///
+/// The view projection product is computed once up front, and the model
+/// view projection matrices are computed as (P*V)*M as in lazy_mvp. Large
+/// batches are split across all hardware threads.
+template <typename T> void mvp_batch(
+	const matrix4<T>& view,
+	const matrix4<T>& projection,
+	const matrix4<T>* models,
+	size_t count,
+	matrix4<T>* model_view,
+	matrix4<T>* model_view_projection,
+	matrix3<T>* normal)
+{
+	detail::mvp_batch_kernel<T> k;
+	k.view = view;
+	k.view_projection = projection * view;
+	k.models = models;
+	k.model_view = model_view;
+	k.model_view_projection = model_view_projection;
+	k.normal = normal;
+	parallel_for(count, mvp_batch_grain, k);
+}
+
+/// Computes the derived matrices of count instances relative to a camera at
+/// origin, for worlds too large for float. The model matrices are given in
+/// double in world space, and view is the camera's view matrix for a camera
+/// at origin, i.e. without the translation by -origin, such as the
+/// orientation transform of a lookat. The results are the same matrices as
+/// for the full view matrix view * translation(-origin), but precise to the
+/// resolution of T around the camera rather than around the world origin.
+///
+/// Each model is moved next to the camera in double, converted to T and then
+/// multiplied as in mvp_batch, all in one pass. This avoids computing the
+/// products in double and converting them, which costs a double matrix
+/// product per instance and output.
+template <typename T> void mvp_batch(
+	const vector3<double>& origin,
+	const matrix4<T>& view,
+	const matrix4<T>& projection,
+	const matrix4<double>* models,
+	size_t count,
+	matrix4<T>* model_view,
+	matrix4<T>* model_view_projection,
+	matrix3<T>* normal)
+{
+	detail::mvp_relative_kernel<T> k;
+	k.k.view = view;
+	k.k.view_projection = projection * view;
+	k.k.models = 0;
+	k.k.model_view = model_view;
+	k.k.model_view_projection = model_view_projection;
+	k.k.normal = normal;
+	k.origin = origin;
+	k.models = models;
+	parallel_for(count, mvp_batch_grain, k);
+}
+
+} // namespace gma
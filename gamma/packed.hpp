@@ -0,0 +1,371 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/simd.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#define GAMMA_HAS_PACKED
+
+// Compact storage for vertex and network buffers, as vectors of 8 or 16 bit
+// integers or of half-precision floats, and unit normals in 32 bits. The
+// arrays are converted from and to arrays of float vectors in bulk, four
+// values at a time in SIMD packs on x86. Values are rounded to the nearest
+// representable one. The error of a round trip is bounded as follows:
+//
+//     unorm, b bits   |f - f'| <= 0.5 / (2^b - 1) for f in [0,1]
+//     snorm, b bits   |f - f'| <= 0.5 / (2^(b-1) - 1) for f in [-1,1]
+//     half            |f - f'| <= 2^-11 |f| for 2^-14 <= |f| <= 65504, and
+//                     |f - f'| <= 2^-25 below; larger |f| become infinite
+//     octahedral      angle between n and n' below 0.004 degrees (6.5e-5 rad)
+//
+// Inputs outside the range of a unorm or snorm are clamped to it. Decoding
+// snorms maps the smallest integer to -1 as well, such that -1, 0 and 1 are
+// represented exactly.
+
+namespace gma {
+
+/// A half-precision float as storage, which converts to and from float.
+struct half
+{
+	uint16_t bits;
+
+	half() {}
+	explicit half(float f);
+	operator float() const;
+};
+
+/// A unit vector mapped onto an octahedron that is unfolded into a square,
+/// stored as two 16 bit snorms.
+struct octahedral
+{
+	int16_t u, v;
+
+	octahedral() {}
+	explicit octahedral(const vector3<float>& n);
+	vector3<float> normal() const;
+};
+
+namespace detail {
+
+inline uint32_t float_bits(float f) { uint32_t x; memcpy(&x, &f, 4); return x; }
+inline float bits_float(uint32_t x) { float f; memcpy(&f, &x, 4); return f; }
+
+/// Converts to half precision, rounding to nearest even. NaNs become quiet
+/// NaNs without payload.
+inline uint16_t float_to_half(float f)
+{
+	uint32_t x = float_bits(f);
+	uint32_t sign = x & 0x80000000u;
+	x ^= sign;
+	uint32_t h;
+	if (x >= (127u + 16) << 23) {
+		h = x > 255u << 23 ? 0x7e00 : 0x7c00;
+	} else if (x < 113u << 23) {
+		// Subnormal: let the float addition round the mantissa into place.
+		const uint32_t magic = ((127u - 15) + (23 - 10) + 1) << 23;
+		h = float_bits(bits_float(x) + bits_float(magic)) - magic;
+	} else {
+		x = x - ((127u - 15) << 23) + 0xfff + ((x >> 13) & 1);
+		h = x >> 13;
+	}
+	return (uint16_t)(h | sign >> 16);
+}
+
+inline float half_to_float(uint16_t h)
+{
+	const uint32_t exp = 0x7c00u << 13;
+	uint32_t x = (h & 0x7fffu) << 13;
+	uint32_t e = x & exp;
+	x += (127u - 15) << 23;
+	if (e == exp) {
+		x += (128u - 16) << 23;
+	} else if (e == 0) {
+		x += 1u << 23;
+		x = float_bits(bits_float(x) - bits_float(113u << 23));
+	}
+	return bits_float(x | (uint32_t)(h & 0x8000u) << 16);
+}
+
+/// Rounds f to the nearest integer, ties to even as the SIMD conversions do,
+/// for |f| < 2^22.
+inline float round_even(float f)
+{
+	const float magic = 12582912.0f; // 1.5 * 2^23
+	return (f + magic) - magic;
+}
+
+/// The properties of the integer types of unorms and snorms.
+template <typename I> struct norm_traits;
+template <> struct norm_traits<uint8_t>  { enum { lo = 0, hi = 255 }; };
+template <> struct norm_traits<uint16_t> { enum { lo = 0, hi = 65535 }; };
+template <> struct norm_traits<int8_t>   { enum { lo = -127, hi = 127 }; };
+template <> struct norm_traits<int16_t>  { enum { lo = -32767, hi = 32767 }; };
+
+/// Quantizes f to I, mapping [lo,hi]/hi onto [lo,hi].
+template <typename I> inline I quantize(float f)
+{
+	const float hi = (float)norm_traits<I>::hi, lo = (float)norm_traits<I>::lo / hi;
+	f = f < lo ? lo : (f > 1 ? 1 : f);
+	return (I)round_even(f * hi);
+}
+
+template <typename I> inline float dequantize(I i)
+{
+	float f = i * (1.0f / norm_traits<I>::hi);
+	return f < -1 ? -1 : f;
+}
+
+template <typename I> inline size_t quantize_scalar(size_t i, size_t n, const float* f, I* r)
+{
+	for (; i < n; ++i) r[i] = quantize<I>(f[i]);
+	return i;
+}
+
+template <typename I> inline size_t dequantize_scalar(size_t i, size_t n, const I* q, float* r)
+{
+	for (; i < n; ++i) r[i] = dequantize(q[i]);
+	return i;
+}
+
+inline size_t half_scalar(size_t i, size_t n, const float* f, half* r)
+{
+	for (; i < n; ++i) r[i].bits = float_to_half(f[i]);
+	return i;
+}
+
+inline size_t half_scalar(size_t i, size_t n, const half* h, float* r)
+{
+	for (; i < n; ++i) r[i] = half_to_float(h[i].bits);
+	return i;
+}
+
+/// Projects n onto the octahedron |x|+|y|+|z| = 1 and folds the lower half
+/// over the upper one, as (u, v) in [-1,1]^2.
+template <typename T> inline void octahedral_project(T x, T y, T z, T& u, T& v)
+{
+	T s = T(1) / (std::abs(x) + std::abs(y) + std::abs(z));
+	u = x * s;
+	v = y * s;
+	if (z < 0) {
+		T fu = (1 - std::abs(v)) * (u < 0 ? -1 : 1);
+		T fv = (1 - std::abs(u)) * (v < 0 ? -1 : 1);
+		u = fu;
+		v = fv;
+	}
+}
+
+inline size_t octahedral_scalar(size_t i, size_t n, const vector3<float>* v, octahedral* r)
+{
+	for (; i < n; ++i) r[i] = octahedral(v[i]);
+	return i;
+}
+
+inline size_t octahedral_scalar(size_t i, size_t n, const octahedral* o, vector3<float>* r)
+{
+	for (; i < n; ++i) r[i] = o[i].normal();
+	return i;
+}
+
+#ifdef GAMMA_SIMD_NARROW
+template <typename I> inline size_t quantize_simd(size_t n, const float* f, I* r)
+{
+	typedef simd::f32x4 P;
+	const P hi((float)norm_traits<I>::hi), lo((float)norm_traits<I>::lo / norm_traits<I>::hi), one(1);
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4)
+		simd::store_narrowed(simd::to_int_round(simd::min(simd::max(P::load(f+i), lo), one) * hi), r+i);
+	return i;
+}
+
+template <typename I> inline size_t dequantize_simd(size_t n, const I* q, float* r)
+{
+	typedef simd::f32x4 P;
+	const P scale(1.0f / norm_traits<I>::hi), lo(-1);
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4)
+		simd::max(simd::to_float(simd::load_widened(q+i)) * scale, lo).store(r+i);
+	return i;
+}
+
+/// Loads four vector3 as x, y and z packs, as in normalize_simd.
+inline void load_transposed(const float* p, simd::f32x4& x, simd::f32x4& y, simd::f32x4& z)
+{
+	typedef simd::f32x4 P;
+	P p0 = P::load(p), p1 = P::load(p+4), p2 = P::load(p+8);
+	P t = simd::shuffle<2,3,0,1>(p1, p2);         // x2 y2 z2 x3
+	P u = simd::shuffle<1,2,0,1>(p0, p1);         // y0 z0 y1 z1
+	P w = simd::shuffle<1,2,2,3>(t, p2);          // y2 z2 y3 z3
+	x = simd::shuffle<0,3,0,3>(p0, t);
+	y = simd::shuffle<0,2,0,2>(u, w);
+	z = simd::shuffle<1,3,1,3>(u, w);
+}
+
+/// Stores x, y and z packs as four vector3, the inverse of load_transposed.
+inline void store_transposed(float* p, simd::f32x4 x, simd::f32x4 y, simd::f32x4 z)
+{
+	using simd::shuffle;
+	shuffle<0,2,0,2>(shuffle<0,0,0,0>(x, y), shuffle<0,0,1,1>(z, x)).store(p);   // x0 y0 z0 x1
+	shuffle<0,2,0,2>(shuffle<1,1,1,1>(y, z), shuffle<2,2,2,2>(x, y)).store(p+4); // y1 z1 x2 y2
+	shuffle<0,2,0,2>(shuffle<2,2,3,3>(z, x), shuffle<3,3,3,3>(y, z)).store(p+8); // z2 x3 y3 z3
+}
+
+inline size_t octahedral_simd(size_t n, const vector3<float>* v, octahedral* r)
+{
+	typedef simd::f32x4 P;
+	const P one(1), hi(32767);
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4) {
+		P x, y, z;
+		load_transposed(&v[i].x, x, y, z);
+		P s = one / (simd::abs(x) + simd::abs(y) + simd::abs(z));
+		P u = x * s, w = y * s;
+		P fu = simd::mulsign(one - simd::abs(w), u);
+		P fw = simd::mulsign(one - simd::abs(u), w);
+		u = simd::select_negative(z, fu, u);
+		w = simd::select_negative(z, fw, w);
+		simd::store_narrowed(simd::to_int_round(u * hi), simd::to_int_round(w * hi), &r[i].u);
+	}
+	return i;
+}
+
+inline size_t octahedral_simd(size_t n, const octahedral* o, vector3<float>* r)
+{
+	typedef simd::f32x4 P;
+	const P zero(0), one(1), scale(1.0f / 32767), lo(-1);
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4) {
+		simd::i32x4 a, b;
+		simd::load_widened(&o[i].u, a, b);
+		P x = simd::max(simd::to_float(a) * scale, lo);
+		P y = simd::max(simd::to_float(b) * scale, lo);
+		P z = one - simd::abs(x) - simd::abs(y);
+		P t = simd::max(zero - z, zero);
+		x = x - simd::mulsign(t, x);
+		y = y - simd::mulsign(t, y);
+		P l = simd::sqrt(x*x + y*y + z*z);
+		store_transposed(&r[i].x, x / l, y / l, z / l);
+	}
+	return i;
+}
+#endif
+
+#ifdef GAMMA_SIMD_F16C
+inline size_t half_simd(size_t n, const float* f, half* r)
+{
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4)
+		simd::store_half(simd::f32x4::load(f+i), &r[i].bits);
+	return i;
+}
+
+inline size_t half_simd(size_t n, const half* h, float* r)
+{
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4)
+		simd::load_half(&h[i].bits).store(r+i);
+	return i;
+}
+#endif
+
+} // namespace detail
+
+inline half::half(float f): bits(detail::float_to_half(f)) {}
+inline half::operator float() const { return detail::half_to_float(bits); }
+
+inline octahedral::octahedral(const vector3<float>& n)
+{
+	float pu, pv;
+	detail::octahedral_project(n.x, n.y, n.z, pu, pv);
+	u = (int16_t)detail::round_even(pu * 32767);
+	v = (int16_t)detail::round_even(pv * 32767);
+}
+
+/// Returns the unit vector, whose angle to the encoded one is below the
+/// bound given above.
+inline vector3<float> octahedral::normal() const
+{
+	float x = detail::dequantize(u), y = detail::dequantize(v);
+	float z = 1 - std::abs(x) - std::abs(y);
+	float t = z < 0 ? -z : 0;
+	x -= x < 0 ? -t : t;
+	y -= y < 0 ? -t : t;
+	return vector3<float>(x, y, z).normalized();
+}
+
+/// Quantizes the n floats at f to unorms (uint8_t, uint16_t) or snorms
+/// (int8_t, int16_t) at r.
+template <typename I> void pack(const float* f, size_t n, I* r)
+{
+	size_t i = 0;
+#ifdef GAMMA_SIMD_NARROW
+	i = detail::quantize_simd(n, f, r);
+#endif
+	detail::quantize_scalar(i, n, f, r);
+}
+
+/// Converts the n unorms or snorms at q to floats at r.
+template <typename I> void unpack(const I* q, size_t n, float* r)
+{
+	size_t i = 0;
+#ifdef GAMMA_SIMD_NARROW
+	i = detail::dequantize_simd(n, q, r);
+#endif
+	detail::dequantize_scalar(i, n, q, r);
+}
+
+/// Converts the n floats at f to half precision at r.
+inline void pack(const float* f, size_t n, half* r)
+{
+	size_t i = 0;
+#ifdef GAMMA_SIMD_F16C
+	i = detail::half_simd(n, f, r);
+#endif
+	detail::half_scalar(i, n, f, r);
+}
+
+inline void unpack(const half* h, size_t n, float* r)
+{
+	size_t i = 0;
+#ifdef GAMMA_SIMD_F16C
+	i = detail::half_simd(n, h, r);
+#endif
+	detail::half_scalar(i, n, h, r);
+}
+
+/// Packs the n vectors at v componentwise, e.g. vector4f colors into
+/// vector4b unorms or vector3f positions into vector3<half>.
+template <typename I> void pack(const vector2<float>* v, size_t n, vector2<I>* r) { pack((const float*)v, 2*n, (I*)r); }
+template <typename I> void pack(const vector3<float>* v, size_t n, vector3<I>* r) { pack((const float*)v, 3*n, (I*)r); }
+template <typename I> void pack(const vector4<float>* v, size_t n, vector4<I>* r) { pack((const float*)v, 4*n, (I*)r); }
+template <typename I> void unpack(const vector2<I>* q, size_t n, vector2<float>* r) { unpack((const I*)q, 2*n, (float*)r); }
+template <typename I> void unpack(const vector3<I>* q, size_t n, vector3<float>* r) { unpack((const I*)q, 3*n, (float*)r); }
+template <typename I> void unpack(const vector4<I>* q, size_t n, vector4<float>* r) { unpack((const I*)q, 4*n, (float*)r); }
+
+/// Encodes the n unit vectors at v as octahedral normals at r.
+inline void pack(const vector3<float>* v, size_t n, octahedral* r)
+{
+	size_t i = 0;
+#ifdef GAMMA_SIMD_NARROW
+	i = detail::octahedral_simd(n, v, r);
+#endif
+	detail::octahedral_scalar(i, n, v, r);
+}
+
+/// Decodes the n octahedral normals at o into unit vectors at r.
+inline void unpack(const octahedral* o, size_t n, vector3<float>* r)
+{
+	size_t i = 0;
+#ifdef GAMMA_SIMD_NARROW
+	i = detail::octahedral_simd(n, o, r);
+#endif
+	detail::octahedral_scalar(i, n, o, r);
+}
+
+namespace convenience {
+	typedef vector2<half> vector2h;
+	typedef vector3<half> vector3h;
+	typedef vector4<half> vector4h;
+}
+} // namespace gma
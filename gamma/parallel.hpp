@@ -0,0 +1,73 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include <cstddef>
+#include <thread>
+#include <vector>
+#define GAMMA_HAS_PARALLEL
+
+namespace gma {
+
+/// Returns the number of workers parallel_for uses to process n items in
+/// chunks of at least grain items. Use this to size per-worker buffers. The
+/// number of workers is limited to max_workers, or to the number of hardware
+/// threads if max_workers is zero.
+inline unsigned parallel_workers(size_t n, size_t grain, unsigned max_workers = 0)
+{
+	unsigned hw = max_workers ? max_workers : std::thread::hardware_concurrency();
+	if (hw == 0) hw = 1;
+	if (grain == 0) grain = 1;
+	size_t chunks = (n + grain - 1) / grain;
+	if (chunks == 0) chunks = 1;
+	return chunks < hw ? (unsigned)chunks : hw;
+}
+
+namespace detail {
+
+/// Joins the threads it holds when destroyed, such that an exception thrown
+/// while spawning them or by the chunk on the calling thread does not destroy
+/// joinable threads, which would call std::terminate.
+struct thread_joiner
+{
+	std::vector<std::thread> threads;
+	~thread_joiner() {
+		for (size_t i = 0; i < threads.size(); ++i)
+			if (threads[i].joinable())
+				threads[i].join();
+	}
+};
+
+} // namespace detail
+
+/// Splits the range [0,n) into one contiguous chunk per worker and calls
+/// f(begin, end, worker) for each, where worker is in [0,parallel_workers).
+/// The calling thread processes the last chunk; if only one worker is
+/// needed, f is called inline without spawning any threads. Returns after
+/// all chunks have been processed. An exception thrown by f on the calling
+/// thread, or while spawning a thread, is rethrown after the threads already
+/// started have finished; f must not throw on the other threads.
+///
+/// Every call spawns fresh threads, which costs in the order of tens of
+/// microseconds per thread. Choose grain such that a chunk takes
+/// considerably longer, particularly for calls made several times per frame.
+template <typename F> void parallel_for(size_t n, size_t grain, F f, unsigned max_workers = 0)
+{
+	unsigned workers = parallel_workers(n, grain, max_workers);
+	if (workers <= 1) {
+		f(size_t(0), n, 0u);
+		return;
+	}
+
+	detail::thread_joiner joiner;
+	joiner.threads.reserve(workers-1);
+	size_t begin = 0;
+	for (unsigned w = 0; w < workers; ++w) {
+		size_t end = n * (w+1) / workers;
+		if (w+1 < workers)
+			joiner.threads.push_back(std::thread(f, begin, end, w));
+		else
+			f(begin, end, w);
+		begin = end;
+	}
+}
+
+} // namespace gma
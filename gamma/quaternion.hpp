@@ -0,0 +1,302 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/simd.hpp"
+#include <cstddef>
+#define GAMMA_HAS_QUATERNION
+
+namespace gma {
+
+/// A quaternion x*i + y*j + z*k + w, used to represent rotations. Unit
+/// quaternions rotate in the right-handed sense of x_rotation and z_rotation,
+/// i.e. axis_angle(vector3(0,0,1), a) corresponds to z_rotation(a). The
+/// components are stored in the order x, y, z, w such that a quaternion maps
+/// onto a single SIMD register.
+template <typename T> struct quaternion
+{
+	typedef T type;
+	typedef quaternion<T> self;
+
+	T x, y, z, w;
+
+	GAMMA_CONSTEXPR quaternion() : x(0), y(0), z(0), w(1) {}
+	GAMMA_CONSTEXPR explicit quaternion(T x, T y, T z, T w) : x(x), y(y), z(z), w(w) {}
+	GAMMA_CONSTEXPR explicit quaternion(const vector3<T>& v, T w) : x(v.x), y(v.y), z(v.z), w(w) {}
+	template<typename R> GAMMA_CONSTEXPR explicit quaternion(const quaternion<R>& h) : x(h.x), y(h.y), z(h.z), w(h.w) {}
+
+	/// Creates the rotation represented by the orthonormal matrix m.
+	explicit quaternion(const matrix3<T>& m) { assign(m); }
+	/// Creates the rotation represented by the upper left 3x3 block of m.
+	explicit quaternion(const matrix4<T>& m) { assign(m); }
+
+	/// Returns the rotation by angle radians about the unit vector axis.
+	static self axis_angle(const vector3<T>& axis, T angle) {
+		T s = sin(angle / 2);
+		return self(axis.x*s, axis.y*s, axis.z*s, cos(angle / 2));
+	}
+
+	GAMMA_CONSTEXPR vector3<T> vector() const { return vector3<T>(x, y, z); }
+
+	GAMMA_CONSTEXPR self operator- () const { return self(-x, -y, -z, -w); }
+	template<typename R> self& operator+= (const quaternion<R>& h) { x+=h.x; y+=h.y; z+=h.z; w+=h.w; return *this; }
+	template<typename R> self& operator-= (const quaternion<R>& h) { x-=h.x; y-=h.y; z-=h.z; w-=h.w; return *this; }
+	self& operator*= (const self& h) { return *this = *this * h; }
+	template<typename R> self& operator*= (R h) { x*=h; y*=h; z*=h; w*=h; return *this; }
+	template<typename R> self& operator/= (R h) { x/=h; y/=h; z/=h; w/=h; return *this; }
+
+	GAMMA_CONSTEXPR T dot(const self& h) const { return x*h.x + y*h.y + z*h.z + w*h.w; }
+	GAMMA_CONSTEXPR T length2() const { return dot(*this); }
+	T length() const { return sqrt(length2()); }
+
+	self& normalize() { T l = length(); return *this /= l; }
+	self normalized() const { T l = length(); return self(x/l, y/l, z/l, w/l); }
+
+	/// Returns the conjugate, which is the inverse rotation for unit
+	/// quaternions.
+	GAMMA_CONSTEXPR self conjugate() const { return self(-x, -y, -z, w); }
+	self inverse() const { T l = length2(); return self(-x/l, -y/l, -z/l, w/l); }
+
+	/// Rotates v by this quaternion, which must be of unit length.
+	vector3<T> rotate(const vector3<T>& v) const {
+		vector3<T> q(x, y, z);
+		vector3<T> t = q.cross(v) * T(2);
+		return v + t * w + q.cross(t);
+	}
+
+	matrix3<T> to_matrix3() const {
+		T xx = x*x, yy = y*y, zz = z*z;
+		T xy = x*y, xz = x*z, yz = y*z;
+		T wx = w*x, wy = w*y, wz = w*z;
+		return matrix3<T>(
+			1 - 2*(yy + zz),     2*(xy - wz),     2*(xz + wy),
+			    2*(xy + wz), 1 - 2*(xx + zz),     2*(yz - wx),
+			    2*(xz - wy),     2*(yz + wx), 1 - 2*(xx + yy));
+	}
+
+	matrix4<T> to_matrix4() const {
+		matrix3<T> m = to_matrix3();
+		return matrix4<T>(
+			m.m00, m.m01, m.m02, 0,
+			m.m10, m.m11, m.m12, 0,
+			m.m20, m.m21, m.m22, 0,
+			    0,     0,     0, 1);
+	}
+
+private:
+	/// Extracts the rotation from the upper left 3x3 block of m, dividing by
+	/// the largest of the four possible pivots for numerical stability.
+	template <typename M> void assign(const M& m) {
+		T tr = m.m00 + m.m11 + m.m22;
+		if (tr > 0) {
+			T s = sqrt(tr + 1) * 2;
+			x = (m.m21 - m.m12) / s; y = (m.m02 - m.m20) / s; z = (m.m10 - m.m01) / s; w = s / 4;
+		} else if (m.m00 > m.m11 && m.m00 > m.m22) {
+			T s = sqrt(1 + m.m00 - m.m11 - m.m22) * 2;
+			x = s / 4; y = (m.m01 + m.m10) / s; z = (m.m02 + m.m20) / s; w = (m.m21 - m.m12) / s;
+		} else if (m.m11 > m.m22) {
+			T s = sqrt(1 + m.m11 - m.m00 - m.m22) * 2;
+			x = (m.m01 + m.m10) / s; y = s / 4; z = (m.m12 + m.m21) / s; w = (m.m02 - m.m20) / s;
+		} else {
+			T s = sqrt(1 + m.m22 - m.m00 - m.m11) * 2;
+			x = (m.m02 + m.m20) / s; y = (m.m12 + m.m21) / s; z = s / 4; w = (m.m10 - m.m01) / s;
+		}
+	}
+};
+
+template<typename T> GAMMA_CONSTEXPR quaternion<T> operator+ (const quaternion<T>& a, const quaternion<T>& b) { return quaternion<T>(a.x+b.x, a.y+b.y, a.z+b.z, a.w+b.w); }
+template<typename T> GAMMA_CONSTEXPR quaternion<T> operator- (const quaternion<T>& a, const quaternion<T>& b) { return quaternion<T>(a.x-b.x, a.y-b.y, a.z-b.z, a.w-b.w); }
+
+/// Hamilton product. Rotates by b first, then by a.
+template<typename T> GAMMA_CONSTEXPR quaternion<T> operator* (const quaternion<T>& a, const quaternion<T>& b) { return quaternion<T>(
+	a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y,
+	a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x,
+	a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w,
+	a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z);
+}
+
+template<typename T> vector3<T> operator* (const quaternion<T>& q, const vector3<T>& v) { return q.rotate(v); }
+
+template<typename T, typename R> GAMMA_CONSTEXPR quaternion<T> operator* (const quaternion<T>& q, R h) { return quaternion<T>(q.x*h, q.y*h, q.z*h, q.w*h); }
+template<typename T, typename R> GAMMA_CONSTEXPR quaternion<T> operator* (R h, const quaternion<T>& q) { return quaternion<T>(h*q.x, h*q.y, h*q.z, h*q.w); }
+template<typename T, typename R> GAMMA_CONSTEXPR quaternion<T> operator/ (const quaternion<T>& q, R h) { return quaternion<T>(q.x/h, q.y/h, q.z/h, q.w/h); }
+
+template<typename T, typename R> GAMMA_CONSTEXPR bool operator== (const quaternion<T>& a, const quaternion<R>& b) { return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w; }
+template<typename T, typename R> GAMMA_CONSTEXPR bool operator!= (const quaternion<T>& a, const quaternion<R>& b) { return !(a == b); }
+
+#ifdef GAMMA_SIMD
+namespace detail {
+
+/// Hamilton product of two quaternions held in packs as (x, y, z, w).
+template <typename P> inline P quaternion_mul(P a, P b)
+{
+	typedef typename P::scalar_type T;
+	const T s[12] = { 1,-1, 1,-1,   1, 1,-1,-1,  -1, 1, 1,-1 };
+	return simd::swizzle<3,3,3,3>(a) * b
+		+ simd::swizzle<0,0,0,0>(a) * simd::swizzle<3,2,1,0>(b) * P::load(s)
+		+ simd::swizzle<1,1,1,1>(a) * simd::swizzle<2,3,0,1>(b) * P::load(s+4)
+		+ simd::swizzle<2,2,2,2>(a) * simd::swizzle<1,0,3,2>(b) * P::load(s+8);
+}
+
+template <typename P> inline quaternion<typename P::scalar_type> mul_simd(
+	const quaternion<typename P::scalar_type>& a, const quaternion<typename P::scalar_type>& b)
+{
+	quaternion<typename P::scalar_type> r;
+	quaternion_mul(P::load(&a.x), P::load(&b.x)).store(&r.x);
+	return r;
+}
+
+} // namespace detail
+
+GAMMA_SIMD_CONSTEXPR inline quaternion<float> operator* (const quaternion<float>& a, const quaternion<float>& b)
+{
+#ifdef GAMMA_HAS_IS_CONSTANT_EVALUATED
+	return __builtin_is_constant_evaluated() ? gma::operator*<float>(a, b) : detail::mul_simd<simd::f32x4>(a, b);
+#else
+	return detail::mul_simd<simd::f32x4>(a, b);
+#endif
+}
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+GAMMA_SIMD_CONSTEXPR inline quaternion<double> operator* (const quaternion<double>& a, const quaternion<double>& b)
+{
+#ifdef GAMMA_HAS_IS_CONSTANT_EVALUATED
+	return __builtin_is_constant_evaluated() ? gma::operator*<double>(a, b) : detail::mul_simd<simd::f64x4>(a, b);
+#else
+	return detail::mul_simd<simd::f64x4>(a, b);
+#endif
+}
+#endif
+
+/// Normalized linear interpolation from a to b along the shorter arc. Cheaper
+/// than slerp, but does not interpolate at constant angular velocity.
+template <typename T> quaternion<T> nlerp(const quaternion<T>& a, const quaternion<T>& b, T t)
+{
+	T s = a.dot(b) < 0 ? -t : t;
+	return (a * (1 - t) + b * s).normalized();
+}
+
+/// Spherical linear interpolation from a to b along the shorter arc. Both
+/// quaternions must be of unit length. Falls back to nlerp when a and b are
+/// nearly parallel, where the division by sin(theta) becomes unstable.
+template <typename T> quaternion<T> slerp(const quaternion<T>& a, const quaternion<T>& b, T t)
+{
+	T d = a.dot(b);
+	T s = d < 0 ? -1 : 1;
+	d *= s;
+	if (d > T(0.9995))
+		return (a * (1 - t) + b * (s * t)).normalized();
+	T theta = acos(d);
+	T r = 1 / sin(theta);
+	return a * (sin((1 - t) * theta) * r) + b * (s * sin(t * theta) * r);
+}
+
+namespace detail {
+
+/// Approximates sin(t*theta)/sin(theta) given t and xm1 = cos(theta) - 1,
+/// for cos(theta) in [0,1]. Evaluates the series of the ratio in powers of
+/// (cos(theta) - 1) described by D. Eberly in "A Fast and Accurate Algorithm
+/// for Computing SLERP", truncated after 12 terms with the last term scaled to
+/// minimize the maximum error. The absolute error is below 1e-6 for t in
+/// [0,1]. V is either a scalar or a SIMD pack.
+template <typename V> inline V slerp_weight(V t, V xm1)
+{
+	const int n = 12;
+	const double mu = 1.8937252652131586;
+	V t2 = t * t, r(1.0);
+	for (int i = n-1; i >= 0; --i) {
+		double u = 1.0 / ((i+1) * (2*i+3)), v = (i+1) / (2.0*i+3);
+		if (i == n-1) { u *= mu; v *= mu; }
+		r = V(1.0) + (V(u) * t2 - V(v)) * xm1 * r;
+	}
+	return t * r;
+}
+
+template <typename T> inline size_t slerp_batch_scalar(size_t i, size_t n,
+	const quaternion<T>* a, const quaternion<T>* b, const T* t, quaternion<T>* r)
+{
+	for (; i < n; ++i) {
+		T d = a[i].dot(b[i]);
+		T xm1 = (d < 0 ? -d : d) - 1;
+		T wa = slerp_weight<T>(1 - t[i], xm1);
+		T wb = slerp_weight<T>(t[i], xm1);
+		r[i] = a[i] * wa + b[i] * (d < 0 ? -wb : wb);
+	}
+	return i;
+}
+
+#ifdef GAMMA_SIMD
+/// Interpolates four quaternions at a time, transposed such that each pack
+/// holds one component of all four.
+template <typename P> inline size_t slerp_batch_simd(size_t n,
+	const quaternion<typename P::scalar_type>* a, const quaternion<typename P::scalar_type>* b,
+	const typename P::scalar_type* t, quaternion<typename P::scalar_type>* r)
+{
+	typedef typename P::scalar_type T;
+	const P one(1.0);
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4) {
+		const T* pa = &a[i].x;
+		const T* pb = &b[i].x;
+		P ax = P::load(pa), ay = P::load(pa+4), az = P::load(pa+8), aw = P::load(pa+12);
+		P bx = P::load(pb), by = P::load(pb+4), bz = P::load(pb+8), bw = P::load(pb+12);
+		simd::transpose4(ax, ay, az, aw);
+		simd::transpose4(bx, by, bz, bw);
+
+		P d = ax*bx + ay*by + az*bz + aw*bw;
+		P xm1 = simd::abs(d) - one;
+		P ti = P::load(t+i);
+		P wa = slerp_weight(one - ti, xm1);
+		P wb = simd::mulsign(slerp_weight(ti, xm1), d);
+
+		P rx = ax*wa + bx*wb, ry = ay*wa + by*wb, rz = az*wa + bz*wb, rw = aw*wa + bw*wb;
+		simd::transpose4(rx, ry, rz, rw);
+		T* pr = &r[i].x;
+		rx.store(pr); ry.store(pr+4); rz.store(pr+8); rw.store(pr+12);
+	}
+	return i;
+}
+#endif
+
+template <typename T> inline void slerp_batch(size_t n,
+	const quaternion<T>* a, const quaternion<T>* b, const T* t, quaternion<T>* r)
+{
+	slerp_batch_scalar(0, n, a, b, t, r);
+}
+
+#ifdef GAMMA_SIMD
+inline void slerp_batch(size_t n,
+	const quaternion<float>* a, const quaternion<float>* b, const float* t, quaternion<float>* r)
+{
+	size_t i = slerp_batch_simd<simd::f32x4>(n, a, b, t, r);
+	slerp_batch_scalar(i, n, a, b, t, r);
+}
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+inline void slerp_batch(size_t n,
+	const quaternion<double>* a, const quaternion<double>* b, const double* t, quaternion<double>* r)
+{
+	size_t i = slerp_batch_simd<simd::f64x4>(n, a, b, t, r);
+	slerp_batch_scalar(i, n, a, b, t, r);
+}
+#endif
+
+} // namespace detail
+
+/// Spherically interpolates the n unit quaternions a[i] towards b[i] at t[i]
+/// along the shorter arc, storing the results in r. The output may alias
+/// either input. Instead of acos and sin, the interpolation weights are
+/// computed by the polynomial detail::slerp_weight, which is accurate to 1e-6
+/// and vectorizes well. The results are therefore close to but not exactly
+/// those of slerp().
+template <typename T> void slerp(const quaternion<T>* a, const quaternion<T>* b, const T* t, quaternion<T>* r, size_t n)
+{
+	detail::slerp_batch(n, a, b, t, r);
+}
+
+namespace convenience {
+	typedef quaternion<float> quaternionf;
+	typedef quaternion<double> quaterniond;
+}
+} // namespace gma
@@ -0,0 +1,755 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include <cstring>
+#define GAMMA_HAS_SIMD
+
+// Instruction set selection. The SIMD code paths are chosen at compile time
+// based on the flags the compiler was invoked with (e.g. -msse4.1, -mavx or
+// -march=native). Define GAMMA_NO_SIMD to force the scalar implementations.
+#ifndef GAMMA_NO_SIMD
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define GAMMA_SIMD_SSE2
+		#include <emmintrin.h>
+	#endif
+	#if defined(__SSSE3__)
+		#include <tmmintrin.h>
+	#endif
+	#if defined(__SSE4_1__)
+		#define GAMMA_SIMD_SSE41
+		#include <smmintrin.h>
+	#endif
+	#if defined(__AVX__)
+		#define GAMMA_SIMD_AVX
+		#include <immintrin.h>
+	#endif
+	#if defined(__AVX2__)
+		#define GAMMA_SIMD_AVX2
+	#endif
+	#if defined(__F16C__)
+		#define GAMMA_SIMD_F16C
+		#include <immintrin.h>
+	#endif
+	#if defined(__FMA__) && defined(__AVX__)
+		#define GAMMA_SIMD_FMA
+	#endif
+	#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+		#define GAMMA_SIMD_NEON
+		#include <arm_neon.h>
+		#if defined(__aarch64__)
+			#define GAMMA_SIMD_FMA
+		#endif
+	#endif
+#endif
+
+#if defined(GAMMA_SIMD_SSE2) || defined(GAMMA_SIMD_NEON)
+	#define GAMMA_SIMD
+#endif
+#if defined(GAMMA_SIMD_SSE2) || (defined(GAMMA_SIMD_NEON) && defined(__aarch64__))
+	#define GAMMA_SIMD_DOUBLE
+#endif
+
+namespace gma {
+namespace simd {
+
+// The pack types below are thin wrappers around the native registers such
+// that algorithms can be written once and instantiated for float and double.
+// All loads and stores are unaligned.
+
+#ifdef GAMMA_SIMD
+
+/// Four packed floats.
+struct f32x4
+{
+	typedef float scalar_type;
+	const static int size = 4;
+
+#if defined(GAMMA_SIMD_SSE2)
+	typedef __m128 native_type;
+	native_type v;
+	f32x4() {}
+	f32x4(native_type v) : v(v) {}
+	explicit f32x4(float h) : v(_mm_set1_ps(h)) {}
+	static f32x4 load(const float* p) { return _mm_loadu_ps(p); }
+	void store(float* p) const { _mm_storeu_ps(p, v); }
+#elif defined(GAMMA_SIMD_NEON)
+	typedef float32x4_t native_type;
+	native_type v;
+	f32x4() {}
+	f32x4(native_type v) : v(v) {}
+	explicit f32x4(float h) : v(vdupq_n_f32(h)) {}
+	static f32x4 load(const float* p) { return vld1q_f32(p); }
+	void store(float* p) const { vst1q_f32(p, v); }
+#endif
+};
+
+#if defined(GAMMA_SIMD_SSE2)
+inline f32x4 operator+ (f32x4 a, f32x4 b) { return _mm_add_ps(a.v, b.v); }
+inline f32x4 operator- (f32x4 a, f32x4 b) { return _mm_sub_ps(a.v, b.v); }
+inline f32x4 operator* (f32x4 a, f32x4 b) { return _mm_mul_ps(a.v, b.v); }
+inline f32x4 operator/ (f32x4 a, f32x4 b) { return _mm_div_ps(a.v, b.v); }
+
+/// Rounds to the nearest integer. Only valid for |a| < 2^31.
+inline f32x4 round(f32x4 a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)); }
+/// Returns |a|.
+inline f32x4 abs(f32x4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+/// Returns a with its sign flipped wherever s is negative.
+inline f32x4 mulsign(f32x4 a, f32x4 s) { return _mm_xor_ps(a.v, _mm_and_ps(s.v, _mm_set1_ps(-0.0f))); }
+inline f32x4 min(f32x4 a, f32x4 b) { return _mm_min_ps(a.v, b.v); }
+inline f32x4 max(f32x4 a, f32x4 b) { return _mm_max_ps(a.v, b.v); }
+/// Returns the correctly rounded square root.
+inline f32x4 sqrt(f32x4 a) { return _mm_sqrt_ps(a.v); }
+/// Estimates 1/sqrt(a) with a relative error below 1.5*2^-12.
+inline f32x4 rsqrt_estimate(f32x4 a) { return _mm_rsqrt_ps(a.v); }
+/// Returns the sign bits of the lanes of a, lane i in bit i.
+inline int signmask(f32x4 a) { return _mm_movemask_ps(a.v); }
+
+/// Returns (a[i0], a[i1], b[i2], b[i3]).
+template <int i0, int i1, int i2, int i3> inline f32x4 shuffle(f32x4 a, f32x4 b) { return _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(i3,i2,i1,i0)); }
+#elif defined(GAMMA_SIMD_NEON)
+inline f32x4 operator+ (f32x4 a, f32x4 b) { return vaddq_f32(a.v, b.v); }
+inline f32x4 operator- (f32x4 a, f32x4 b) { return vsubq_f32(a.v, b.v); }
+inline f32x4 operator* (f32x4 a, f32x4 b) { return vmulq_f32(a.v, b.v); }
+/// Returns |a|.
+inline f32x4 abs(f32x4 a) { return vabsq_f32(a.v); }
+/// Returns a with its sign flipped wherever s is negative.
+inline f32x4 mulsign(f32x4 a, f32x4 s) {
+	uint32x4_t m = vandq_u32(vreinterpretq_u32_f32(s.v), vdupq_n_u32(0x80000000u));
+	return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a.v), m));
+}
+inline f32x4 min(f32x4 a, f32x4 b) { return vminq_f32(a.v, b.v); }
+inline f32x4 max(f32x4 a, f32x4 b) { return vmaxq_f32(a.v, b.v); }
+/// Estimates 1/sqrt(a) with a relative error below 1.5*2^-12, from the
+/// 8 bit estimate refined by one Newton-Raphson step.
+inline f32x4 rsqrt_estimate(f32x4 a) {
+	float32x4_t y = vrsqrteq_f32(a.v);
+	return vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(a.v, y), y));
+}
+/// Returns the sign bits of the lanes of a, lane i in bit i.
+inline int signmask(f32x4 a) {
+	const uint32x4_t weights = {1, 2, 4, 8};
+	uint32x4_t bits = vandq_u32(vshrq_n_u32(vreinterpretq_u32_f32(a.v), 31), weights);
+#if defined(__aarch64__)
+	return vaddvq_u32(bits);
+#else
+	uint32x2_t h = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+	return vget_lane_u32(vpadd_u32(h, h), 0);
+#endif
+}
+#if defined(__aarch64__)
+inline f32x4 operator/ (f32x4 a, f32x4 b) { return vdivq_f32(a.v, b.v); }
+inline f32x4 round(f32x4 a) { return vrndnq_f32(a.v); }
+inline f32x4 sqrt(f32x4 a) { return vsqrtq_f32(a.v); }
+#else
+inline f32x4 operator/ (f32x4 a, f32x4 b) {
+	float x[4], y[4];
+	a.store(x); b.store(y);
+	for (int i = 0; i < 4; ++i) x[i] /= y[i];
+	return f32x4::load(x);
+}
+/// Rounds to the nearest integer, with ties away from zero. Only valid for
+/// |a| < 2^31.
+inline f32x4 round(f32x4 a) {
+	float32x4_t h = vbslq_f32(vcltq_f32(a.v, vdupq_n_f32(0)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+	return vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(a.v, h)));
+}
+inline f32x4 sqrt(f32x4 a) {
+	float x[4];
+	a.store(x);
+	for (int i = 0; i < 4; ++i) x[i] = sqrtf(x[i]);
+	return f32x4::load(x);
+}
+#endif
+
+/// Returns (a[i0], a[i1], b[i2], b[i3]).
+template <int i0, int i1, int i2, int i3> inline f32x4 shuffle(f32x4 a, f32x4 b) {
+#if defined(__clang__)
+	return __builtin_shufflevector(a.v, b.v, i0, i1, i2+4, i3+4);
+#else
+	const uint32x4_t mask = {i0, i1, i2+4, i3+4};
+	return __builtin_shuffle(a.v, b.v, mask);
+#endif
+}
+#endif
+
+/// Four packed 32 bit signed integers, used for fixed-point arithmetic.
+struct i32x4
+{
+	typedef int32_t scalar_type;
+	typedef f32x4 float_type;
+	const static int size = 4;
+
+#if defined(GAMMA_SIMD_SSE2)
+	typedef __m128i native_type;
+	native_type v;
+	i32x4() {}
+	i32x4(native_type v) : v(v) {}
+	explicit i32x4(int32_t h) : v(_mm_set1_epi32(h)) {}
+	static i32x4 load(const int32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+	void store(int32_t* p) const { _mm_storeu_si128((__m128i*)p, v); }
+#elif defined(GAMMA_SIMD_NEON)
+	typedef int32x4_t native_type;
+	native_type v;
+	i32x4() {}
+	i32x4(native_type v) : v(v) {}
+	explicit i32x4(int32_t h) : v(vdupq_n_s32(h)) {}
+	static i32x4 load(const int32_t* p) { return vld1q_s32(p); }
+	void store(int32_t* p) const { vst1q_s32(p, v); }
+#endif
+};
+
+// The arithmetic wraps around on overflow. mulshift<D>(a, b) computes the
+// full 64 bit product a*b, divides it by 2^D rounding towards zero, and
+// returns the low 32 bits of the quotient. This is exactly what the scalar
+// expression (int32_t)((int64_t)a * b / (1 << D)) yields.
+#if defined(GAMMA_SIMD_SSE2)
+inline i32x4 operator+ (i32x4 a, i32x4 b) { return _mm_add_epi32(a.v, b.v); }
+inline i32x4 operator- (i32x4 a, i32x4 b) { return _mm_sub_epi32(a.v, b.v); }
+
+namespace detail {
+	inline __m128i abs_epi32(__m128i a) {
+	#if defined(__SSSE3__)
+		return _mm_abs_epi32(a);
+	#else
+		__m128i s = _mm_srai_epi32(a, 31);
+		return _mm_sub_epi32(_mm_xor_si128(a, s), s);
+	#endif
+	}
+}
+/// Works on magnitudes, such that the unsigned 32x32 bit multiplication of
+/// SSE2 suffices and the division rounds towards zero by a plain shift. The
+/// sign is applied to the low 32 bits of the quotient at the end.
+template <int D> inline i32x4 mulshift(i32x4 a, i32x4 b) {
+	__m128i neg = _mm_srai_epi32(_mm_xor_si128(a.v, b.v), 31);
+	__m128i x = detail::abs_epi32(a.v), y = detail::abs_epi32(b.v);
+	__m128i p02 = _mm_srli_epi64(_mm_mul_epu32(x, y), D);
+	__m128i p13 = _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32)), 32 - D);
+#if defined(GAMMA_SIMD_SSE41)
+	__m128i q = _mm_blend_epi16(p02, p13, 0xcc);
+#else
+	const __m128i lo = _mm_set_epi32(0, -1, 0, -1);
+	__m128i q = _mm_or_si128(_mm_and_si128(p02, lo), _mm_andnot_si128(lo, p13));
+#endif
+	return _mm_sub_epi32(_mm_xor_si128(q, neg), neg);
+}
+
+/// Converts to float, rounding to nearest.
+inline f32x4 to_float(i32x4 a) { return _mm_cvtepi32_ps(a.v); }
+/// Converts to integers, rounding towards zero.
+inline i32x4 to_int_trunc(f32x4 a) { return _mm_cvttps_epi32(a.v); }
+/// Converts to integers, rounding to nearest even.
+inline i32x4 to_int_round(f32x4 a) { return _mm_cvtps_epi32(a.v); }
+
+/// Returns a where s is negative, including -0, and b elsewhere.
+inline f32x4 select_negative(f32x4 s, f32x4 a, f32x4 b) {
+#if defined(GAMMA_SIMD_SSE41)
+	return _mm_blendv_ps(b.v, a.v, s.v);
+#else
+	__m128 m = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(s.v), 31));
+	return _mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v));
+#endif
+}
+
+// Conversions between i32x4 and four 8 or 16 bit integers in memory, as used
+// by packed.hpp. The loads sign- or zero-extend, the stores saturate.
+#define GAMMA_SIMD_NARROW
+inline i32x4 load_widened(const uint8_t* p) {
+	int32_t w; memcpy(&w, p, 4);
+	__m128i z = _mm_setzero_si128();
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(w), z), z);
+}
+inline i32x4 load_widened(const int8_t* p) {
+	int32_t w; memcpy(&w, p, 4);
+	__m128i x = _mm_cvtsi32_si128(w);
+	x = _mm_unpacklo_epi8(x, x);
+	return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 24);
+}
+inline i32x4 load_widened(const uint16_t* p) { return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()); }
+inline i32x4 load_widened(const int16_t* p) { __m128i x = _mm_loadl_epi64((const __m128i*)p); return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16); }
+
+inline void store_narrowed(i32x4 a, uint8_t* p) { __m128i x = _mm_packs_epi32(a.v, a.v); int32_t w = _mm_cvtsi128_si32(_mm_packus_epi16(x, x)); memcpy(p, &w, 4); }
+inline void store_narrowed(i32x4 a, int8_t* p) { __m128i x = _mm_packs_epi32(a.v, a.v); int32_t w = _mm_cvtsi128_si32(_mm_packs_epi16(x, x)); memcpy(p, &w, 4); }
+inline void store_narrowed(i32x4 a, int16_t* p) { _mm_storel_epi64((__m128i*)p, _mm_packs_epi32(a.v, a.v)); }
+inline void store_narrowed(i32x4 a, uint16_t* p) {
+	// Bias into the signed range, since SSE2 only packs with signed saturation.
+	__m128i x = _mm_sub_epi32(a.v, _mm_set1_epi32(32768));
+	x = _mm_packs_epi32(x, x);
+	_mm_storel_epi64((__m128i*)p, _mm_xor_si128(x, _mm_set1_epi16((short)0x8000)));
+}
+
+/// Loads four pairs (a0 b0 a1 b1 ...) of 16 bit integers, sign-extended.
+inline void load_widened(const int16_t* p, i32x4& a, i32x4& b) {
+	__m128i x = _mm_loadu_si128((const __m128i*)p);
+	a = _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+	b = _mm_srai_epi32(x, 16);
+}
+/// Stores the lanes of a and b as four pairs (a0 b0 a1 b1 ...), saturated.
+inline void store_narrowed(i32x4 a, i32x4 b, int16_t* p) {
+	_mm_storeu_si128((__m128i*)p, _mm_packs_epi32(_mm_unpacklo_epi32(a.v, b.v), _mm_unpackhi_epi32(a.v, b.v)));
+}
+
+#ifdef GAMMA_SIMD_F16C
+/// Converts four half-precision floats, given by their bits, to float.
+inline f32x4 load_half(const uint16_t* p) { return _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)p)); }
+/// Converts to half precision, rounding to nearest even, and stores the bits.
+inline void store_half(f32x4 a, uint16_t* p) { _mm_storel_epi64((__m128i*)p, _mm_cvtps_ph(a.v, 0)); }
+#endif
+#elif defined(GAMMA_SIMD_NEON)
+inline i32x4 operator+ (i32x4 a, i32x4 b) { return vaddq_s32(a.v, b.v); }
+inline i32x4 operator- (i32x4 a, i32x4 b) { return vsubq_s32(a.v, b.v); }
+
+namespace detail {
+	template <int D> inline int32x2_t shift_trunc(int64x2_t p) {
+		p = vaddq_s64(p, vandq_s64(vshrq_n_s64(p, 63), vdupq_n_s64(((int64_t)1 << D) - 1)));
+		return vmovn_s64(vshlq_s64(p, vdupq_n_s64(-D)));
+	}
+}
+template <int D> inline i32x4 mulshift(i32x4 a, i32x4 b) {
+	int32x2_t lo = detail::shift_trunc<D>(vmull_s32(vget_low_s32(a.v), vget_low_s32(b.v)));
+	int32x2_t hi = detail::shift_trunc<D>(vmull_s32(vget_high_s32(a.v), vget_high_s32(b.v)));
+	return vcombine_s32(lo, hi);
+}
+
+inline f32x4 to_float(i32x4 a) { return vcvtq_f32_s32(a.v); }
+inline i32x4 to_int_trunc(f32x4 a) { return vcvtq_s32_f32(a.v); }
+#endif
+
+#endif // GAMMA_SIMD
+
+#ifdef GAMMA_SIMD_AVX
+
+/// Eight packed floats.
+struct f32x8
+{
+	typedef float scalar_type;
+	const static int size = 8;
+
+	typedef __m256 native_type;
+	native_type v;
+	f32x8() {}
+	f32x8(native_type v) : v(v) {}
+	explicit f32x8(float h) : v(_mm256_set1_ps(h)) {}
+	static f32x8 load(const float* p) { return _mm256_loadu_ps(p); }
+	void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline f32x8 operator+ (f32x8 a, f32x8 b) { return _mm256_add_ps(a.v, b.v); }
+inline f32x8 operator- (f32x8 a, f32x8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline f32x8 operator* (f32x8 a, f32x8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline f32x8 operator/ (f32x8 a, f32x8 b) { return _mm256_div_ps(a.v, b.v); }
+
+/// Rounds to the nearest integer.
+inline f32x8 round(f32x8 a) { return _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+#ifdef GAMMA_SIMD_AVX2
+
+/// Eight packed 32 bit signed integers. See i32x4 for the semantics of the
+/// operations.
+struct i32x8
+{
+	typedef int32_t scalar_type;
+	typedef f32x8 float_type;
+	const static int size = 8;
+
+	typedef __m256i native_type;
+	native_type v;
+	i32x8() {}
+	i32x8(native_type v) : v(v) {}
+	explicit i32x8(int32_t h) : v(_mm256_set1_epi32(h)) {}
+	static i32x8 load(const int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	void store(int32_t* p) const { _mm256_storeu_si256((__m256i*)p, v); }
+};
+
+inline i32x8 operator+ (i32x8 a, i32x8 b) { return _mm256_add_epi32(a.v, b.v); }
+inline i32x8 operator- (i32x8 a, i32x8 b) { return _mm256_sub_epi32(a.v, b.v); }
+
+template <int D> inline i32x8 mulshift(i32x8 a, i32x8 b) {
+	__m256i neg = _mm256_srai_epi32(_mm256_xor_si256(a.v, b.v), 31);
+	__m256i x = _mm256_abs_epi32(a.v), y = _mm256_abs_epi32(b.v);
+	__m256i p02 = _mm256_srli_epi64(_mm256_mul_epu32(x, y), D);
+	__m256i p13 = _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32)), 32 - D);
+	__m256i q = _mm256_blend_epi32(p02, p13, 0xaa);
+	return _mm256_sub_epi32(_mm256_xor_si256(q, neg), neg);
+}
+
+inline f32x8 to_float(i32x8 a) { return _mm256_cvtepi32_ps(a.v); }
+inline i32x8 to_int_trunc(f32x8 a) { return _mm256_cvttps_epi32(a.v); }
+
+#endif // GAMMA_SIMD_AVX2
+
+#endif // GAMMA_SIMD_AVX
+
+#ifdef GAMMA_SIMD_DOUBLE
+
+/// Four packed doubles. Held in a single AVX register if available, or split
+/// across two SSE2/NEON registers otherwise.
+struct f64x4
+{
+	typedef double scalar_type;
+	const static int size = 4;
+
+#if defined(GAMMA_SIMD_AVX)
+	typedef __m256d native_type;
+	native_type v;
+	f64x4() {}
+	f64x4(native_type v) : v(v) {}
+	explicit f64x4(double h) : v(_mm256_set1_pd(h)) {}
+	static f64x4 load(const double* p) { return _mm256_loadu_pd(p); }
+	void store(double* p) const { _mm256_storeu_pd(p, v); }
+#elif defined(GAMMA_SIMD_SSE2)
+	typedef __m128d native_type;
+	native_type lo, hi;
+	f64x4() {}
+	f64x4(native_type lo, native_type hi) : lo(lo), hi(hi) {}
+	explicit f64x4(double h) : lo(_mm_set1_pd(h)), hi(lo) {}
+	static f64x4 load(const double* p) { return f64x4(_mm_loadu_pd(p), _mm_loadu_pd(p+2)); }
+	void store(double* p) const { _mm_storeu_pd(p, lo); _mm_storeu_pd(p+2, hi); }
+#elif defined(GAMMA_SIMD_NEON)
+	typedef float64x2_t native_type;
+	native_type lo, hi;
+	f64x4() {}
+	f64x4(native_type lo, native_type hi) : lo(lo), hi(hi) {}
+	explicit f64x4(double h) : lo(vdupq_n_f64(h)), hi(lo) {}
+	static f64x4 load(const double* p) { return f64x4(vld1q_f64(p), vld1q_f64(p+2)); }
+	void store(double* p) const { vst1q_f64(p, lo); vst1q_f64(p+2, hi); }
+#endif
+};
+
+#if defined(GAMMA_SIMD_AVX)
+inline f64x4 operator+ (f64x4 a, f64x4 b) { return _mm256_add_pd(a.v, b.v); }
+inline f64x4 operator- (f64x4 a, f64x4 b) { return _mm256_sub_pd(a.v, b.v); }
+inline f64x4 operator* (f64x4 a, f64x4 b) { return _mm256_mul_pd(a.v, b.v); }
+inline f64x4 operator/ (f64x4 a, f64x4 b) { return _mm256_div_pd(a.v, b.v); }
+inline f64x4 abs(f64x4 a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v); }
+inline f64x4 mulsign(f64x4 a, f64x4 s) { return _mm256_xor_pd(a.v, _mm256_and_pd(s.v, _mm256_set1_pd(-0.0))); }
+inline f64x4 min(f64x4 a, f64x4 b) { return _mm256_min_pd(a.v, b.v); }
+inline f64x4 sqrt(f64x4 a) { return _mm256_sqrt_pd(a.v); }
+inline int signmask(f64x4 a) { return _mm256_movemask_pd(a.v); }
+#elif defined(GAMMA_SIMD_SSE2)
+inline f64x4 operator+ (f64x4 a, f64x4 b) { return f64x4(_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)); }
+inline f64x4 operator- (f64x4 a, f64x4 b) { return f64x4(_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)); }
+inline f64x4 operator* (f64x4 a, f64x4 b) { return f64x4(_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)); }
+inline f64x4 operator/ (f64x4 a, f64x4 b) { return f64x4(_mm_div_pd(a.lo, b.lo), _mm_div_pd(a.hi, b.hi)); }
+inline f64x4 abs(f64x4 a) { const __m128d m = _mm_set1_pd(-0.0); return f64x4(_mm_andnot_pd(m, a.lo), _mm_andnot_pd(m, a.hi)); }
+inline f64x4 mulsign(f64x4 a, f64x4 s) {
+	const __m128d m = _mm_set1_pd(-0.0);
+	return f64x4(_mm_xor_pd(a.lo, _mm_and_pd(s.lo, m)), _mm_xor_pd(a.hi, _mm_and_pd(s.hi, m)));
+}
+inline f64x4 min(f64x4 a, f64x4 b) { return f64x4(_mm_min_pd(a.lo, b.lo), _mm_min_pd(a.hi, b.hi)); }
+inline f64x4 sqrt(f64x4 a) { return f64x4(_mm_sqrt_pd(a.lo), _mm_sqrt_pd(a.hi)); }
+inline int signmask(f64x4 a) { return _mm_movemask_pd(a.lo) | _mm_movemask_pd(a.hi) << 2; }
+#elif defined(GAMMA_SIMD_NEON)
+inline f64x4 operator+ (f64x4 a, f64x4 b) { return f64x4(vaddq_f64(a.lo, b.lo), vaddq_f64(a.hi, b.hi)); }
+inline f64x4 operator- (f64x4 a, f64x4 b) { return f64x4(vsubq_f64(a.lo, b.lo), vsubq_f64(a.hi, b.hi)); }
+inline f64x4 operator* (f64x4 a, f64x4 b) { return f64x4(vmulq_f64(a.lo, b.lo), vmulq_f64(a.hi, b.hi)); }
+inline f64x4 operator/ (f64x4 a, f64x4 b) { return f64x4(vdivq_f64(a.lo, b.lo), vdivq_f64(a.hi, b.hi)); }
+inline f64x4 abs(f64x4 a) { return f64x4(vabsq_f64(a.lo), vabsq_f64(a.hi)); }
+namespace detail {
+	inline float64x2_t mulsign(float64x2_t a, float64x2_t s) {
+		uint64x2_t m = vandq_u64(vreinterpretq_u64_f64(s), vdupq_n_u64(0x8000000000000000ull));
+		return vreinterpretq_f64_u64(veorq_u64(vreinterpretq_u64_f64(a), m));
+	}
+}
+inline f64x4 mulsign(f64x4 a, f64x4 s) { return f64x4(detail::mulsign(a.lo, s.lo), detail::mulsign(a.hi, s.hi)); }
+inline f64x4 min(f64x4 a, f64x4 b) { return f64x4(vminq_f64(a.lo, b.lo), vminq_f64(a.hi, b.hi)); }
+inline f64x4 sqrt(f64x4 a) { return f64x4(vsqrtq_f64(a.lo), vsqrtq_f64(a.hi)); }
+inline int signmask(f64x4 a) {
+	return (int)(vgetq_lane_u64(vreinterpretq_u64_f64(a.lo), 0) >> 63)
+		| (int)(vgetq_lane_u64(vreinterpretq_u64_f64(a.lo), 1) >> 63) << 1
+		| (int)(vgetq_lane_u64(vreinterpretq_u64_f64(a.hi), 0) >> 63) << 2
+		| (int)(vgetq_lane_u64(vreinterpretq_u64_f64(a.hi), 1) >> 63) << 3;
+}
+#endif
+
+// The shuffles on packed doubles operate on pairs of two-lane halves. Lane i
+// of a pack lives in half i/2 at position i%2.
+#if defined(GAMMA_SIMD_AVX)
+/// Returns (a[i0], a[i1], b[i2], b[i3]). Gathers the halves holding lanes
+/// i0/i2 and i1/i3 into two registers, then selects within each half.
+template <int i0, int i1, int i2, int i3> inline f64x4 shuffle(f64x4 a, f64x4 b) {
+	__m256d x = _mm256_permute2f128_pd(a.v, b.v, (i0/2) | (2 + i2/2) << 4);
+	__m256d y = _mm256_permute2f128_pd(a.v, b.v, (i1/2) | (2 + i3/2) << 4);
+	return _mm256_shuffle_pd(x, y, (i0%2) | (i1%2) << 1 | (i2%2) << 2 | (i3%2) << 3);
+}
+#elif defined(GAMMA_SIMD_SSE2)
+namespace detail {
+	template <int i0, int i1> inline __m128d pick(const f64x4& a) { return _mm_shuffle_pd(i0/2 ? a.hi : a.lo, i1/2 ? a.hi : a.lo, (i0%2) | (i1%2) << 1); }
+}
+/// Returns (a[i0], a[i1], b[i2], b[i3]).
+template <int i0, int i1, int i2, int i3> inline f64x4 shuffle(f64x4 a, f64x4 b) { return f64x4(detail::pick<i0,i1>(a), detail::pick<i2,i3>(b)); }
+#elif defined(GAMMA_SIMD_NEON)
+namespace detail {
+	template <int i0, int i1> inline float64x2_t pick(const f64x4& a) {
+		float64x2_t x = i0/2 ? a.hi : a.lo, y = i1/2 ? a.hi : a.lo;
+	#if defined(__clang__)
+		return __builtin_shufflevector(x, y, i0%2, i1%2+2);
+	#else
+		const uint64x2_t mask = {i0%2, i1%2+2};
+		return __builtin_shuffle(x, y, mask);
+	#endif
+	}
+}
+/// Returns (a[i0], a[i1], b[i2], b[i3]).
+template <int i0, int i1, int i2, int i3> inline f64x4 shuffle(f64x4 a, f64x4 b) { return f64x4(detail::pick<i0,i1>(a), detail::pick<i2,i3>(b)); }
+#endif
+
+#endif // GAMMA_SIMD_DOUBLE
+
+/// The widest pack available for a scalar type, used by the streaming kernels
+/// that operate on arrays of values. Only defined for float, double and
+/// int32_t, and only if the corresponding SIMD support is present.
+template <typename T> struct widest {};
+#if defined(GAMMA_SIMD_AVX)
+template <> struct widest<float> { typedef f32x8 type; };
+#elif defined(GAMMA_SIMD)
+template <> struct widest<float> { typedef f32x4 type; };
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+template <> struct widest<double> { typedef f64x4 type; };
+#endif
+#if defined(GAMMA_SIMD_AVX2)
+template <> struct widest<int32_t> { typedef i32x8 type; };
+#elif defined(GAMMA_SIMD)
+template <> struct widest<int32_t> { typedef i32x4 type; };
+#endif
+
+/// Fused multiply-adds: fmadd returns a*b + c, fmsub a*b - c and fnmadd
+/// c - a*b. With GAMMA_SIMD_FMA they are computed with a single rounding,
+/// otherwise as a separate product and sum.
+#ifdef GAMMA_SIMD
+#if defined(GAMMA_SIMD_FMA) && defined(GAMMA_SIMD_SSE2)
+inline f32x4 fmadd(f32x4 a, f32x4 b, f32x4 c) { return _mm_fmadd_ps(a.v, b.v, c.v); }
+inline f32x4 fmsub(f32x4 a, f32x4 b, f32x4 c) { return _mm_fmsub_ps(a.v, b.v, c.v); }
+inline f32x4 fnmadd(f32x4 a, f32x4 b, f32x4 c) { return _mm_fnmadd_ps(a.v, b.v, c.v); }
+#elif defined(GAMMA_SIMD_FMA) && defined(GAMMA_SIMD_NEON)
+inline f32x4 fmadd(f32x4 a, f32x4 b, f32x4 c) { return vfmaq_f32(c.v, a.v, b.v); }
+inline f32x4 fmsub(f32x4 a, f32x4 b, f32x4 c) { return vnegq_f32(vfmsq_f32(c.v, a.v, b.v)); }
+inline f32x4 fnmadd(f32x4 a, f32x4 b, f32x4 c) { return vfmsq_f32(c.v, a.v, b.v); }
+#else
+inline f32x4 fmadd(f32x4 a, f32x4 b, f32x4 c) { return a * b + c; }
+inline f32x4 fmsub(f32x4 a, f32x4 b, f32x4 c) { return a * b - c; }
+inline f32x4 fnmadd(f32x4 a, f32x4 b, f32x4 c) { return c - a * b; }
+#endif
+#endif
+#ifdef GAMMA_SIMD_AVX
+#if defined(GAMMA_SIMD_FMA)
+inline f32x8 fmadd(f32x8 a, f32x8 b, f32x8 c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+inline f32x8 fmsub(f32x8 a, f32x8 b, f32x8 c) { return _mm256_fmsub_ps(a.v, b.v, c.v); }
+inline f32x8 fnmadd(f32x8 a, f32x8 b, f32x8 c) { return _mm256_fnmadd_ps(a.v, b.v, c.v); }
+#else
+inline f32x8 fmadd(f32x8 a, f32x8 b, f32x8 c) { return a * b + c; }
+inline f32x8 fmsub(f32x8 a, f32x8 b, f32x8 c) { return a * b - c; }
+inline f32x8 fnmadd(f32x8 a, f32x8 b, f32x8 c) { return c - a * b; }
+#endif
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+#if defined(GAMMA_SIMD_FMA) && defined(GAMMA_SIMD_AVX)
+inline f64x4 fmadd(f64x4 a, f64x4 b, f64x4 c) { return _mm256_fmadd_pd(a.v, b.v, c.v); }
+inline f64x4 fmsub(f64x4 a, f64x4 b, f64x4 c) { return _mm256_fmsub_pd(a.v, b.v, c.v); }
+inline f64x4 fnmadd(f64x4 a, f64x4 b, f64x4 c) { return _mm256_fnmadd_pd(a.v, b.v, c.v); }
+#elif defined(GAMMA_SIMD_FMA) && defined(GAMMA_SIMD_NEON)
+inline f64x4 fmadd(f64x4 a, f64x4 b, f64x4 c) { return f64x4(vfmaq_f64(c.lo, a.lo, b.lo), vfmaq_f64(c.hi, a.hi, b.hi)); }
+inline f64x4 fmsub(f64x4 a, f64x4 b, f64x4 c) { return f64x4(vnegq_f64(vfmsq_f64(c.lo, a.lo, b.lo)), vnegq_f64(vfmsq_f64(c.hi, a.hi, b.hi))); }
+inline f64x4 fnmadd(f64x4 a, f64x4 b, f64x4 c) { return f64x4(vfmsq_f64(c.lo, a.lo, b.lo), vfmsq_f64(c.hi, a.hi, b.hi)); }
+#else
+inline f64x4 fmadd(f64x4 a, f64x4 b, f64x4 c) { return a * b + c; }
+inline f64x4 fmsub(f64x4 a, f64x4 b, f64x4 c) { return a * b - c; }
+inline f64x4 fnmadd(f64x4 a, f64x4 b, f64x4 c) { return c - a * b; }
+#endif
+#endif
+
+/// Multiplies two column-major 4x4 matrices a and b, storing the result in r.
+/// Each column of r is accumulated as a linear combination of the columns of
+/// a, which performs the exact same sequence of multiplications and additions
+/// per element as the scalar operator* in matrix.hpp.
+template <typename P> inline void mul_matrix4(
+	const typename P::scalar_type* a,
+	const typename P::scalar_type* b,
+	typename P::scalar_type* r)
+{
+	typedef typename P::scalar_type T;
+	P c0 = P::load(a), c1 = P::load(a+4), c2 = P::load(a+8), c3 = P::load(a+12);
+	for (int j = 0; j < 4; ++j) {
+		const T* bj = b + 4*j;
+		(c0*P(bj[0]) + c1*P(bj[1]) + c2*P(bj[2]) + c3*P(bj[3])).store(r + 4*j);
+	}
+}
+
+/// Multiplies the column-major 4x4 matrix a with the column vector b, storing
+/// the result in r.
+template <typename P> inline void mul_matrix4_vector4(
+	const typename P::scalar_type* a,
+	const typename P::scalar_type* b,
+	typename P::scalar_type* r)
+{
+	(P::load(a)*P(b[0]) + P::load(a+4)*P(b[1]) + P::load(a+8)*P(b[2]) + P::load(a+12)*P(b[3])).store(r);
+}
+
+#ifdef GAMMA_SIMD
+
+/// Returns (a[i0], a[i1], a[i2], a[i3]).
+template <int i0, int i1, int i2, int i3, typename P> inline P swizzle(P a) { return shuffle<i0,i1,i2,i3>(a, a); }
+
+/// Returns the sum of all four lanes of a, broadcast to every lane.
+template <typename P> inline P hsum(P a)
+{
+	a = a + swizzle<1,0,3,2>(a);
+	return a + swizzle<2,3,0,1>(a);
+}
+
+/// Transposes the 4x4 matrix whose rows (or columns) are r0 to r3 in place.
+template <typename P> inline void transpose4(P& r0, P& r1, P& r2, P& r3)
+{
+	P t0 = shuffle<0,1,0,1>(r0, r1), t1 = shuffle<2,3,2,3>(r0, r1);
+	P t2 = shuffle<0,1,0,1>(r2, r3), t3 = shuffle<2,3,2,3>(r2, r3);
+	r0 = shuffle<0,2,0,2>(t0, t2);
+	r1 = shuffle<1,3,1,3>(t0, t2);
+	r2 = shuffle<0,2,0,2>(t1, t3);
+	r3 = shuffle<1,3,1,3>(t1, t3);
+}
+
+/// Returns the cross product of the first three lanes of a and b. The fourth
+/// lane is zero for finite inputs.
+template <typename P> inline P cross3(P a, P b)
+{
+	return swizzle<1,2,0,3>(a) * swizzle<2,0,1,3>(b) - swizzle<2,0,1,3>(a) * swizzle<1,2,0,3>(b);
+}
+
+// Helpers for the inverse below, operating on 2x2 matrices packed into a
+// single register as (m00, m01, m10, m11). A# denotes the adjugate of A.
+namespace detail {
+	/// A*B
+	template <typename P> inline P mat2_mul(P a, P b) { return a * swizzle<0,3,0,3>(b) + swizzle<1,0,3,2>(a) * swizzle<2,1,2,1>(b); }
+	/// A#*B
+	template <typename P> inline P mat2_adj_mul(P a, P b) { return swizzle<3,3,0,0>(a) * b - swizzle<1,1,2,2>(a) * swizzle<2,3,0,1>(b); }
+	/// A*B#
+	template <typename P> inline P mat2_mul_adj(P a, P b) { return a * swizzle<3,0,3,0>(b) - swizzle<1,0,3,2>(a) * swizzle<2,1,2,1>(b); }
+}
+
+/// Inverts the 4x4 matrix a, storing the result in r. Uses the block-wise
+/// inversion formula on the four 2x2 sub-matrices. The algorithm is derived
+/// for row-major storage; since inv(A^T) = inv(A)^T, it works unchanged on
+/// column-major matrices.
+template <typename P> inline void inverse_matrix4(const typename P::scalar_type* a, typename P::scalar_type* r)
+{
+	using namespace detail;
+	typedef typename P::scalar_type T;
+	P r0 = P::load(a), r1 = P::load(a+4), r2 = P::load(a+8), r3 = P::load(a+12);
+
+	// Sub-matrices and their determinants.
+	P A = shuffle<0,1,0,1>(r0, r1);
+	P B = shuffle<2,3,2,3>(r0, r1);
+	P C = shuffle<0,1,0,1>(r2, r3);
+	P D = shuffle<2,3,2,3>(r2, r3);
+	P det_sub = shuffle<0,2,0,2>(r0, r2) * shuffle<1,3,1,3>(r1, r3) - shuffle<1,3,1,3>(r0, r2) * shuffle<0,2,0,2>(r1, r3);
+	P det_a = swizzle<0,0,0,0>(det_sub);
+	P det_b = swizzle<1,1,1,1>(det_sub);
+	P det_c = swizzle<2,2,2,2>(det_sub);
+	P det_d = swizzle<3,3,3,3>(det_sub);
+
+	// inv(M) = 1/|M| * [X Y; Z W]
+	P D_C = mat2_adj_mul(D, C);
+	P A_B = mat2_adj_mul(A, B);
+	P X = det_d * A - mat2_mul(B, D_C);
+	P W = det_a * D - mat2_mul(C, A_B);
+	P Y = det_b * C - mat2_mul_adj(D, A_B);
+	P Z = det_c * B - mat2_mul_adj(A, D_C);
+
+	// |M| = |A|*|D| + |B|*|C| - tr((A#B)(D#C))
+	P det = det_a * det_d + det_b * det_c - hsum(A_B * swizzle<0,2,1,3>(D_C));
+	const T sign[4] = {1, -1, -1, 1};
+	P rdet = P::load(sign) / det;
+	X = X * rdet; Y = Y * rdet; Z = Z * rdet; W = W * rdet;
+
+	// Undo the adjugate and store.
+	shuffle<3,1,3,1>(X, Y).store(r);
+	shuffle<2,0,2,0>(X, Y).store(r+4);
+	shuffle<3,1,3,1>(Z, W).store(r+8);
+	shuffle<2,0,2,0>(Z, W).store(r+12);
+}
+
+/// Inverts the column-major 4x4 affine matrix a, whose last row is assumed to
+/// be (0,0,0,1), storing the result in r. The upper 3x3 part is inverted via
+/// the cross products of its columns.
+template <typename P> inline void inverse_affine_matrix4(const typename P::scalar_type* a, typename P::scalar_type* r)
+{
+	typedef typename P::scalar_type T;
+	P c0 = P::load(a), c1 = P::load(a+4), c2 = P::load(a+8), c3 = P::load(a+12);
+
+	// The rows of the inverse 3x3 part are the cross products of the columns,
+	// divided by the determinant. Their fourth lane is zero.
+	P x0 = cross3(c1, c2), x1 = cross3(c2, c0), x2 = cross3(c0, c1), x3(T(0));
+	P rdet = P(T(1)) / hsum(c0 * x0);
+	x0 = x0 * rdet; x1 = x1 * rdet; x2 = x2 * rdet;
+	transpose4(x0, x1, x2, x3);
+
+	const T w[4] = {0, 0, 0, 1};
+	x0.store(r);
+	x1.store(r+4);
+	x2.store(r+8);
+	(P::load(w) - (x0 * swizzle<0,0,0,0>(c3) + x1 * swizzle<1,1,1,1>(c3) + x2 * swizzle<2,2,2,2>(c3))).store(r+12);
+}
+
+/// Inverts the column-major 4x4 matrix a, which is assumed to consist of an
+/// orthonormal rotation and a translation only, storing the result in r.
+template <typename P> inline void inverse_orthonormal_matrix4(const typename P::scalar_type* a, typename P::scalar_type* r)
+{
+	typedef typename P::scalar_type T;
+	P c0 = P::load(a), c1 = P::load(a+4), c2 = P::load(a+8), c3 = P::load(a+12);
+	P t = c3;
+
+	// Transpose the rotation. Zeroing the last column beforehand zeroes the
+	// fourth lane of the transposed columns.
+	c3 = P(T(0));
+	transpose4(c0, c1, c2, c3);
+
+	const T w[4] = {0, 0, 0, 1};
+	c0.store(r);
+	c1.store(r+4);
+	c2.store(r+8);
+	(P::load(w) - (c0 * swizzle<0,0,0,0>(t) + c1 * swizzle<1,1,1,1>(t) + c2 * swizzle<2,2,2,2>(t))).store(r+12);
+}
+
+/// Computes the sine and cosine of each lane of the float pack x. The angle
+/// is reduced to [-pi/4,pi/4] using a three-part Cody-Waite split of pi/2 and
+/// evaluated with the minimax polynomials of the Cephes library. The absolute
+/// error is below 1e-7 for |x| < 8192; beyond that the reduction loses
+/// precision. The quadrant selection is done with exact arithmetic on small
+/// integers held in floats, which avoids integer SIMD instructions.
+template <typename P> inline void sincos(P x, P& s, P& c)
+{
+	const P one(1.0f), half(0.5f), two(2.0f);
+
+	// Reduce x to r in [-pi/4,pi/4], x = r + j*pi/2.
+	P j = round(x * P(0.63661977236758134f));
+	P r = ((x - j * P(1.5703125f)) - j * P(4.837512969970703125e-4f)) - j * P(7.54978995489188216e-8f);
+
+	// Quadrant q = j mod 4 in [0,4), as o = q mod 2 and h = q div 2.
+	P q = j - P(4.0f) * round((j - P(1.5f)) * P(0.25f));
+	P h = round((q - half) * half);
+	P o = q - two * h;
+
+	P z = r * r;
+	P ps = ((P(-1.9515295891e-4f) * z + P(8.3321608736e-3f)) * z - P(1.6666654611e-1f)) * z * r + r;
+	P pc = ((P(2.443315711809948e-5f) * z - P(1.388731625493765e-3f)) * z + P(4.166664568298827e-2f)) * z * z - half * z + one;
+
+	// Quadrants 0 to 3 map to sin = (ps, pc, -ps, -pc), cos = (pc, -ps, -pc,
+	// ps). The selections multiply by exactly 0 or 1 and are thus exact.
+	P no = one - o;
+	s = (ps * no + pc * o) * (one - two * h);
+	c = (pc * no + ps * o) * (one - two * (o + h - two * o * h));
+}
+
+/// Approximates 1/sqrt(a) by refining rsqrt_estimate with one
+/// Newton-Raphson step. The relative error is below 2^-21.
+inline f32x4 rsqrt(f32x4 a)
+{
+	f32x4 y = rsqrt_estimate(a);
+	return y * (f32x4(1.5f) - f32x4(0.5f) * a * y * y);
+}
+
+#endif // GAMMA_SIMD
+
+} // namespace simd
+
+} // namespace gma
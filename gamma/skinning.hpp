@@ -0,0 +1,198 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/soa.hpp"
+#include "gamma/simd.hpp"
+#include "gamma/parallel.hpp"
+#include <cstddef>
+#define GAMMA_HAS_SKINNING
+
+namespace gma {
+
+/// Number of vertices per worker below which skin does not spawn any
+/// threads.
+const size_t skinning_grain = 8192;
+
+namespace detail {
+
+/// The streams of a skin call. Vertex i is influenced by the bones
+/// bones[i*K+k] with the weights weights[i*K+k], for k < K influences.
+template <typename T> struct skin_streams
+{
+	const matrix4<T>* palette;
+	const uint16_t* bones;
+	const T* weights;
+	const T *x, *y, *z, *nx, *ny, *nz;
+	T *ox, *oy, *oz, *onx, *ony, *onz;
+};
+
+/// Blends the affine parts of the K bone matrices of vertex i by their
+/// weights, and applies the result to the position and, if normals is set,
+/// to the normal. The order of operations matches skin_simd, apart from
+/// fused multiply-adds.
+template <int K, bool normals, typename T> inline size_t skin_scalar(const skin_streams<T>& s, size_t i, size_t n)
+{
+	for (; i < n; ++i) {
+		const uint16_t* b = s.bones + i*K;
+		const T* w = s.weights + i*K;
+		T m[12];
+		const T* p = s.palette[b[0]].v;
+		for (int j = 0; j < 12; ++j) m[j] = p[j + j/3] * w[0];
+		for (int k = 1; k < K; ++k) {
+			p = s.palette[b[k]].v;
+			for (int j = 0; j < 12; ++j) m[j] = p[j + j/3] * w[k] + m[j];
+		}
+		// m holds the columns without their last rows: m[3*c+r] = m_rc.
+		T vx = s.x[i], vy = s.y[i], vz = s.z[i];
+		s.ox[i] = m[0]*vx + (m[3]*vy + (m[6]*vz + m[9]));
+		s.oy[i] = m[1]*vx + (m[4]*vy + (m[7]*vz + m[10]));
+		s.oz[i] = m[2]*vx + (m[5]*vy + (m[8]*vz + m[11]));
+		if (normals) {
+			vx = s.nx[i]; vy = s.ny[i]; vz = s.nz[i];
+			s.onx[i] = m[0]*vx + (m[3]*vy + m[6]*vz);
+			s.ony[i] = m[1]*vx + (m[4]*vy + m[7]*vz);
+			s.onz[i] = m[2]*vx + (m[5]*vy + m[8]*vz);
+		}
+	}
+	return i;
+}
+
+#ifdef GAMMA_SIMD
+/// Skins four vertices at a time. The blended matrix of each vertex is kept
+/// as four column packs, such that a position is a sum of columns scaled by
+/// its components. The four results are transposed into component packs.
+template <int K, bool normals, typename P> inline size_t skin_simd(const skin_streams<typename P::scalar_type>& s, size_t i, size_t n)
+{
+	typedef typename P::scalar_type T;
+	for (; i + 4 <= n; i += 4) {
+		P r[4], q[4];
+		for (int v = 0; v < 4; ++v) {
+			const size_t j = i + v;
+			const uint16_t* b = s.bones + j*K;
+			const T* w = s.weights + j*K;
+			const T* p = s.palette[b[0]].v;
+			P wk(w[0]);
+			P c0 = P::load(p) * wk, c1 = P::load(p+4) * wk, c2 = P::load(p+8) * wk, c3 = P::load(p+12) * wk;
+			for (int k = 1; k < K; ++k) {
+				p = s.palette[b[k]].v;
+				wk = P(w[k]);
+				c0 = simd::fmadd(P::load(p), wk, c0);
+				c1 = simd::fmadd(P::load(p+4), wk, c1);
+				c2 = simd::fmadd(P::load(p+8), wk, c2);
+				c3 = simd::fmadd(P::load(p+12), wk, c3);
+			}
+			r[v] = simd::fmadd(c0, P(s.x[j]), simd::fmadd(c1, P(s.y[j]), simd::fmadd(c2, P(s.z[j]), c3)));
+			if (normals)
+				q[v] = simd::fmadd(c0, P(s.nx[j]), simd::fmadd(c1, P(s.ny[j]), c2 * P(s.nz[j])));
+		}
+		simd::transpose4(r[0], r[1], r[2], r[3]);
+		r[0].store(s.ox+i); r[1].store(s.oy+i); r[2].store(s.oz+i);
+		if (normals) {
+			simd::transpose4(q[0], q[1], q[2], q[3]);
+			q[0].store(s.onx+i); q[1].store(s.ony+i); q[2].store(s.onz+i);
+		}
+	}
+	return i;
+}
+#endif
+
+template <int K, bool normals, typename T> inline void skin_range(const skin_streams<T>& s, size_t begin, size_t end)
+{
+	skin_scalar<K, normals>(s, begin, end);
+}
+
+#ifdef GAMMA_SIMD
+template <int K, bool normals> inline void skin_range(const skin_streams<float>& s, size_t begin, size_t end)
+{
+	skin_scalar<K, normals>(s, skin_simd<K, normals, simd::f32x4>(s, begin, end), end);
+}
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+template <int K, bool normals> inline void skin_range(const skin_streams<double>& s, size_t begin, size_t end)
+{
+	skin_scalar<K, normals>(s, skin_simd<K, normals, simd::f64x4>(s, begin, end), end);
+}
+#endif
+
+template <typename T> struct skin_kernel
+{
+	skin_streams<T> s;
+	int influences;
+
+	void operator() (size_t begin, size_t end, unsigned) const
+	{
+		switch (influences) {
+			case 1: run<1>(begin, end); break;
+			case 2: run<2>(begin, end); break;
+			case 3: run<3>(begin, end); break;
+			default: run<4>(begin, end); break;
+		}
+	}
+
+	/// Decides on the normals once per range rather than per vertex.
+	template <int K> void run(size_t begin, size_t end) const
+	{
+		if (s.nx)
+			skin_range<K, true>(s, begin, end);
+		else
+			skin_range<K, false>(s, begin, end);
+	}
+};
+
+} // namespace detail
+
+/// Applies linear blend skinning to n vertices given as component streams.
+/// Vertex i is influenced by the bones at bones[i*influences+k] with the
+/// weights at weights[i*influences+k], for k < influences, which must be
+/// 1 to 4. Its matrix is the weighted sum of the bone matrices in palette,
+/// which are expected to be affine, and is applied to the position (x, y,
+/// z) and, unless nx is null, to the normal (nx, ny, nz). The weights are
+/// used as given; they normally sum to one. The normals are not
+/// renormalized, and are only correct for bones without non-uniform scale.
+///
+/// For float and double, four vertices are skinned at a time in SIMD packs.
+/// Each worker streams once over a contiguous range of vertices, while the
+/// palette stays in cache. Large meshes are split across max_workers
+/// threads, see parallel_for. The output streams must not alias the inputs.
+template <typename T> void skin(
+	const matrix4<T>* palette, size_t n, int influences,
+	const uint16_t* bones, const T* weights,
+	const T* x, const T* y, const T* z, T* ox, T* oy, T* oz,
+	const T* nx = 0, const T* ny = 0, const T* nz = 0, T* onx = 0, T* ony = 0, T* onz = 0,
+	unsigned max_workers = 0)
+{
+	detail::skin_kernel<T> k;
+	k.influences = influences;
+	k.s.palette = palette;
+	k.s.bones = bones;
+	k.s.weights = weights;
+	k.s.x = x; k.s.y = y; k.s.z = z;
+	k.s.ox = ox; k.s.oy = oy; k.s.oz = oz;
+	k.s.nx = nx; k.s.ny = ny; k.s.nz = nz;
+	k.s.onx = onx; k.s.ony = ony; k.s.onz = onz;
+	parallel_for(n, skinning_grain, k, max_workers);
+}
+
+/// Skins the positions in p into op, as above.
+template <typename T> void skin(const matrix4<T>* palette, int influences, const uint16_t* bones, const T* weights,
+	const soa3<T>& p, soa3<T>& op, unsigned max_workers = 0)
+{
+	op.resize(p.size());
+	skin(palette, p.size(), influences, bones, weights,
+		p.x.data(), p.y.data(), p.z.data(), op.x.data(), op.y.data(), op.z.data(),
+		(const T*)0, (const T*)0, (const T*)0, (T*)0, (T*)0, (T*)0, max_workers);
+}
+
+/// Skins the positions in p and normals in nrm into op and onrm, as above.
+template <typename T> void skin(const matrix4<T>* palette, int influences, const uint16_t* bones, const T* weights,
+	const soa3<T>& p, const soa3<T>& nrm, soa3<T>& op, soa3<T>& onrm, unsigned max_workers = 0)
+{
+	op.resize(p.size());
+	onrm.resize(p.size());
+	skin(palette, p.size(), influences, bones, weights,
+		p.x.data(), p.y.data(), p.z.data(), op.x.data(), op.y.data(), op.z.data(),
+		nrm.x.data(), nrm.y.data(), nrm.z.data(), onrm.x.data(), onrm.y.data(), onrm.z.data(), max_workers);
+}
+
+} // namespace gma
@@ -0,0 +1,156 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/vector.hpp"
+#include "gamma/matrix.hpp"
+#include "gamma/simd.hpp"
+#include <vector>
+#include <cstddef>
+#define GAMMA_HAS_SOA
+
+namespace gma {
+
+/// An array of three-dimensional vectors, stored as separate streams of x, y
+/// and z components (structure of arrays). Use this layout for bulk
+/// operations such as transforming a mesh, where it allows every SIMD lane to
+/// do useful work.
+template <typename T> struct soa3
+{
+	typedef T scalar_type;
+	typedef vector3<T> vector_type;
+	typedef soa3<T> self;
+
+	std::vector<T> x, y, z;
+
+	soa3() {}
+	explicit soa3(size_t n) : x(n), y(n), z(n) {}
+	explicit soa3(const vector_type* v, size_t n) { assign(v, n); }
+
+	size_t size() const { return x.size(); }
+	bool empty() const { return x.empty(); }
+	void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); }
+	void clear() { x.clear(); y.clear(); z.clear(); }
+
+	vector_type operator[] (size_t i) const { return vector_type(x[i], y[i], z[i]); }
+	void set(size_t i, const vector_type& v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+	void push_back(const vector_type& v) { x.push_back(v.x); y.push_back(v.y); z.push_back(v.z); }
+
+	/// Replaces the contents with the n vectors at v.
+	self& assign(const vector_type* v, size_t n) {
+		resize(n);
+		for (size_t i = 0; i < n; ++i) { x[i] = v[i].x; y[i] = v[i].y; z[i] = v[i].z; }
+		return *this;
+	}
+
+	/// Copies the contents to v, which must hold at least size() vectors.
+	void copy_to(vector_type* v) const {
+		const size_t n = size();
+		for (size_t i = 0; i < n; ++i) { v[i].x = x[i]; v[i].y = y[i]; v[i].z = z[i]; }
+	}
+};
+
+namespace detail {
+
+/// Applies m to n vectors given as separate component streams. If translate
+/// is set, the vectors are treated as points (w = 1), otherwise as directions
+/// (w = 0). Each output component is computed as m*vector4(x,y,z,w) would, in
+/// the same order of operations.
+template <bool translate, typename T> inline size_t transform_soa_scalar(
+	const matrix4<T>& m, size_t i, size_t n,
+	const T* x, const T* y, const T* z, T* ox, T* oy, T* oz)
+{
+	for (; i < n; ++i) {
+		T vx = x[i], vy = y[i], vz = z[i];
+		T rx = m.m00*vx + m.m01*vy + m.m02*vz;
+		T ry = m.m10*vx + m.m11*vy + m.m12*vz;
+		T rz = m.m20*vx + m.m21*vy + m.m22*vz;
+		if (translate) { rx = rx + m.m03; ry = ry + m.m13; rz = rz + m.m23; }
+		ox[i] = rx; oy[i] = ry; oz[i] = rz;
+	}
+	return i;
+}
+
+template <bool translate, typename P> inline size_t transform_soa_simd(
+	const matrix4<typename P::scalar_type>& m, size_t n,
+	const typename P::scalar_type* x, const typename P::scalar_type* y, const typename P::scalar_type* z,
+	typename P::scalar_type* ox, typename P::scalar_type* oy, typename P::scalar_type* oz)
+{
+	const P m00(m.m00), m01(m.m01), m02(m.m02), m03(m.m03);
+	const P m10(m.m10), m11(m.m11), m12(m.m12), m13(m.m13);
+	const P m20(m.m20), m21(m.m21), m22(m.m22), m23(m.m23);
+	size_t i = 0;
+	for (; i + P::size <= n; i += P::size) {
+		P vx = P::load(x+i), vy = P::load(y+i), vz = P::load(z+i);
+		P rx = m00*vx + m01*vy + m02*vz;
+		P ry = m10*vx + m11*vy + m12*vz;
+		P rz = m20*vx + m21*vy + m22*vz;
+		if (translate) { rx = rx + m03; ry = ry + m13; rz = rz + m23; }
+		rx.store(ox+i); ry.store(oy+i); rz.store(oz+i);
+	}
+	return i;
+}
+
+template <bool translate, typename T> inline void transform_soa(
+	const matrix4<T>& m, size_t n,
+	const T* x, const T* y, const T* z, T* ox, T* oy, T* oz)
+{
+	transform_soa_scalar<translate>(m, 0, n, x, y, z, ox, oy, oz);
+}
+
+#ifdef GAMMA_SIMD
+template <bool translate> inline void transform_soa(
+	const matrix4<float>& m, size_t n,
+	const float* x, const float* y, const float* z, float* ox, float* oy, float* oz)
+{
+	size_t i = transform_soa_simd<translate, simd::widest<float>::type>(m, n, x, y, z, ox, oy, oz);
+	transform_soa_scalar<translate>(m, i, n, x, y, z, ox, oy, oz);
+}
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+template <bool translate> inline void transform_soa(
+	const matrix4<double>& m, size_t n,
+	const double* x, const double* y, const double* z, double* ox, double* oy, double* oz)
+{
+	size_t i = transform_soa_simd<translate, simd::widest<double>::type>(m, n, x, y, z, ox, oy, oz);
+	transform_soa_scalar<translate>(m, i, n, x, y, z, ox, oy, oz);
+}
+#endif
+
+} // namespace detail
+
+/// Transforms n points (w = 1) given as component streams by the matrix m.
+/// The perspective division is not performed, i.e. m is expected to be an
+/// affine transformation. The output streams may alias the input streams.
+template <typename T> void transform_points(
+	const matrix4<T>& m, size_t n,
+	const T* x, const T* y, const T* z, T* ox, T* oy, T* oz)
+{
+	detail::transform_soa<true>(m, n, x, y, z, ox, oy, oz);
+}
+
+/// Transforms n directions (w = 0) given as component streams by the matrix
+/// m, ignoring its translation. The output streams may alias the input.
+template <typename T> void transform_directions(
+	const matrix4<T>& m, size_t n,
+	const T* x, const T* y, const T* z, T* ox, T* oy, T* oz)
+{
+	detail::transform_soa<false>(m, n, x, y, z, ox, oy, oz);
+}
+
+template <typename T> void transform_points(const matrix4<T>& m, const soa3<T>& in, soa3<T>& out)
+{
+	out.resize(in.size());
+	transform_points(m, in.size(), in.x.data(), in.y.data(), in.z.data(), out.x.data(), out.y.data(), out.z.data());
+}
+
+template <typename T> void transform_directions(const matrix4<T>& m, const soa3<T>& in, soa3<T>& out)
+{
+	out.resize(in.size());
+	transform_directions(m, in.size(), in.x.data(), in.y.data(), in.z.data(), out.x.data(), out.y.data(), out.z.data());
+}
+
+namespace convenience {
+	typedef soa3<int> soa3i;
+	typedef soa3<float> soa3f;
+	typedef soa3<double> soa3d;
+}
+} // namespace gma
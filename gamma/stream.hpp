@@ -1,14 +1,43 @@
 /* Copyright (c) 2013-2014 Fabian Schuiki */
 #pragma once
+#include "gamma/math.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
 #include <ostream>
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
 #define GAMMA_HAS_STREAM
 
+// Text input and output for the types of this library. operator<< and
+// operator>> go through the iostream machinery one scalar at a time, which
+// is convenient for debugging. For bulk dumps and exports, to_chars and
+// from_chars below format and parse arrays in caller buffers, an order of
+// magnitude faster. Both use the same text, the scalars in the order of
+// operator<<, hence either one reads what the other wrote.
+
+/// Whether std::to_chars and std::from_chars for floating point are
+/// available. Floats are then printed in the shortest form that parses back
+/// to the same value; otherwise with as many digits as needed for that.
+#if defined(__cpp_lib_to_chars)
+#define GAMMA_HAS_CHARCONV
+#endif
+
 namespace gma {
 
 #ifdef GAMMA_HAS_VECTOR
 template<typename T> std::ostream& operator<< (std::ostream& o, const vector2<T>& v) { o << v.x << ' ' << v.y; return o; }
 template<typename T> std::ostream& operator<< (std::ostream& o, const vector3<T>& v) { o << v.x << ' ' << v.y << ' ' << v.z; return o; }
 template<typename T> std::ostream& operator<< (std::ostream& o, const vector4<T>& v) { o << v.x << ' ' << v.y << ' ' << v.z << ' ' << v.w; return o; }
+
+template<typename T> std::istream& operator>> (std::istream& i, vector2<T>& v) { i >> v.x >> v.y; return i; }
+template<typename T> std::istream& operator>> (std::istream& i, vector3<T>& v) { i >> v.x >> v.y >> v.z; return i; }
+template<typename T> std::istream& operator>> (std::istream& i, vector4<T>& v) { i >> v.x >> v.y >> v.z >> v.w; return i; }
 #endif
 
 #ifdef GAMMA_HAS_MATRIX
@@ -27,18 +56,308 @@ template<typename T> std::ostream& operator<< (std::ostream& o, const matrix4<T>
 	o << m.m20 << ' ' << m.m21 << ' ' << m.m22 << ' ' << m.m23 << '\n';
 	o << m.m30 << ' ' << m.m31 << ' ' << m.m32 << ' ' << m.m33; return o;
 }
+
+template<typename T> std::istream& operator>> (std::istream& i, matrix2<T>& m) {
+	i >> m.m00 >> m.m01;
+	i >> m.m10 >> m.m11; return i;
+}
+template<typename T> std::istream& operator>> (std::istream& i, matrix3<T>& m) {
+	i >> m.m00 >> m.m01 >> m.m02;
+	i >> m.m10 >> m.m11 >> m.m12;
+	i >> m.m20 >> m.m21 >> m.m22; return i;
+}
+template<typename T> std::istream& operator>> (std::istream& i, matrix4<T>& m) {
+	i >> m.m00 >> m.m01 >> m.m02 >> m.m03;
+	i >> m.m10 >> m.m11 >> m.m12 >> m.m13;
+	i >> m.m20 >> m.m21 >> m.m22 >> m.m23;
+	i >> m.m30 >> m.m31 >> m.m32 >> m.m33; return i;
+}
 #endif
 
+namespace detail {
+/// Extracts the character c, after whitespace, or fails the stream.
+inline std::istream& expect(std::istream& i, char c) { char k; if (i >> k && k != c) i.setstate(std::ios::failbit); return i; }
+}
+
 #ifdef GAMMA_HAS_SPHERE
 template<typename T> std::ostream& operator<< (std::ostream& o, const sphere<T>& s) { o << '(' << s.c << ", " << s.r << ')'; return o; }
+template<typename T> std::istream& operator>> (std::istream& i, sphere<T>& s) {
+	detail::expect(i, '(') >> s.c;
+	detail::expect(i, ',') >> s.r;
+	return detail::expect(i, ')');
+}
 #endif
 
 #ifdef GAMMA_HAS_LINE
-template<typename T> std::ostream& operator<< (std::ostream& o, const line<T>& l) { o << '(' << s.p << ", " << s.d << ')'; return o; }
+template<typename T> std::ostream& operator<< (std::ostream& o, const line<T>& l) { o << '(' << l.p << ", " << l.d << ')'; return o; }
+template<typename T> std::istream& operator>> (std::istream& i, line<T>& l) {
+	detail::expect(i, '(') >> l.p;
+	detail::expect(i, ',') >> l.d;
+	return detail::expect(i, ')');
+}
 #endif
 
 #ifdef GAMMA_HAS_FIXED_POINT
 template<int Ia, int Ib> std::ostream& operator<< (std::ostream& o, fixed_point<Ia,Ib> f) { o << (double)f.v / f.factor; return o; }
+template<int Ia, int Ib> std::istream& operator>> (std::istream& i, fixed_point<Ia,Ib>& f) { double d; if (i >> d) f = d; return i; }
 #endif
 
+namespace detail {
+
+/// The scalars of V, in the order printed by operator<<, as size scalars of
+/// type scalar_type of which the k-th is at index(k) in memory. Matrices are
+/// printed row by row but stored column by column. max_chars bounds the
+/// length of a scalar in text.
+template<typename V> struct text_layout;
+
+#define GAMMA_TEXT_SCALAR(T, n) \
+template<> struct text_layout<T> { typedef T scalar_type; enum { size = 1, max_chars = n }; static size_t index(size_t k) { return k; } };
+GAMMA_TEXT_SCALAR(int8_t, 4)
+GAMMA_TEXT_SCALAR(int16_t, 6)
+GAMMA_TEXT_SCALAR(int32_t, 11)
+GAMMA_TEXT_SCALAR(int64_t, 20)
+GAMMA_TEXT_SCALAR(uint8_t, 3)
+GAMMA_TEXT_SCALAR(uint16_t, 5)
+GAMMA_TEXT_SCALAR(uint32_t, 10)
+GAMMA_TEXT_SCALAR(uint64_t, 20)
+GAMMA_TEXT_SCALAR(float, 15)
+GAMMA_TEXT_SCALAR(double, 24)
+#undef GAMMA_TEXT_SCALAR
+
+#ifdef GAMMA_HAS_FIXED_POINT
+template<int Ia, int Da> struct text_layout<fixed_point<Ia,Da> >
+{
+	typedef fixed_point<Ia,Da> scalar_type;
+	// Sign, point, Da fractional and at most 1 + (Ia-1)*log10(2) integer digits.
+	enum { size = 1, max_chars = 3 + Ia * 30103 / 100000 + Da };
+	static size_t index(size_t k) { return k; }
+};
+#endif
+
+#ifdef GAMMA_HAS_VECTOR
+template<typename V, int N> struct vector_text_layout
+{
+	typedef typename V::type scalar_type;
+	enum { size = N, max_chars = text_layout<scalar_type>::max_chars };
+	static size_t index(size_t k) { return k; }
+};
+template<typename T> struct text_layout<vector2<T> > : vector_text_layout<vector2<T>,2> {};
+template<typename T> struct text_layout<vector3<T> > : vector_text_layout<vector3<T>,3> {};
+template<typename T> struct text_layout<vector4<T> > : vector_text_layout<vector4<T>,4> {};
+#endif
+
+#ifdef GAMMA_HAS_MATRIX
+template<typename M, int N> struct matrix_text_layout
+{
+	typedef typename M::type scalar_type;
+	enum { size = N*N, max_chars = text_layout<scalar_type>::max_chars };
+	static size_t index(size_t k) { return k % N * N + k / N; }
+};
+template<typename T> struct text_layout<matrix2<T> > : matrix_text_layout<matrix2<T>,2> {};
+template<typename T> struct text_layout<matrix3<T> > : matrix_text_layout<matrix3<T>,3> {};
+template<typename T> struct text_layout<matrix4<T> > : matrix_text_layout<matrix4<T>,4> {};
+#endif
+
+inline bool is_separator(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ','; }
+
+/// Copies the n characters at s to first, or returns null if they do not fit.
+inline char* copy_chars(const char* s, int n, char* first, char* last)
+{
+	if (n < 0 || last - first < n) return 0;
+	memcpy(first, s, n);
+	return first + n;
+}
+
+#ifdef GAMMA_HAS_CHARCONV
+template<typename T> inline char* format_scalar(char* first, char* last, T v)
+{
+	std::to_chars_result r = std::to_chars(first, last, v);
+	return r.ec == std::errc() ? r.ptr : 0;
+}
+
+template<typename T> inline const char* parse_scalar(const char* first, const char* last, T& v)
+{
+	std::from_chars_result r = std::from_chars(first, last, v);
+	return r.ec == std::errc() ? r.ptr : 0;
+}
+#else
+template<typename T> inline char* format_scalar(char* first, char* last, T v)
+{
+	char s[32];
+	if (T(-1) < T(0))
+		return copy_chars(s, snprintf(s, sizeof(s), "%lld", (long long)v), first, last);
+	return copy_chars(s, snprintf(s, sizeof(s), "%llu", (unsigned long long)v), first, last);
+}
+inline char* format_scalar(char* first, char* last, float v) { char s[32]; return copy_chars(s, snprintf(s, sizeof(s), "%.9g", v), first, last); }
+inline char* format_scalar(char* first, char* last, double v) { char s[32]; return copy_chars(s, snprintf(s, sizeof(s), "%.17g", v), first, last); }
+
+/// Copies the scalar at first to s, which strtod and friends need terminated.
+inline const char* scalar_token(const char* first, const char* last, char (&s)[64])
+{
+	size_t n = 0;
+	while (first + n != last && !is_separator(first[n]) && n < sizeof(s) - 1)
+		s[n] = first[n], ++n;
+	s[n] = 0;
+	return n ? first + n : 0;
+}
+
+template<typename T> inline const char* parse_scalar(const char* first, const char* last, T& v)
+{
+	char s[64], *end;
+	const char* r = scalar_token(first, last, s);
+	if (!r || s[0] == '+') return 0;
+	if (T(-1) < T(0)) {
+		long long x = strtoll(s, &end, 10);
+		if (T(x) != x) return 0;
+		v = T(x);
+	} else {
+		unsigned long long x = strtoull(s, &end, 10);
+		if (s[0] == '-' || T(x) != x) return 0;
+		v = T(x);
+	}
+	return end == s ? 0 : first + (end - s);
+}
+inline const char* parse_scalar(const char* first, const char* last, double& v)
+{
+	char s[64], *end;
+	const char* r = scalar_token(first, last, s);
+	if (!r || s[0] == '+') return 0;
+	v = strtod(s, &end);
+	return end == s ? 0 : first + (end - s);
+}
+inline const char* parse_scalar(const char* first, const char* last, float& v)
+{
+	double d;
+	const char* r = parse_scalar(first, last, d);
+	if (r) v = (float)d;
+	return r;
+}
+#endif
+
+#ifdef GAMMA_HAS_FIXED_POINT
+/// Writes the exact decimal expansion of f, which ends after at most Da
+/// fractional digits, since the fraction is a multiple of 2^-Da.
+template<int Ia, int Da> inline char* format_scalar(char* first, char* last, fixed_point<Ia,Da> f)
+{
+	typedef typename integer::unsigned_integer<(Ia+Da > Da+4 ? Ia+Da : Da+4)>::type U;
+	const U mask = ((U)1 << Da) - 1;
+	U m = f.v < 0 ? 0 - (U)f.v : (U)f.v, ip = m >> Da, fp = m & mask;
+	char s[text_layout<fixed_point<Ia,Da> >::max_chars], digits[40];
+	int n = 0, k = 0;
+	do { digits[k++] = char('0' + ip % 10); ip /= 10; } while (ip);
+	if (f.v < 0) s[n++] = '-';
+	while (k) s[n++] = digits[--k];
+	if (fp) {
+		s[n++] = '.';
+		do { fp *= 10; s[n++] = char('0' + (int)(fp >> Da)); fp &= mask; } while (fp);
+	}
+	return copy_chars(s, n, first, last);
+}
+
+/// Parses a number in plain decimal notation, as written above, rounded to
+/// the nearest multiple of 2^-Da. The fraction is accumulated from its last
+/// digit on with G guard bits. As each step divides the error of the
+/// previous ones by ten, it stays below two units of the guard bits, such
+/// that exact expansions read back unchanged. Values out of range are
+/// rejected.
+template<int Ia, int Da> inline const char* parse_scalar(const char* first, const char* last, fixed_point<Ia,Da>& f)
+{
+	enum { G = 4 };
+	typedef typename integer::unsigned_integer<(Ia+Da > Da+G+4 ? Ia+Da : Da+G+4)>::type U;
+	const U limit = (U)1 << (Ia+Da-1), int_limit = limit >> Da;
+	const char* p = first;
+	bool negative = p != last && *p == '-';
+	if (negative) ++p;
+
+	const char* b = p;
+	U ip = 0;
+	for (; p != last && *p >= '0' && *p <= '9'; ++p) {
+		if (ip > int_limit / 10) return 0;
+		ip = ip * 10 + (U)(*p - '0');
+		if (ip > int_limit) return 0;
+	}
+	bool any = p != b;
+
+	U fp = 0;
+	if (p != last && *p == '.') {
+		b = ++p;
+		while (p != last && *p >= '0' && *p <= '9') ++p;
+		any = any || p != b;
+		for (const char* q = p; q != b; ) {
+			--q;
+			fp = (fp + ((U)(*q - '0') << (Da + G))) / 10;
+		}
+		fp = (fp + (1 << (G-1))) >> G;
+	}
+	if (!any) return 0;
+
+	U m = (ip << Da) + fp;
+	if (m > (negative ? limit : limit - 1)) return 0;
+	f.v = (typename fixed_point<Ia,Da>::value_type)(negative ? 0 - m : m);
+	return p;
+}
+#endif
+
+} // namespace detail
+
+/// Returns the number of characters to_chars needs at most for n values of
+/// type V, which may be a scalar, fixed_point, vector or matrix.
+template<typename V> size_t max_chars(size_t n = 1)
+{
+	typedef detail::text_layout<V> L;
+	return n * L::size * (L::max_chars + 1);
+}
+
+/// Writes the scalars of v to [first,last), separated by spaces. Returns the
+/// end of the text, or null if it does not fit.
+template<typename V> char* to_chars(char* first, char* last, const V& v)
+{
+	typedef detail::text_layout<V> L;
+	const typename L::scalar_type* s = (const typename L::scalar_type*)&v;
+	for (size_t k = 0; k < (size_t)L::size; ++k) {
+		if (k) {
+			if (first == last) return 0;
+			*first++ = ' ';
+		}
+		first = detail::format_scalar(first, last, s[L::index(k)]);
+		if (!first) return 0;
+	}
+	return first;
+}
+
+/// Writes the n values at v to [first,last), one per line. Returns the end
+/// of the text, or null if it does not fit; max_chars<V>(n) always does.
+template<typename V> char* to_chars(char* first, char* last, const V* v, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		first = to_chars(first, last, v[i]);
+		if (!first || first == last) return 0;
+		*first++ = '\n';
+	}
+	return first;
+}
+
+/// Parses the scalars of v from [first,last), skipping whitespace and commas
+/// before each. Returns the end of the last scalar, or null on malformed or
+/// out of range input, in which case v is partially assigned.
+template<typename V> const char* from_chars(const char* first, const char* last, V& v)
+{
+	typedef detail::text_layout<V> L;
+	typename L::scalar_type* s = (typename L::scalar_type*)&v;
+	for (size_t k = 0; k < (size_t)L::size; ++k) {
+		while (first != last && detail::is_separator(*first)) ++first;
+		first = detail::parse_scalar(first, last, s[L::index(k)]);
+		if (!first) return 0;
+	}
+	return first;
+}
+
+/// Parses n values into v from [first,last), as above.
+template<typename V> const char* from_chars(const char* first, const char* last, V* v, size_t n)
+{
+	for (size_t i = 0; i < n && first; ++i)
+		first = from_chars(first, last, v[i]);
+	return first;
+}
+
 } // namespace gma
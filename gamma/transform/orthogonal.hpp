@@ -18,30 +18,29 @@ template <typename T> struct orthogonal
 	const T bottom, top;
 	const T near, far;
 
-	orthogonal(): m(1) {}
-	orthogonal(T left, T right, T bottom, T top, T near, T far):
+	GAMMA_CONSTEXPR orthogonal():
+		left(-1),
+		right(1),
+		bottom(-1),
+		top(1),
+		near(1),
+		far(-1),
+		m(1) {}
+	GAMMA_CONSTEXPR orthogonal(T left, T right, T bottom, T top, T near, T far):
 		left(left),
 		right(right),
 		bottom(bottom),
 		top(top),
 		near(near),
-		far(far) {
-
-		T fx = 2 / (right-left);
-		T fy = 2 / (top-bottom);
-		T fz = 2 / (far-near);
-		T tx = -(right+left)/(right-left);
-		T ty = -(top+bottom)/(top-bottom);
-		T tz = -(far+near)/(far-near);
-		m = matrix_type(
-			fx,   0,    0,  tx,
-			 0,  fy,    0,  ty,
-			 0,   0,  -fz,  tz,
-			 0,   0,    0,   1
-		);
-	}
-
-	operator matrix_type() const { return m; }
+		far(far),
+		m(
+			2/(right-left),               0,              0, -(right+left)/(right-left),
+			             0,  2/(top-bottom),              0, -(top+bottom)/(top-bottom),
+			             0,               0, -2/(far-near), -(far+near)/(far-near),
+			             0,               0,              0,                          1
+		) {}
+
+	GAMMA_CONSTEXPR operator matrix_type() const { return m; }
 
 protected:
 	matrix_type m;
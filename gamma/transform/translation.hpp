@@ -17,18 +17,16 @@ template <typename T> struct translation
 
 	const vector_type v;
 
-	translation(): m(1) {}
-	translation(const vector_type& v): v(v)
-	{
-		m = matrix_type(
+	GAMMA_CONSTEXPR translation(): m(1) {}
+	GAMMA_CONSTEXPR translation(const vector_type& v): v(v),
+		m(
 			1,  0,  0,  v.x,
 			0,  1,  0,  v.y,
 			0,  0,  1,  v.z,
 			0,  0,  0,    1
-		);
-	}
+		) {}
 
-	operator matrix_type() const { return m; }
+	GAMMA_CONSTEXPR operator matrix_type() const { return m; }
 
 private:
 	matrix_type m;
@@ -36,11 +36,12 @@ template <typename T> struct x_rotation
 
 	self& update()
 	{
+		T c = cos(x), s = sin(x);
 		m = matrix_type(
-			1,      0,       0, 0,
-			0, cos(x), -sin(x), 0,
-			0, sin(x),  cos(x), 0,
-			0,      0,       0, 1);
+			T(1), T(0), T(0), T(0),
+			T(0),    c,   -s, T(0),
+			T(0),    s,    c, T(0),
+			T(0), T(0), T(0), T(1));
 		return *this;
 	}
 };
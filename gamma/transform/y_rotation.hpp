@@ -36,11 +36,12 @@ template <typename T> struct y_rotation
 
 	self& update()
 	{
+		T c = cos(y), s = sin(y);
 		m = matrix_type(
-			cos(y), 0, -sin(y), 0,
-			     0, 1,       0, 0,
-			sin(y), 0,  cos(y), 0,
-			     0, 0,       0, 1);
+			   c, T(0),   -s, T(0),
+			T(0), T(1), T(0), T(0),
+			   s, T(0),    c, T(0),
+			T(0), T(0), T(0), T(1));
 		return *this;
 	}
 };
@@ -38,11 +38,12 @@ template <typename T> struct z_rotation
 
 	self& update()
 	{
+		T c = cos(z), s = sin(z);
 		m = matrix_type(
-			cos(z), -sin(z), 0, 0,
-			sin(z),  cos(z), 0, 0,
-			     0,       0, 1, 0,
-			     0,       0, 0, 1);
+			   c,   -s, T(0), T(0),
+			   s,    c, T(0), T(0),
+			T(0), T(0), T(1), T(0),
+			T(0), T(0), T(0), T(1));
 		return *this;
 	}
 };
@@ -0,0 +1,106 @@
+/* Copyright (c) 2013-2014 Fabian Schuiki */
+#pragma once
+#include "gamma/math.hpp"
+#include "gamma/vector.hpp"
+#include "gamma/simd.hpp"
+#include <cstddef>
+#define GAMMA_HAS_VECTOR_BATCH
+
+// Bulk operations on arrays of vectors, such as the normals of a mesh. The
+// results are the same as applying the member functions of vector3 to each
+// element, apart from the rounding differences of fused multiply-adds the
+// compiler may introduce into the scalar code.
+
+namespace gma {
+namespace detail {
+
+template <bool fast, typename T> inline size_t normalize_scalar(size_t i, size_t n, const vector3<T>* v, vector3<T>* r)
+{
+	for (; i < n; ++i)
+		r[i] = fast ? v[i].normalized_fast() : v[i].normalized();
+	return i;
+}
+
+#ifdef GAMMA_SIMD
+/// The reciprocal square root as computed by rsqrt_fast, i.e. the refined
+/// estimate for float on SSE and the exact value otherwise.
+template <typename P> inline P inverse_sqrt(P a) { return P(1) / simd::sqrt(a); }
+#ifdef GAMMA_HAS_RSQRT_ESTIMATE
+inline simd::f32x4 inverse_sqrt(simd::f32x4 a) { return simd::rsqrt(a); }
+#endif
+
+/// Normalizes four vectors at a time. Their twelve components are loaded as
+/// three packs (x0 y0 z0 x1), (y1 z1 x2 y2) and (z2 x3 y3 z3), the squares
+/// are transposed to sum up the four lengths, which are then spread back
+/// over the three packs.
+template <bool fast, typename P> inline size_t normalize_simd(size_t n,
+	const vector3<typename P::scalar_type>* v, vector3<typename P::scalar_type>* r)
+{
+	typedef typename P::scalar_type T;
+	size_t i = 0, m = n & ~(size_t)3;
+	for (; i < m; i += 4) {
+		const T* p = &v[i].x;
+		P p0 = P::load(p), p1 = P::load(p+4), p2 = P::load(p+8);
+		P q0 = p0 * p0, q1 = p1 * p1, q2 = p2 * p2;
+		P t = simd::shuffle<2,3,0,1>(q1, q2);         // x2 y2 z2 x3
+		P u = simd::shuffle<1,2,0,1>(q0, q1);         // y0 z0 y1 z1
+		P w = simd::shuffle<1,2,2,3>(t, q2);          // y2 z2 y3 z3
+		P xx = simd::shuffle<0,3,0,3>(q0, t);
+		P yy = simd::shuffle<0,2,0,2>(u, w);
+		P zz = simd::shuffle<1,3,1,3>(u, w);
+		P l = xx + yy + zz;
+		if (fast) {
+			l = inverse_sqrt(l);
+			p0 = p0 * simd::shuffle<0,0,0,1>(l, l);
+			p1 = p1 * simd::shuffle<1,1,2,2>(l, l);
+			p2 = p2 * simd::shuffle<2,3,3,3>(l, l);
+		} else {
+			l = simd::sqrt(l);
+			p0 = p0 / simd::shuffle<0,0,0,1>(l, l);
+			p1 = p1 / simd::shuffle<1,1,2,2>(l, l);
+			p2 = p2 / simd::shuffle<2,3,3,3>(l, l);
+		}
+		T* o = &r[i].x;
+		p0.store(o); p1.store(o+4); p2.store(o+8);
+	}
+	return i;
+}
+#endif
+
+template <bool fast, typename T> inline void normalize(size_t n, const vector3<T>* v, vector3<T>* r)
+{
+	normalize_scalar<fast>(0, n, v, r);
+}
+
+#ifdef GAMMA_SIMD
+template <bool fast> inline void normalize(size_t n, const vector3<float>* v, vector3<float>* r)
+{
+	size_t i = normalize_simd<fast,simd::f32x4>(n, v, r);
+	normalize_scalar<fast>(i, n, v, r);
+}
+#endif
+#ifdef GAMMA_SIMD_DOUBLE
+template <bool fast> inline void normalize(size_t n, const vector3<double>* v, vector3<double>* r)
+{
+	size_t i = normalize_simd<fast,simd::f64x4>(n, v, r);
+	normalize_scalar<fast>(i, n, v, r);
+}
+#endif
+
+} // namespace detail
+
+/// Stores v[i].normalized() in r[i] for n vectors. r may be v. The result
+/// is undefined for vectors of zero length.
+template <typename T> void normalize(const vector3<T>* v, vector3<T>* r, size_t n)
+{
+	detail::normalize<false>(n, v, r);
+}
+
+/// Stores v[i].normalized_fast() in r[i] for n vectors. r may be v. For
+/// float on SSE the lengths have a relative error below 2^-21.
+template <typename T> void normalize_fast(const vector3<T>* v, vector3<T>* r, size_t n)
+{
+	detail::normalize<true>(n, v, r);
+}
+
+} // namespace gma
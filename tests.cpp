@@ -4,7 +4,10 @@
 #include "gamma/vector.hpp"
 #include "gamma/matrix.hpp"
 #include "gamma/fixed_point.hpp"
+#include "gamma/fixed_point_batch.hpp"
+#include "gamma/fixed_point_math.hpp"
 #include "gamma/transform/translation.hpp"
+#include "gamma/transform/orthogonal.hpp"
 #include "gamma/transform/x_rotation.hpp"
 #include "gamma/transform/y_rotation.hpp"
 #include "gamma/transform/z_rotation.hpp"
@@ -13,7 +16,24 @@
 #include "gamma/transform/orientation.hpp"
 #include "gamma/transform/lookat.hpp"
 #include "gamma/mvp.hpp"
+#include "gamma/mvp_batch.hpp"
+#include "gamma/soa.hpp"
+#include "gamma/quaternion.hpp"
+#include "gamma/frustum.hpp"
+#include "gamma/expression.hpp"
+#include "gamma/vector_batch.hpp"
+#include "gamma/bvh.hpp"
+#include "gamma/intersect_batch.hpp"
+#include "gamma/broad_phase.hpp"
+#include "gamma/aligned.hpp"
+#include "gamma/binary.hpp"
+#include "gamma/stream.hpp"
+#include "gamma/hierarchy.hpp"
+#include "gamma/skinning.hpp"
+#include "gamma/packed.hpp"
 #include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <stdexcept>
 
 using namespace gma::convenience;
 
@@ -143,3 +163,1308 @@ BOOST_AUTO_TEST_CASE(fixed_point_rounding)
 	BOOST_CHECK_EQUAL(a0.ceil().v, 0x200); BOOST_CHECK_EQUAL(a1.ceil().v, 0x200);	BOOST_CHECK_EQUAL(a2.ceil().v, 0x300);
 	BOOST_CHECK_EQUAL(b0.ceil().v, 0x200); BOOST_CHECK_EQUAL(b1.ceil().v, 0x200);	BOOST_CHECK_EQUAL(b2.ceil().v, 0x200);
 }
+
+/// Checks the 64 bit fixed_point type, whose products need 128 bits, against
+/// the narrower types and the portable multiplication.
+BOOST_AUTO_TEST_CASE(fixed_point_wide)
+{
+	typedef gma::fixed_point<32,32> fixed32_32;
+	BOOST_CHECK_EQUAL((int64_t)fixed32_32::factor, (int64_t)1 << 32);
+	BOOST_CHECK_EQUAL(sizeof(fixed32_32), 8u);
+
+	// Without 128 bit integers, only the multiplication is available.
+	fixed32_32 a, b, c;
+	a.v = (int64_t)13 << 30;
+	b.v = -((int64_t)3 << 31);
+	c.v = (int64_t)40000 << 32;
+	BOOST_CHECK_EQUAL((double)(a*b), -4.875);
+	BOOST_CHECK_EQUAL((double)(c*c), 1.6e9);
+	BOOST_CHECK_EQUAL((double)(a*gma::fixed_point<16,16>(2.5)), 8.125);
+	a *= b;
+	BOOST_CHECK_EQUAL((double)a, -4.875);
+#ifdef GAMMA_HAS_INT128
+	BOOST_CHECK_EQUAL(fixed32_32(3.25).v, (int64_t)13 << 30);
+	BOOST_CHECK_EQUAL((double)(a/b), 3.25);
+	BOOST_CHECK(c > b);
+#endif
+
+	// Products are rounded towards zero as for the 32 bit types.
+	uint64_t seed = 1;
+	for (int i = 0; i < 1000; ++i) {
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		gma::fixed_point<16,16> x, y;
+		x.v = (int32_t)(seed >> 32);
+		y.v = (int32_t)seed >> (i % 16);
+		fixed32_32 wx, wy;
+		wx.v = (int64_t)x.v << 16;
+		wy.v = (int64_t)y.v << 16;
+		BOOST_CHECK_EQUAL((wx*wy).v, (int64_t)x.v * y.v);
+		BOOST_CHECK_EQUAL((x*y).v, (int32_t)((wx*wy).v / 65536));
+
+		int64_t p = (int64_t)seed, q = (int64_t)(seed * 31) >> (i % 40);
+		BOOST_CHECK_EQUAL((gma::detail::mul_shift_portable<32>(p, q)), (gma::detail::mul_shift<32,128>::apply(p, q)));
+		BOOST_CHECK_EQUAL((gma::detail::mul_shift_portable<7>(p, q)), (gma::detail::mul_shift<7,128>::apply(p, q)));
+		BOOST_CHECK_EQUAL((gma::detail::mul_shift_portable<64>(p, q)), (gma::detail::mul_shift<64,128>::apply(p, q)));
+	}
+
+	// Wider types have no portable multiplication, e.g. fixed_point<40,40>.
+	BOOST_CHECK((gma::detail::fits_portable<int64_t,int32_t>::value));
+#ifdef GAMMA_HAS_INT128
+	typedef gma::integer::signed_integer<80>::type wide;
+	BOOST_CHECK_EQUAL(sizeof(gma::fixed_point<40,40>), sizeof(wide));
+	BOOST_CHECK(!(gma::detail::fits_portable<wide,int64_t>::value));
+	BOOST_CHECK(!(gma::detail::fits_portable<int64_t,wide>::value));
+#endif
+}
+
+/// Compares the integer elementary functions of fixed_point against the
+/// floating point ones, and instantiates normalization and the rotations.
+template <int Ia, int Da> void check_fixed_point_math()
+{
+	typedef gma::fixed_point<Ia,Da> F;
+	const double ulp = 1.0 / ((int64_t)1 << Da);
+	for (double a = -40; a < 40; a += 0.173) {
+		F f(a);
+		double x = (double)f.v * ulp;
+		BOOST_CHECK_SMALL((double)gma::sin(f) - std::sin(x), ulp);
+		BOOST_CHECK_SMALL((double)gma::cos(f) - std::cos(x), ulp);
+	}
+	for (double a = -5; a < 5; a += 0.37) {
+		for (double b = -5; b < 5; b += 0.41) {
+			F y(a), x(b);
+			BOOST_CHECK_SMALL((double)gma::atan2(y, x) - std::atan2((double)y.v * ulp, (double)x.v * ulp), ulp);
+		}
+	}
+	BOOST_CHECK_SMALL((double)gma::atan2(F(0), F(-1)) - 3.14159265358979, ulp);
+	BOOST_CHECK_EQUAL(gma::atan2(F(0), F(0)).v, 0);
+	for (double a = 0.01; a < 90; a *= 1.07) {
+		F f(a);
+		double x = (double)f.v * ulp;
+		BOOST_CHECK_LE(std::abs((double)gma::sqrt(f) - std::sqrt(x)), ulp / 2);
+		BOOST_CHECK_LE(std::abs((double)gma::rsqrt(f) - 1 / std::sqrt(x)), ulp);
+		BOOST_CHECK_EQUAL(gma::reciprocal(f).v, (F(1) / f).v);
+	}
+	BOOST_CHECK_EQUAL(gma::sqrt(F(-1)).v, 0);
+}
+
+BOOST_AUTO_TEST_CASE(fixed_point_math)
+{
+	check_fixed_point_math<16,16>();
+	check_fixed_point_math<24,8>();
+	check_fixed_point_math<8,24>();
+#ifdef GAMMA_HAS_INT128
+	check_fixed_point_math<32,32>();
+#endif
+
+	// The same bits on every platform.
+	typedef gma::fixed_point<16,16> fixed16_16;
+	BOOST_CHECK_EQUAL(gma::sin(fixed16_16(1)).v, 55147);
+	BOOST_CHECK_EQUAL(gma::cos(fixed16_16(-100)).v, 56513);
+	BOOST_CHECK_EQUAL(gma::atan2(fixed16_16(-1), fixed16_16(-2)).v, -175502);
+	BOOST_CHECK_EQUAL(gma::sqrt(fixed16_16(2)).v, 92682);
+
+	gma::vector3<fixed16_16> v(fixed16_16(3), fixed16_16(-4), fixed16_16(12));
+	gma::vector3<fixed16_16> n = v.normalized();
+	BOOST_CHECK_SMALL((double)n.x - 3.0 / 13, 1e-4);
+	BOOST_CHECK_SMALL((double)n.y + 4.0 / 13, 1e-4);
+	BOOST_CHECK_SMALL((double)n.z - 12.0 / 13, 1e-4);
+	BOOST_CHECK_SMALL((double)v.normalized_fast().z - 12.0 / 13, 1e-4);
+
+	gma::transform::axial_rotation<fixed16_16> r(gma::vector3<fixed16_16>(fixed16_16(0.3), fixed16_16(-1.2), fixed16_16(2.5)));
+	gma::transform::axial_rotation<double> rd(vector3d(0.3, -1.2, 2.5));
+	r.update();
+	rd.update();
+	r.update_axes();
+	gma::transform::update(&r, 1);
+	for (int j = 0; j < 16; ++j)
+		BOOST_CHECK_SMALL((double)r.m.v[j] - rd.m.v[j], 1e-4);
+	gma::transform::x_rotation<fixed16_16> rx(fixed16_16(0.5));
+	rx.update();
+	BOOST_CHECK_SMALL((double)rx.m.m12 + std::sin(0.5), 1e-4);
+}
+
+/// Compares the SIMD specializations of the 4x4 products against the generic
+/// scalar templates, which are selected explicitly.
+BOOST_AUTO_TEST_CASE(matrix4_simd_product)
+{
+	#define check_product(_matrix, _vector, _type, _tolerance) {\
+		_matrix a, b;\
+		_vector x(1.5, -2, 0.25, 1);\
+		for (int i = 0; i < 16; ++i) {\
+			a.v[i] = (_type)((i*7 % 11) - 5) / 3;\
+			b.v[i] = (_type)((i*5 % 13) - 6) / 7;\
+		}\
+		_matrix ab = a*b, ab_ref = gma::operator*<_type,_type>(a, b);\
+		_vector ax = a*x, ax_ref = gma::operator*<_type,_type>(a, x);\
+		for (int i = 0; i < 16; ++i)\
+			BOOST_CHECK_SMALL(ab.v[i] - ab_ref.v[i], (_type)_tolerance);\
+		for (int i = 0; i < 4; ++i)\
+			BOOST_CHECK_SMALL(ax(i) - ax_ref(i), (_type)_tolerance);\
+	}
+
+	check_product(matrix4f, vector4f, float, 1e-5);
+	check_product(matrix4d, vector4d, double, 1e-12);
+
+	#undef check_product
+}
+
+/// Transforms a batch of points and directions in structure-of-arrays layout
+/// and compares against transforming each vector individually. The count is
+/// chosen to exercise the scalar tail after the SIMD loop.
+BOOST_AUTO_TEST_CASE(soa_transform)
+{
+	#define check_transform(_type, _suffix) {\
+		gma::matrix4<_type> m(\
+			0.5, -1, 2, 3,\
+			1, 0.25, 0, -4,\
+			-2, 1, 1.5, 5,\
+			0, 0, 0, 1);\
+		std::vector<gma::vector3<_type> > v(37);\
+		for (size_t i = 0; i < v.size(); ++i)\
+			v[i] = gma::vector3<_type>((_type)i, (_type)i/3 - 4, (_type)(i%5) * 2);\
+		soa3 ## _suffix in(&v[0], v.size()), points, directions;\
+		gma::transform_points(m, in, points);\
+		gma::transform_directions(m, in, directions);\
+		BOOST_REQUIRE_EQUAL(points.size(), v.size());\
+		std::vector<gma::vector3<_type> > out(v.size());\
+		points.copy_to(&out[0]);\
+		for (size_t i = 0; i < v.size(); ++i) {\
+			gma::vector4<_type> p = m * gma::vector4<_type>(v[i], 1);\
+			gma::vector4<_type> d = m * gma::vector4<_type>(v[i], 0);\
+			BOOST_CHECK_SMALL(out[i].x - p.x, (_type)1e-4);\
+			BOOST_CHECK_SMALL(out[i].y - p.y, (_type)1e-4);\
+			BOOST_CHECK_SMALL(out[i].z - p.z, (_type)1e-4);\
+			BOOST_CHECK_SMALL(directions[i].x - d.x, (_type)1e-4);\
+			BOOST_CHECK_SMALL(directions[i].y - d.y, (_type)1e-4);\
+			BOOST_CHECK_SMALL(directions[i].z - d.z, (_type)1e-4);\
+		}\
+	}
+
+	check_transform(float, f);
+	check_transform(double, d);
+
+	#undef check_transform
+}
+
+BOOST_AUTO_TEST_CASE(constant_expressions)
+{
+	// Values, operators and closed-form transforms fold at compile time.
+	constexpr vector3f v = vector3f(1,2,3) * 2.0f - vector3f(1);
+	static_assert(v == vector3f(1,3,5), "vector arithmetic");
+	static_assert(v.cross(vector3f(0,0,1)) == vector3f(3,-1,0), "cross product");
+	static_assert(matrix3d(2,0,0, 0,3,0, 0,0,4).determinant() == 24, "determinant");
+
+	constexpr matrix4d t = gma::transform::translationd(vector3d(1,2,3));
+	constexpr matrix4d o = gma::transform::orthogonald(-2, 2, -1, 1, 0.5, 4);
+	constexpr vector4d p = matrix4d(t) * vector4d(1,1,1,1);
+	static_assert(p == vector4d(2,3,4,1), "translation");
+	static_assert(o.m00 == 0.5 && o.m11 == 1 && o.m03 == 0, "orthogonal");
+	constexpr matrix4f id = gma::transform::orthogonalf();
+	static_assert(id.m00 == 1 && id.m11 == 1 && id.m22 == 1 && id.m23 == 0, "default orthogonal");
+
+#ifdef GAMMA_HAS_IS_CONSTANT_EVALUATED
+	// The SIMD specializations fall back to the scalar code in constant
+	// expressions and agree with it at run time.
+	constexpr matrix4f a(1,2,3,4, 5,6,7,8, 9,10,11,12, 13,14,15,16);
+	constexpr matrix4f b = a * a.transposed();
+	constexpr vector4f c = a * vector4f(1,0,0,0);
+	static_assert(b.m00 == 30 && b.m11 == 174 && b.m03 == 150, "matrix product");
+	static_assert(c == vector4f(1,5,9,13), "matrix vector product");
+	constexpr quaternionf q = quaternionf(0,0,1,0) * quaternionf(0,0,1,0);
+	static_assert(q == quaternionf(0,0,0,-1), "quaternion product");
+	matrix4f ra = a, rb = ra * ra.transposed();
+	for (int i = 0; i < 16; ++i)
+		BOOST_CHECK_EQUAL(rb.v[i], b.v[i]);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(expression)
+{
+	using gma::expr;
+
+	// Integer chains are exact and match the operators.
+	vector3i a(1,-2,3), b(4,5,-6);
+	vector3i ri = expr(a)*3 - expr(b)*2 + mul(expr(a), expr(b));
+	BOOST_CHECK(ri == a*3 - b*2 + a.mul(b));
+
+	// Floating point chains may be fused into multiply-adds and round
+	// differently in the last place.
+	matrix4f m0, m1;
+	matrix3d n0, n1;
+	for (int i = 0; i < 16; ++i) { m0.v[i] = i * 0.5f - 3; m1.v[i] = 7 - i * 0.25f; }
+	for (int i = 0; i < 9; ++i) { n0.v[i] = i * 0.5 - 3; n1.v[i] = 7 - i * 0.25; }
+	matrix4f m = expr(m0)*0.3f + expr(m1)*0.7f - expr(m0), me = m0*0.3f + m1*0.7f - m0;
+	matrix3d n = -expr(n0) + div(expr(n1), expr(n1)) / 4.0, ne = -n0 + n1.div(n1) / 4.0;
+	for (int i = 0; i < 16; ++i)
+		BOOST_CHECK_SMALL(m.v[i] - me.v[i], 1e-5f);
+	for (int i = 0; i < 9; ++i)
+		BOOST_CHECK_SMALL(n.v[i] - ne.v[i], 1e-12);
+
+	// The result may alias an operand.
+	vector4d v(1,2,3,4), w(2,2,2,2);
+	v = eval(expr(v)*2.0 - expr(w));
+	BOOST_CHECK(v == vector4d(0,2,4,6));
+}
+
+BOOST_AUTO_TEST_CASE(vector_normalize)
+{
+	// The batch versions match the members for all lengths of the array,
+	// covering both the SIMD and the scalar parts.
+	const size_t n = 11;
+	vector3f vf[n], rf[n], sf[n];
+	vector3d vd[n], rd[n], sd[n];
+	for (size_t i = 0; i < n; ++i) {
+		vf[i] = vector3f(i * 0.7f - 3, 1e3f / (i + 1), -(float)(i % 4) - 0.5f);
+		vd[i] = vector3d(vf[i]) * 1e-5;
+	}
+	normalize(vf, rf, n);
+	normalize_fast(vf, sf, n);
+	normalize(vd, rd, n);
+	normalize_fast(vd, sd, n);
+	for (size_t i = 0; i < n; ++i) {
+		vector3f ef = vf[i].normalized(), ff = vf[i].normalized_fast();
+		vector3d ed = vd[i].normalized();
+		for (int j = 0; j < 3; ++j) {
+			BOOST_CHECK_SMALL(rf[i](j) - ef(j), 1e-7f);
+			BOOST_CHECK_SMALL(sf[i](j) - ff(j), 1e-7f);
+			BOOST_CHECK_SMALL(ff(j) - ef(j), 5e-7f);
+			BOOST_CHECK_SMALL(rd[i](j) - ed(j), 1e-15);
+			BOOST_CHECK_SMALL(sd[i](j) - ed(j), 1e-15);
+		}
+	}
+
+	// In place.
+	normalize(vf, vf, n);
+	for (size_t i = 0; i < n; ++i)
+		BOOST_CHECK_SMALL(vf[i].length2() - 1, 1e-6f);
+
+	// The documented bound of the reciprocal square root.
+	for (float x = 1e-30f; x < 1e30f; x *= 1.0013f)
+		BOOST_CHECK_SMALL((double)gma::rsqrt_fast(x) * std::sqrt((double)x) - 1, 1.0 / (1 << 21));
+}
+
+/// Checks that the inverses yield the identity when multiplied with the
+/// original matrix, and that the specialized affine and orthonormal inverses
+/// agree with the general one on matrices of the corresponding form.
+BOOST_AUTO_TEST_CASE(matrix_inverse)
+{
+	#define check_identity(_m, _dim, _tolerance) {\
+		for (int i = 0; i < _dim; ++i)\
+			for (int j = 0; j < _dim; ++j)\
+				BOOST_CHECK_SMALL((_m)(i,j) - (i == j ? 1 : 0), _tolerance);\
+	}
+	#define check_equal(_a, _b, _dim, _tolerance) {\
+		for (int i = 0; i < _dim*_dim; ++i)\
+			BOOST_CHECK_SMALL((_a).v[i] - (_b).v[i], _tolerance);\
+	}
+
+	#define check_inverse(_type, _tolerance) {\
+		gma::matrix4<_type> m(\
+			2, -1, 0.5, 3,\
+			1, 3, -2, 1,\
+			0.5, 1, 4, -1,\
+			1, -2, 0.25, 2);\
+		gma::transform::z_rotation<_type> rz(0.3); rz.update();\
+		gma::transform::x_rotation<_type> rx(-1.1); rx.update();\
+		gma::matrix4<_type> t = (gma::matrix4<_type>)gma::transform::translation<_type>(gma::vector3<_type>(1, -2, 3));\
+		gma::matrix4<_type> rigid = t * rz.m * rx.m;\
+		gma::matrix4<_type> affine = rigid * gma::matrix4<_type>(\
+			2, 0.5, 0, 0,\
+			0, 3, 0, 0,\
+			0, 0, 0.5, 0,\
+			0, 0, 0, 1);\
+		check_identity(m * m.inverse(), 4, _tolerance);\
+		check_identity(m.inverse() * m, 4, _tolerance);\
+		check_identity(affine * affine.inverse_affine(), 4, _tolerance);\
+		check_identity(rigid * rigid.inverse_orthonormal(), 4, _tolerance);\
+		check_equal(affine.inverse_affine(), affine.inverse(), 4, _tolerance);\
+		check_equal(rigid.inverse_orthonormal(), rigid.inverse(), 4, _tolerance);\
+		BOOST_CHECK_CLOSE(m.determinant(), (_type)1 / m.inverse().determinant(), _tolerance * 100);\
+		\
+		gma::matrix3<_type> n(\
+			2, -1, 0.5,\
+			1, 3, -2,\
+			0.5, 1, 4);\
+		gma::matrix3<_type> a2(\
+			2, 1, 3,\
+			-0.5, 1.5, -1,\
+			0, 0, 1);\
+		gma::matrix3<_type> r2(\
+			cos(0.7), -sin(0.7), 3,\
+			sin(0.7), cos(0.7), -1,\
+			0, 0, 1);\
+		check_identity(n * n.inverse(), 3, _tolerance);\
+		gma::matrix3<_type> r3(\
+			rigid.m00, rigid.m01, rigid.m02,\
+			rigid.m10, rigid.m11, rigid.m12,\
+			rigid.m20, rigid.m21, rigid.m22);\
+		check_identity(a2 * a2.inverse_affine_2d(), 3, _tolerance);\
+		check_identity(r2 * r2.inverse_orthonormal_2d(), 3, _tolerance);\
+		check_equal(n.inverse_affine(), n.inverse(), 3, _tolerance);\
+		check_identity(r3 * r3.inverse_orthonormal(), 3, _tolerance);\
+		check_equal(r3.inverse_orthonormal(), r3.inverse(), 3, _tolerance);\
+		check_equal(n.transposed().transposed(), n, 3, _tolerance);\
+		BOOST_CHECK_CLOSE(n.determinant(), n.transposed().determinant(), _tolerance * 100);\
+	}
+
+	check_inverse(float, 1e-4f);
+	check_inverse(double, 1e-10);
+
+	#undef check_identity
+	#undef check_equal
+	#undef check_inverse
+}
+
+/// Applies a sequence of changes to a lazy_mvp and compares the derived
+/// matrices against an mvp built from scratch after each step.
+BOOST_AUTO_TEST_CASE(lazy_mvp)
+{
+	#define check_matrix(_a, _b, _dim) {\
+		for (int i = 0; i < _dim*_dim; ++i)\
+			BOOST_CHECK_SMALL((_a).v[i] - (_b).v[i], 1e-4f);\
+	}
+	#define check_mvp(_lazy, _ref) {\
+		check_matrix(_lazy.get_model_view(), _ref.model_view, 4);\
+		check_matrix(_lazy.get_model_view_projection(), _ref.model_view_projection, 4);\
+		check_matrix(_lazy.get_normal(), _ref.normal, 3);\
+	}
+
+	gma::transform::x_rotation<float> rx(0.4); rx.update();
+	gma::transform::z_rotation<float> rz(-1.2); rz.update();
+	matrix4f t = gma::transform::translation<float>(vector3f(1, 2, -3));
+	matrix4f p = gma::transform::perspective<float>(1.2, 1.5, 0.1, 100);
+
+	gma::lazy_mvpf lazy;
+	gma::mvpf ref;
+	check_mvp(lazy, ref);
+
+	lazy.set_projection(p); ref = ref.set_projection(p); check_mvp(lazy, ref);
+	lazy.set_view(t); ref = ref.set_view(t); check_mvp(lazy, ref);
+	lazy.set_model(rx.m); ref = ref.set_model(rx.m);
+	check_matrix(lazy.get_model_view_projection(), ref.model_view_projection, 4);
+	lazy.mul_model(rz.m); ref = ref.mul_model(rz.m); check_mvp(lazy, ref);
+	lazy.mul_view(rz.m); ref = ref.mul_view(rz.m); check_mvp(lazy, ref);
+	lazy.reset_model(); ref = ref.reset_model(); check_mvp(lazy, ref);
+
+	gma::mvpf converted = lazy;
+	check_matrix(converted.model_view_projection, ref.model_view_projection, 4);
+
+	#undef check_matrix
+	#undef check_mvp
+}
+
+struct parallel_for_check
+{
+	std::vector<int>* visits;
+	std::vector<unsigned>* workers;
+	void operator() (size_t begin, size_t end, unsigned worker) const {
+		for (size_t i = begin; i < end; ++i) { (*visits)[i]++; (*workers)[i] = worker; }
+	}
+};
+
+/// Forces parallel_for onto several threads and checks that every index is
+/// visited exactly once, by the worker owning the corresponding chunk.
+BOOST_AUTO_TEST_CASE(parallel_for)
+{
+	const size_t n = 1000;
+	std::vector<int> visits(n, 0);
+	std::vector<unsigned> workers(n, 0);
+	parallel_for_check f = {&visits, &workers};
+
+	BOOST_CHECK_EQUAL(gma::parallel_workers(n, 100, 4), 4u);
+	BOOST_CHECK_EQUAL(gma::parallel_workers(n, 400, 4), 3u);
+	BOOST_CHECK_EQUAL(gma::parallel_workers(0, 100, 4), 1u);
+
+	gma::parallel_for(n, 100, f, 4);
+	for (size_t i = 0; i < n; ++i) {
+		BOOST_CHECK_EQUAL(visits[i], 1);
+		BOOST_CHECK_EQUAL(workers[i], (unsigned)(i * 4 / n));
+	}
+}
+
+struct parallel_for_throw
+{
+	std::vector<int>* visits;
+	void operator() (size_t begin, size_t end, unsigned worker) const {
+		if (worker == 3) throw std::runtime_error("chunk failed");
+		for (size_t i = begin; i < end; ++i) (*visits)[i]++;
+	}
+};
+
+/// Throws from the chunk processed on the calling thread, which must reach
+/// the caller only after the other workers have finished theirs.
+BOOST_AUTO_TEST_CASE(parallel_for_exception)
+{
+	const size_t n = 1000;
+	std::vector<int> visits(n, 0);
+	parallel_for_throw f = {&visits};
+	BOOST_CHECK_THROW(gma::parallel_for(n, 100, f, 4), std::runtime_error);
+	for (size_t i = 0; i < n; ++i)
+		BOOST_CHECK_EQUAL(visits[i], i < n * 3 / 4 ? 1 : 0);
+}
+
+/// Computes a batch of instances large enough to be split across threads and
+/// compares a few of them against individually constructed mvps.
+BOOST_AUTO_TEST_CASE(mvp_batch)
+{
+	const size_t n = 3 * gma::mvp_batch_grain + 17;
+	matrix4f view = gma::transform::translation<float>(vector3f(1, 2, -3));
+	matrix4f projection = gma::transform::perspective<float>(1.2, 1.5, 0.1, 100);
+
+	std::vector<matrix4f> models(n), mv(n), mvp(n);
+	std::vector<matrix3f> normal(n);
+	for (size_t i = 0; i < n; ++i) {
+		gma::transform::axial_rotation<float> r(vector3f(i*0.01, i*0.02, i*0.03));
+		models[i] = (matrix4f)gma::transform::translation<float>(vector3f(i, -(float)i, 1)) * (matrix4f)r.update();
+	}
+	gma::mvp_batch(view, projection, &models[0], n, &mv[0], &mvp[0], &normal[0]);
+
+	for (size_t i = 0; i < n; i += 1021) {
+		gma::mvpf ref(models[i], view, projection);
+		for (int j = 0; j < 16; ++j) {
+			BOOST_CHECK_SMALL(mv[i].v[j] - ref.model_view.v[j], 1e-3f);
+			BOOST_CHECK_SMALL(mvp[i].v[j] - ref.model_view_projection.v[j], 1e-3f);
+		}
+		for (int j = 0; j < 9; ++j)
+			BOOST_CHECK_SMALL(normal[i].v[j] - ref.normal.v[j], 1e-3f);
+	}
+
+	// Only the requested outputs are written.
+	std::vector<matrix4f> mvp_only(n);
+	gma::mvp_batch(view, projection, &models[0], n, (matrix4f*)0, &mvp_only[0], (matrix3f*)0);
+	BOOST_CHECK(mvp_only[n-1].m00 == mvp[n-1].m00 && mvp_only[n-1].m33 == mvp[n-1].m33);
+}
+
+/// Places instances and camera far from the world origin and compares the
+/// camera-relative batch against the products computed in double.
+BOOST_AUTO_TEST_CASE(mvp_batch_relative)
+{
+	const size_t n = 2 * gma::mvp_batch_grain + 5;
+	const vector3d origin(1.5e7 + 0.3, -2.25e6, 8e5 + 0.7);
+	const vector3d target(1, -2, 0.5), up(0, 1, 0);
+	matrix4f projection = gma::transform::perspective<float>(1.2, 1.5, 0.1, 1000);
+	matrix4d view_d = (matrix4d)gma::transform::orientation<double>(target, up) * (matrix4d)gma::transform::translation<double>(-origin);
+
+	std::vector<matrix4d> models(n);
+	std::vector<matrix4f> mv(n), mvp(n);
+	std::vector<matrix3f> normal(n);
+	for (size_t i = 0; i < n; ++i) {
+		gma::transform::axial_rotation<double> r(vector3d(i*0.01, i*0.02, i*0.03));
+		vector3d offset((double)(i%101) - 50, (double)(i%7) * 0.125, -(double)(i%13));
+		models[i] = (matrix4d)gma::transform::translation<double>(origin + offset) * (matrix4d)r.update();
+	}
+	gma::mvp_batch(origin, (matrix4f)gma::transform::orientation<float>(vector3f(target), vector3f(up)), projection,
+		&models[0], n, &mv[0], &mvp[0], &normal[0]);
+
+	for (size_t i = 0; i < n; i += 257) {
+		matrix4d ref = view_d * models[i];
+		matrix4d ref_mvp = (matrix4d)projection * ref;
+		matrix3d ref_normal = gma::normal_matrix(ref);
+		for (int j = 0; j < 16; ++j) {
+			BOOST_CHECK_SMALL(mv[i].v[j] - ref.v[j], 1e-4);
+			BOOST_CHECK_SMALL(mvp[i].v[j] - ref_mvp.v[j], 1e-4);
+		}
+		for (int j = 0; j < 9; ++j)
+			BOOST_CHECK_SMALL(normal[i].v[j] - ref_normal.v[j], 1e-5);
+	}
+
+	// Converting the world space matrices to float loses the offsets.
+	matrix4f naive = (matrix4f)view_d * (matrix4f)models[n-1];
+	BOOST_CHECK_GT(std::abs(naive.m03 - (view_d * models[n-1]).m03), 1e-2);
+}
+
+/// Compares the closed-form axial rotation against the product of the
+/// individual axis rotations, for single updates and the batch update.
+BOOST_AUTO_TEST_CASE(axial_rotation)
+{
+	std::vector<gma::transform::axial_rotation<double> > r(100);
+	for (size_t i = 0; i < r.size(); ++i)
+		r[i].v = vector3d(i*0.1 - 3, i*0.07 + 1, 2 - i*0.13);
+	gma::transform::update(&r[0], r.size());
+
+	for (size_t i = 0; i < r.size(); ++i) {
+		gma::transform::axial_rotation<double> a(r[i].v);
+		a.update().update_axes();
+		matrix4d ref = (matrix4d)a.mz * (matrix4d)a.my * (matrix4d)a.mx;
+		for (int j = 0; j < 16; ++j) {
+			BOOST_CHECK_SMALL(a.m.v[j] - ref.v[j], 1e-12);
+			BOOST_CHECK_EQUAL(r[i].m.v[j], a.m.v[j]);
+		}
+	}
+
+	// The float batch update may use the SIMD sincos.
+	std::vector<gma::transform::axial_rotation<float> > rf(1000);
+	for (size_t i = 0; i < rf.size(); ++i)
+		rf[i].v = vector3f(i*0.1f - 50, i*0.07f + 1, 20 - i*0.13f);
+	gma::transform::update(&rf[0], rf.size());
+	for (size_t i = 0; i < rf.size(); ++i) {
+		gma::transform::axial_rotation<float> a(rf[i].v);
+		a.update();
+		for (int j = 0; j < 16; ++j)
+			BOOST_CHECK_SMALL(rf[i].m.v[j] - a.m.v[j], 1e-6f);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(quaternion)
+{
+	#define check_matrix(_a, _b, _dim) {\
+		for (int i = 0; i < _dim*_dim; ++i)\
+			BOOST_CHECK_SMALL((_a).v[i] - (_b).v[i], 1e-5f);\
+	}
+
+	// Rotations about the x and z axes match the rotation transforms.
+	gma::transform::x_rotation<float> rx(0.7); rx.update();
+	gma::transform::z_rotation<float> rz(-2.1); rz.update();
+	quaternionf qx = quaternionf::axis_angle(vector3f(1,0,0), 0.7);
+	quaternionf qz = quaternionf::axis_angle(vector3f(0,0,1), -2.1);
+	check_matrix(qx.to_matrix4(), rx.m, 4);
+	check_matrix(qz.to_matrix4(), rz.m, 4);
+
+	// The product composes rotations like the matrix product does.
+	quaternionf q = qz * qx;
+	matrix4f m = rz.m * rx.m;
+	check_matrix(q.to_matrix4(), m, 4);
+	vector3f v(0.3, -1.5, 2), a = q * v, b = q.to_matrix3() * v;
+	BOOST_CHECK_SMALL(a.x - b.x, 1e-5f);
+	BOOST_CHECK_SMALL(a.y - b.y, 1e-5f);
+	BOOST_CHECK_SMALL(a.z - b.z, 1e-5f);
+
+	// Converting back from a matrix yields the same rotation, covering all
+	// four pivots of the conversion.
+	const float angles[] = { 0.3f, 2.9f, -2.9f, 3.1f };
+	const vector3f axes[] = { vector3f(0,0,1), vector3f(1,0,0), vector3f(0,1,0), vector3f(0,0,1) };
+	for (int i = 0; i < 4; ++i) {
+		quaternionf r = quaternionf::axis_angle(axes[i], angles[i]) * qx;
+		quaternionf s(r.to_matrix3());
+		BOOST_CHECK_CLOSE(std::fabs(r.dot(s)), 1.0f, 1e-4f);
+	}
+
+	// The generic and SIMD products agree.
+	quaterniond dx(qx), dz(qz), d = dz * dx, e = gma::operator*<double>(dz, dx);
+	BOOST_CHECK_SMALL(d.x - e.x, 1e-12);
+	BOOST_CHECK_SMALL(d.y - e.y, 1e-12);
+	BOOST_CHECK_SMALL(d.z - e.z, 1e-12);
+	BOOST_CHECK_SMALL(d.w - e.w, 1e-12);
+
+	// The batch slerp stays close to the exact one, for both float and double
+	// and for pairs on opposite hemispheres.
+	const size_t n = 103;
+	std::vector<quaternionf> qa(n), qb(n), qr(n);
+	std::vector<float> t(n);
+	for (size_t i = 0; i < n; ++i) {
+		qa[i] = quaternionf::axis_angle(vector3f(1,2,3).normalized(), i * 0.11f);
+		qb[i] = quaternionf::axis_angle(vector3f(-2,0,1).normalized(), 1 - i * 0.07f);
+		t[i] = (i % 11) / 10.0f;
+	}
+	gma::slerp(&qa[0], &qb[0], &t[0], &qr[0], n);
+	for (size_t i = 0; i < n; ++i) {
+		quaternionf r = gma::slerp(qa[i], qb[i], t[i]);
+		BOOST_CHECK_SMALL(r.x - qr[i].x, 2e-6f);
+		BOOST_CHECK_SMALL(r.y - qr[i].y, 2e-6f);
+		BOOST_CHECK_SMALL(r.z - qr[i].z, 2e-6f);
+		BOOST_CHECK_SMALL(r.w - qr[i].w, 2e-6f);
+	}
+
+	std::vector<quaterniond> da(n), db(n), dr(n);
+	std::vector<double> dt(n);
+	for (size_t i = 0; i < n; ++i) { da[i] = quaterniond(qa[i]); db[i] = quaterniond(qb[i]); dt[i] = t[i]; }
+	gma::slerp(&da[0], &db[0], &dt[0], &dr[0], n);
+	for (size_t i = 0; i < n; ++i) {
+		quaterniond r = gma::slerp(da[i], db[i], dt[i]);
+		BOOST_CHECK_SMALL(r.x - dr[i].x, 1e-6);
+		BOOST_CHECK_SMALL(r.w - dr[i].w, 1e-6);
+	}
+
+	#undef check_matrix
+}
+
+BOOST_AUTO_TEST_CASE(frustum)
+{
+	matrix4f p = gma::transform::perspective<float>(1.2, 1.5, 0.1, 100);
+	frustumf f(p);
+	BOOST_CHECK(f.contains(vector3f(0, 0, -5)));
+	BOOST_CHECK(!f.contains(vector3f(0, 0, 5)));
+	BOOST_CHECK(!f.contains(vector3f(0, 0, -200)));
+	BOOST_CHECK(!f.contains(vector3f(100, 0, -5)));
+	BOOST_CHECK(f.intersects(sphere3f(vector3f(0, 0, 0.5), 1)));
+	BOOST_CHECK(!f.intersects(sphere3f(vector3f(0, 0, 2), 1)));
+	BOOST_CHECK_CLOSE(f.distance(frustumf::near_plane, vector3f(0, 0, -1)), 0.9f, 1e-3f);
+
+	// The batch test agrees with intersects(), for both float and double.
+	const size_t n = 1003;
+	std::vector<sphere3f> s(n);
+	std::vector<sphere3d> sd(n);
+	for (size_t i = 0; i < n; ++i) {
+		s[i] = sphere3f(vector3f((i*37 % 101) - 50.0f, (i*53 % 89) - 44.0f, -float(i*29 % 113)), (i % 7) * 0.5f);
+		sd[i] = sphere3d(vector3d(s[i].c), s[i].r);
+	}
+	frustumd fd = frustumd(matrix4d(p));
+	std::vector<uint64_t> mask((n+63)/64, ~uint64_t(0)), maskd((n+63)/64);
+	size_t visible = gma::cull(f, &s[0], n, &mask[0]);
+	size_t visibled = gma::cull(fd, &sd[0], n, &maskd[0]);
+	size_t expected = 0, expectedd = 0;
+	for (size_t i = 0; i < n; ++i) {
+		bool v = f.intersects(s[i]);
+		expected += v;
+		expectedd += fd.intersects(sd[i]);
+		BOOST_CHECK_EQUAL((mask[i/64] >> (i%64)) & 1, (uint64_t)v);
+		BOOST_CHECK_EQUAL((maskd[i/64] >> (i%64)) & 1, (uint64_t)fd.intersects(sd[i]));
+	}
+	BOOST_CHECK_EQUAL(visible, expected);
+	BOOST_CHECK_EQUAL(visibled, expectedd);
+	BOOST_CHECK(visible > 0 && visible < n);
+	BOOST_CHECK_EQUAL((mask.back() >> (n%64)), 0u);
+}
+
+/// Checks that the fixed_point batch kernels match the scalar operators bit
+/// for bit, on raw values covering the whole 32 bit range.
+template <typename F> void check_fixed_point_batch()
+{
+	const size_t n = 203;
+	std::vector<F> a(n), b(n), r(n);
+	gma::soa3<F> va(n), vb(n), vr;
+	uint32_t seed = 12345;
+	for (size_t i = 0; i < n; ++i) {
+		seed = seed * 1664525 + 1013904223; a[i].v = (int32_t)seed >> (i % 3 * 8);
+		seed = seed * 1664525 + 1013904223; b[i].v = (int32_t)seed >> (i % 4 * 6);
+	}
+	for (size_t i = 0; i < n; ++i) {
+		va.x[i] = a[i]; va.y[i] = b[(i+1) % n]; va.z[i] = a[(i+2) % n];
+		vb.x[i] = b[i]; vb.y[i] = a[(i+3) % n]; vb.z[i] = b[(i+5) % n];
+	}
+
+	gma::add(&a[0], &b[0], &r[0], n);
+	for (size_t i = 0; i < n; ++i) BOOST_CHECK_EQUAL(r[i].v, (a[i] + b[i]).v);
+	gma::sub(&a[0], &b[0], &r[0], n);
+	for (size_t i = 0; i < n; ++i) BOOST_CHECK_EQUAL(r[i].v, (a[i] - b[i]).v);
+	gma::mul(&a[0], &b[0], &r[0], n);
+	for (size_t i = 0; i < n; ++i) BOOST_CHECK_EQUAL(r[i].v, (a[i] * b[i]).v);
+
+	gma::dot(va, vb, &r[0]);
+	for (size_t i = 0; i < n; ++i) BOOST_CHECK_EQUAL(r[i].v, va[i].dot(vb[i]).v);
+	gma::cross(va, vb, vr);
+	for (size_t i = 0; i < n; ++i) {
+		gma::vector3<F> c = va[i].cross(vb[i]);
+		BOOST_CHECK_EQUAL(vr.x[i].v, c.x.v);
+		BOOST_CHECK_EQUAL(vr.y[i].v, c.y.v);
+		BOOST_CHECK_EQUAL(vr.z[i].v, c.z.v);
+	}
+
+	gma::matrix4<F> m;
+	for (int i = 0; i < 16; ++i) m.v[i] = a[i*7];
+	gma::soa3<F> ref(n);
+	gma::detail::transform_soa_scalar<true>(m, 0, n, &va.x[0], &va.y[0], &va.z[0], &ref.x[0], &ref.y[0], &ref.z[0]);
+	gma::transform_points(m, va, vr);
+	for (size_t i = 0; i < n; ++i) {
+		BOOST_CHECK_EQUAL(vr.x[i].v, ref.x[i].v);
+		BOOST_CHECK_EQUAL(vr.y[i].v, ref.y[i].v);
+		BOOST_CHECK_EQUAL(vr.z[i].v, ref.z[i].v);
+	}
+
+	std::vector<float> f(n), g(n);
+	for (size_t i = 0; i < n; ++i) f[i] = ((int)(i * 7919 % 2001) - 1000) * 0.37f;
+	gma::convert(&f[0], &r[0], n);
+	gma::convert(&r[0], &g[0], n);
+	for (size_t i = 0; i < n; ++i) {
+		BOOST_CHECK_EQUAL(r[i].v, F(f[i]).v);
+		BOOST_CHECK_EQUAL(g[i], (float)r[i]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fixed_point_batch)
+{
+	check_fixed_point_batch<gma::fixed_point<16,16> >();
+	check_fixed_point_batch<gma::fixed_point<24,8> >();
+}
+
+/// Checks the bvh queries against testing every sphere, before and after
+/// the spheres move and the tree is refit.
+BOOST_AUTO_TEST_CASE(bvh)
+{
+	const size_t n = 1000;
+	std::vector<sphere3f> s(n);
+	uint32_t seed = 4321;
+	for (size_t i = 0; i < n; ++i) {
+		float p[4];
+		for (int k = 0; k < 4; ++k) { seed = seed * 1664525 + 1013904223; p[k] = (seed >> 8) * (1.0f / (1 << 24)); }
+		s[i] = sphere3f(vector3f(p[0], p[1], p[2]) * 100.0f, 0.2f + p[3] * 2);
+	}
+	bvhf t(&s[0], n);
+	BOOST_CHECK(t.nodes.size() < 2*n);
+
+	for (int pass = 0; pass < 2; ++pass) {
+		size_t hits = 0;
+		for (int k = 0; k < 200; ++k) {
+			line3f l(vector3f(k % 7 * 15.0f, -10, k % 11 * 9.0f), vector3f(k % 5 - 2.0f, 4, k % 3 - 1.0f));
+			bool expected = false;
+			size_t index = 0;
+			float best = 0, t0;
+			for (size_t i = 0; i < n; ++i)
+				if (gma::intersect(l, s[i], t0) && (!expected || t0 < best)) { expected = true; best = t0; index = i; }
+			bvhf::hit h;
+			BOOST_CHECK_EQUAL(t.first_hit(l, h), expected);
+			BOOST_CHECK_EQUAL(t.any_hit(l), expected);
+			if (expected && t.first_hit(l, h)) {
+				BOOST_CHECK_CLOSE(h.t, best, 1e-4f);
+				BOOST_CHECK(h.index == index || gma::intersect(l, s[h.index], t0));
+				BOOST_CHECK_EQUAL(t.any_hit(l, best * 0.999f), false);
+				++hits;
+			}
+		}
+		BOOST_CHECK(hits > 20 && hits < 200);
+
+		for (size_t k = 0; k < 50; ++k) {
+			sphere3f q(s[k*17].c + vector3f(1, -2, 0.5f), 5);
+			std::vector<size_t> r;
+			t.overlap(q, r);
+			std::sort(r.begin(), r.end());
+			std::vector<size_t> expected;
+			for (size_t i = 0; i < n; ++i)
+				if (gma::intersects(q, s[i]))
+					expected.push_back(i);
+			BOOST_CHECK(r == expected);
+		}
+
+		for (size_t i = 0; i < n; ++i) {
+			s[i].c += vector3f(float(i % 13) - 6, float(i % 5) - 2, float(i % 9) - 4);
+			s[i].r *= 1.5f;
+		}
+		t.refit(&s[0]);
+	}
+}
+
+/// Checks the ray-sphere batches against the scalar test, for one ray and
+/// many spheres and vice versa, including the rays starting inside a sphere.
+template <typename T> void check_intersect_batch()
+{
+	typedef gma::vector3<T> V;
+	const size_t n = 203;
+	std::vector<gma::sphere<V> > s(n);
+	std::vector<gma::line<V> > l(n);
+	for (size_t i = 0; i < n; ++i) {
+		s[i] = gma::sphere<V>(V(T(i*37 % 101) / 10 - 5, T(i*53 % 89) / 10 - 4, T(i*29 % 113) / 10), T(i % 7 + 1) / 4);
+		l[i] = gma::line<V>(V(T(i % 11) - 5, T(i % 5) - 2, -1), V(T(i*7 % 13) / 13 - T(0.5), T(i*3 % 7) / 7 - T(0.5), 1));
+	}
+	std::vector<T> t(n);
+	std::vector<uint64_t> mask((n+63)/64);
+
+	const gma::line<V> ray(V(0, 0, -1), V(T(0.1), T(-0.05), 1));
+	size_t hits = gma::intersect(ray, &s[0], n, &t[0], &mask[0]), expected = 0;
+	for (size_t i = 0; i < n; ++i) {
+		T t0;
+		bool hit = gma::intersect(ray, s[i], t0);
+		expected += hit;
+		BOOST_CHECK_EQUAL((mask[i/64] >> (i%64)) & 1, (uint64_t)hit);
+		if (hit) BOOST_CHECK_CLOSE(t[i], t0, 1e-3);
+	}
+	BOOST_CHECK_EQUAL(hits, expected);
+
+	const gma::sphere<V> sphere(V(0, 0, 4), 3);
+	hits = gma::intersect(&l[0], n, sphere, &t[0], &mask[0]);
+	expected = 0;
+	for (size_t i = 0; i < n; ++i) {
+		T t0;
+		bool hit = gma::intersect(l[i], sphere, t0);
+		expected += hit;
+		BOOST_CHECK_EQUAL((mask[i/64] >> (i%64)) & 1, (uint64_t)hit);
+		if (hit) BOOST_CHECK_CLOSE(t[i], t0, 1e-3);
+	}
+	BOOST_CHECK_EQUAL(hits, expected);
+	BOOST_CHECK(hits > 0 && hits < n);
+
+	// Rays starting inside the sphere hit at 0.
+	l[0].p = l[5].p = sphere.c;
+	gma::intersect(&l[0], 8, sphere, &t[0], &mask[0]);
+	BOOST_CHECK_EQUAL(mask[0] & 0x21, 0x21u);
+	BOOST_CHECK_EQUAL(t[0], T(0));
+	BOOST_CHECK_EQUAL(t[5], T(0));
+}
+
+BOOST_AUTO_TEST_CASE(intersect_batch)
+{
+	check_intersect_batch<float>();
+	check_intersect_batch<double>();
+}
+
+/// Returns the overlapping pairs among the spheres found by b, sorted.
+static std::vector<std::pair<uint32_t,uint32_t> > broad_phase_pairs(const broad_phasef& b)
+{
+	std::vector<std::vector<broad_phasef::pair> > out;
+	b.pairs(out);
+	std::vector<std::pair<uint32_t,uint32_t> > r;
+	for (size_t w = 0; w < out.size(); ++w)
+		for (size_t k = 0; k < out[w].size(); ++k)
+			r.push_back(std::make_pair(out[w][k].a, out[w][k].b));
+	std::sort(r.begin(), r.end());
+	return r;
+}
+
+/// Checks the broad phase against testing all pairs, after the build, after
+/// an update that moves a few spheres to other cells, and after one that
+/// moves enough of them to rebuild the grid.
+static void check_broad_phase(size_t grain, unsigned workers)
+{
+	const size_t n = 3000;
+	std::vector<sphere3f> s(n);
+	uint32_t seed = 777;
+	for (size_t i = 0; i < n; ++i) {
+		float p[4];
+		for (int k = 0; k < 4; ++k) { seed = seed * 1664525 + 1013904223; p[k] = (seed >> 8) * (1.0f / (1 << 24)); }
+		s[i] = sphere3f(vector3f(p[0], p[1], p[2]) * 60.0f - 30.0f, 0.1f + p[3]);
+	}
+
+	broad_phasef b(4);
+	b.grain = grain;
+	b.max_moved = 100;
+	b.build(&s[0], n);
+	BOOST_CHECK_EQUAL(b.size(), n);
+	std::vector<std::vector<broad_phasef::pair> > out;
+	b.pairs(out);
+	BOOST_CHECK_EQUAL(out.size(), workers);
+	BOOST_CHECK_CLOSE(b.cell_size, 2.2f, 5.0f);
+
+	for (int pass = 0; pass < 3; ++pass) {
+		std::vector<std::pair<uint32_t,uint32_t> > expected;
+		for (uint32_t i = 0; i < n; ++i)
+			for (uint32_t j = i + 1; j < n; ++j)
+				if (gma::intersects(s[i], s[j]))
+					expected.push_back(std::make_pair(i, j));
+		BOOST_CHECK(broad_phase_pairs(b) == expected);
+		BOOST_CHECK(expected.size() > 100);
+
+		// Move every 40th sphere at first, then every other one.
+		size_t step = pass == 0 ? 40 : 2;
+		for (size_t i = 0; i < n; i += step)
+			s[i].c += vector3f(0.7f, -1.3f, 0.4f);
+		BOOST_CHECK_EQUAL(b.update(&s[0]), pass > 0);
+		BOOST_CHECK(pass > 0 || !b.moved.empty());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(broad_phase)
+{
+	// Fewer spheres than the default grain run on the calling thread, a
+	// lower grain splits building, updating and finding the pairs across
+	// the workers.
+	check_broad_phase(gma::broad_phase_grain, 1);
+	check_broad_phase(256, 4);
+	check_broad_phase(1000, 3);
+}
+
+/// Checks the alignment of the aligned wrapper, allocator and arena, and that
+/// the wrapper adds no padding where the size is already a multiple of it.
+BOOST_AUTO_TEST_CASE(aligned)
+{
+	struct members { char c; GAMMA_ALIGN(64) matrix4f m; gma::aligned<vector4f,32> v; };
+	BOOST_CHECK_EQUAL(offsetof(members, m) % 64, 0u);
+	BOOST_CHECK_EQUAL(offsetof(members, v) % 32, 0u);
+	BOOST_CHECK_EQUAL(sizeof(gma::aligned<matrix4f,64>), sizeof(matrix4f));
+	BOOST_CHECK_EQUAL(sizeof(gma::aligned<vector4f,16>), sizeof(vector4f));
+	BOOST_CHECK_EQUAL(sizeof(gma::aligned<vector3f,16>), 16u);
+
+	gma::aligned<matrix4f,32> a(matrix4f(2)), b;
+	*b = *a * *a;
+	BOOST_CHECK_EQUAL(b->m00, 4);
+	BOOST_CHECK_EQUAL(((const matrix4f&)b).m33, 4);
+
+	std::vector<gma::aligned<vector4f,32>, gma::aligned_allocator<gma::aligned<vector4f,32>,32> > va(5);
+	for (size_t i = 0; i < va.size(); ++i)
+		BOOST_CHECK_EQUAL((uintptr_t)&va[i] % 32, 0u);
+
+	std::vector<matrix4f, gma::aligned_allocator<matrix4f,64> > vm(7, matrix4f(1));
+	BOOST_CHECK_EQUAL((uintptr_t)&vm[0] % 64, 0u);
+	vm.resize(1000);
+	BOOST_CHECK_EQUAL((uintptr_t)&vm[999] % 64, 0u);
+	BOOST_CHECK_EQUAL(vm[6].m22, 1);
+
+	gma::arena arena(4096);
+	for (int pass = 0; pass < 2; ++pass) {
+		char* c = arena.allocate<char,1>(3);
+		vector4f* v = arena.allocate<vector4f>(10);
+		matrix4f* m = arena.allocate<matrix4f,64>(100);
+		BOOST_CHECK(c != 0);
+		BOOST_CHECK_EQUAL((uintptr_t)v % GAMMA_SIMD_ALIGNMENT, 0u);
+		BOOST_CHECK_EQUAL((uintptr_t)m % 64, 0u);
+		BOOST_CHECK(v[9] == vector4f(0));
+		m[99] = matrix4f(3);
+		arena.reset();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(binary)
+{
+	typedef gma::fixed_point<16,16> fixed16_16;
+	std::vector<matrix4f> m(100);
+	std::vector<sphere3d> s(10);
+	std::vector<fixed16_16 > f(3);
+	for (size_t i = 0; i < m.size(); ++i) m[i] = matrix4f(float(i)) * 0.5f;
+	for (size_t i = 0; i < s.size(); ++i) s[i] = sphere3d(vector3d(i, -1.5, 2), 0.25 * i);
+	f[0] = 1.5; f[1] = -2.25; f[2] = 1000;
+
+	std::stringstream ss;
+	BOOST_CHECK(gma::binary::write(ss, &m[0], m.size()));
+	BOOST_CHECK(gma::binary::write(ss, &s[0], s.size()));
+	BOOST_CHECK(gma::binary::write(ss, &f[0], f.size()));
+	BOOST_CHECK_EQUAL(ss.str().size(), gma::binary::size<matrix4f>(100) + gma::binary::size<sphere3d>(10) + gma::binary::size<fixed16_16 >(3));
+
+	std::vector<matrix4f> rm;
+	std::vector<sphere3d> rs;
+	std::vector<fixed16_16 > rf;
+	BOOST_CHECK(gma::binary::read(ss, rm));
+	BOOST_CHECK(gma::binary::read(ss, rs));
+	BOOST_CHECK(gma::binary::read(ss, rf));
+	BOOST_CHECK(!gma::binary::read(ss, rf));
+	BOOST_REQUIRE_EQUAL(rm.size(), m.size());
+	BOOST_REQUIRE_EQUAL(rs.size(), s.size());
+	BOOST_REQUIRE_EQUAL(rf.size(), f.size());
+	BOOST_CHECK_EQUAL(rf[1].v, f[1].v);
+	BOOST_CHECK_EQUAL(memcmp(&rm[0], &m[0], m.size() * sizeof(matrix4f)), 0);
+	BOOST_CHECK(rs[9].c == s[9].c);
+	BOOST_CHECK_EQUAL(rs[9].r, s[9].r);
+
+	// The header stores the layout little-endian, and the elements follow at
+	// an aligned offset, such that an aligned buffer can be viewed in place.
+	std::vector<uint64_t> buffer(gma::binary::size<matrix4f>(100) / 8);
+	BOOST_CHECK_EQUAL(gma::binary::write(&buffer[0], &m[0], m.size()), buffer.size() * 8);
+	const uint8_t* h = (const uint8_t*)&buffer[0];
+	BOOST_CHECK_EQUAL(memcmp(h, "GMAB", 4), 0);
+	BOOST_CHECK_EQUAL(h[4] | h[5] << 8, 1);
+	BOOST_CHECK_EQUAL(h[16], 100);
+	size_t n = 0;
+	const matrix4f* v = gma::binary::view<matrix4f>(&buffer[0], buffer.size() * 8, n);
+	BOOST_REQUIRE(v != 0);
+	BOOST_CHECK_EQUAL(n, 100u);
+	BOOST_CHECK_EQUAL((const void*)v, (const void*)(h + gma::binary::header_size));
+	BOOST_CHECK_EQUAL(memcmp(v, &m[0], n * sizeof(matrix4f)), 0);
+
+	// Mismatching types, truncated data and future versions are rejected.
+	BOOST_CHECK(!gma::binary::view<matrix4d>(&buffer[0], buffer.size() * 8, n));
+	BOOST_CHECK(!gma::binary::view<matrix3f>(&buffer[0], buffer.size() * 8, n));
+	BOOST_CHECK(!gma::binary::view<vector4f>(&buffer[0], buffer.size() * 8, n));
+	BOOST_CHECK(!gma::binary::view<matrix4f>(&buffer[0], buffer.size() * 8 - 1, n));
+	((uint8_t*)&buffer[0])[4] = 2;
+	BOOST_CHECK(!gma::binary::view<matrix4f>(&buffer[0], buffer.size() * 8, n));
+
+	std::vector<uint64_t> fb(gma::binary::size<fixed16_16 >(4) / 8);
+	gma::binary::write(&fb[0], &f[0], f.size());
+	BOOST_CHECK((!gma::binary::view<gma::fixed_point<24,8> >(&fb[0], fb.size() * 8, n)));
+	BOOST_CHECK(!gma::binary::view<int32_t>(&fb[0], fb.size() * 8, n));
+	const fixed16_16* vf = gma::binary::view<fixed16_16 >(&fb[0], fb.size() * 8, n);
+	BOOST_REQUIRE(vf != 0);
+	BOOST_CHECK_EQUAL(n, 3u);
+	BOOST_CHECK_EQUAL((double)vf[1], -2.25);
+}
+
+BOOST_AUTO_TEST_CASE(text)
+{
+	// Bulk formatting round-trips exactly and matches the order of operator<<.
+	std::vector<matrix4f> m(50);
+	std::vector<vector3d> v(50);
+	for (size_t i = 0; i < m.size(); ++i) {
+		for (int k = 0; k < 16; ++k)
+			m[i].v[k] = (float)((i * 16 + k) * 0.1) - 7.3f;
+		v[i] = vector3d(1.0 / (i + 3), -1e-300 * i, 1e300);
+	}
+	m[0] = matrix4f(1.5f);
+	m[0].m03 = 7;
+	std::vector<char> buffer(gma::max_chars<matrix4f>(m.size()));
+	char* end = gma::to_chars(&buffer[0], &buffer[0] + buffer.size(), &m[0], m.size());
+	BOOST_REQUIRE(end != 0);
+	BOOST_CHECK(!gma::to_chars(&buffer[0], end - 1, &m[0], m.size()));
+	std::vector<matrix4f> rm(m.size());
+	BOOST_CHECK(gma::from_chars(&buffer[0], end, &rm[0], rm.size()) != 0);
+	BOOST_CHECK_EQUAL(memcmp(&rm[0], &m[0], m.size() * sizeof(matrix4f)), 0);
+	BOOST_CHECK_EQUAL(std::string(&buffer[0], 10), "1.5 0 0 7 ");
+
+	buffer.resize(gma::max_chars<vector3d>(v.size()));
+	end = gma::to_chars(&buffer[0], &buffer[0] + buffer.size(), &v[0], v.size());
+	BOOST_REQUIRE(end != 0);
+	std::vector<vector3d> rv(v.size());
+	BOOST_CHECK(gma::from_chars(&buffer[0], end, &rv[0], rv.size()) != 0);
+	for (size_t i = 0; i < v.size(); ++i)
+		BOOST_CHECK(rv[i] == v[i]);
+
+	// Commas separate scalars as well, e.g. in CSV, while garbage and
+	// overflow are rejected.
+	const char csv[] = "1.5,-2, 3\n";
+	vector3f c;
+	BOOST_CHECK_EQUAL(gma::from_chars(csv, csv + sizeof(csv) - 1, c), csv + 9);
+	BOOST_CHECK(c == vector3f(1.5, -2, 3));
+	const char bad[] = "1 x 3";
+	BOOST_CHECK(!gma::from_chars(bad, bad + sizeof(bad) - 1, c));
+	const char big[] = "300";
+	uint8_t b;
+	BOOST_CHECK(!gma::from_chars(big, big + 3, b));
+	gma::fixed_point<16,16> f, rf;
+	f = -2.375;
+	char s[32] = {0};
+	end = gma::to_chars(s, s + sizeof(s), f);
+	BOOST_CHECK_EQUAL(std::string(s, end), "-2.375");
+	BOOST_CHECK(gma::from_chars(s, end, rf) == end);
+	BOOST_CHECK_EQUAL(rf.v, f.v);
+
+	// fixed_point is written as its exact decimal expansion, which reads back
+	// unchanged also beyond the 53 bits of a double.
+	f.v = -0x7fffffff - 1;
+	end = gma::to_chars(s, s + sizeof(s), f);
+	BOOST_CHECK_EQUAL(std::string(s, end), "-32768");
+	BOOST_CHECK(gma::from_chars(s, end, rf) == end);
+	BOOST_CHECK_EQUAL(rf.v, f.v);
+	f.v = 1;
+	end = gma::to_chars(s, s + sizeof(s), f);
+	BOOST_CHECK_EQUAL(std::string(s, end), "0.0000152587890625");
+	const char tie[] = "0.00000762939453125", overflow[] = "32768";
+	BOOST_CHECK(gma::from_chars(tie, tie + sizeof(tie) - 1, rf) != 0);
+	BOOST_CHECK_EQUAL(rf.v, 1);
+	BOOST_CHECK(!gma::from_chars(overflow, overflow + sizeof(overflow) - 1, rf));
+#ifdef GAMMA_HAS_INT128
+	typedef gma::fixed_point<32,32> fixed32_32;
+	std::vector<char> wide(gma::max_chars<fixed32_32>(3));
+	fixed32_32 w[3], rw[3];
+	w[0].v = 0x7fffffffffffffffll;
+	w[1].v = -0x123456789abcdefll;
+	w[2].v = 3;
+	end = gma::to_chars(&wide[0], &wide[0] + wide.size(), w, 3);
+	BOOST_REQUIRE(end != 0);
+	BOOST_CHECK(gma::from_chars(&wide[0], end, rw, 3) != 0);
+	for (int i = 0; i < 3; ++i)
+		BOOST_CHECK_EQUAL(rw[i].v, w[i].v);
+#endif
+
+	// operator>> reads what operator<< writes.
+	std::stringstream ss;
+	ss << m[1] << '\n' << sphere3f(vector3f(1, 2, 3), 4) << ' ' << line3d(vector3d(1, 2, 3), vector3d(0, 0, 1)) << ' ' << f;
+	matrix4f sm;
+	sphere3f ss3;
+	line3d sl;
+	ss >> sm >> ss3 >> sl >> rf;
+	BOOST_REQUIRE(!ss.fail());
+	BOOST_CHECK_CLOSE(sm.m23, m[1].m23, 1e-4);
+	BOOST_CHECK(ss3.c == vector3f(1, 2, 3));
+	BOOST_CHECK_EQUAL(ss3.r, 4);
+	BOOST_CHECK(sl.d == vector3d(0, 0, 1));
+	BOOST_CHECK_EQUAL(rf.v, f.v);
+	std::istringstream bs("(1 2 3; 4)");
+	bs >> ss3;
+	BOOST_CHECK(bs.fail());
+}
+
+/// Computes the world matrices of a hierarchy naively from the parent ids.
+static matrix4d hierarchy_world(const hierarchyd& h, uint32_t id)
+{
+	uint32_t p = h.parent(id);
+	return p == hierarchyd::none ? h.local(id) : hierarchy_world(h, p) * h.local(id);
+}
+
+static bool hierarchy_matches(const hierarchyd& h)
+{
+	for (size_t l = 0; l + 1 < h.levels.size(); ++l)
+		for (size_t s = h.levels[l]; s < h.levels[l+1]; ++s)
+			if (h.parents[s] != hierarchyd::none && (h.parents[s] < h.levels[l-1] || h.parents[s] >= h.levels[l]))
+				return false;
+	for (uint32_t id = 0; id < h.size(); ++id) {
+		matrix4d w = hierarchy_world(h, id);
+		if (memcmp(&h.world(id), &w, sizeof(matrix4d)) != 0)
+			return false;
+	}
+	return true;
+}
+
+BOOST_AUTO_TEST_CASE(hierarchy)
+{
+	// A few roots with random descendants, added in id rather than
+	// breadth-first order, with levels wide enough to be split across
+	// workers.
+	const size_t n = 4 * gma::hierarchy_grain;
+	hierarchyd h(4);
+	uint32_t seed = 1;
+	for (uint32_t i = 0; i < n; ++i) {
+		seed = seed * 1664525 + 1013904223;
+		uint32_t parent = i < 3 ? (uint32_t)hierarchyd::none : (seed >> 8) % i;
+		matrix4d m = (matrix4d)gma::transform::translation<double>(vector3d(i % 7, 1, -(double)(i % 5)));
+		m = m * (matrix4d)gma::transform::z_rotation<double>(i * 0.1).update();
+		BOOST_CHECK_EQUAL(h.add(m, parent), i);
+	}
+	h.update();
+	BOOST_CHECK_EQUAL(h.levels.back(), n);
+	BOOST_CHECK(h.levels.size() > 4);
+	BOOST_CHECK(hierarchy_matches(h));
+
+	// Only the changed subtrees are recomputed: a node outside of them keeps
+	// a clobbered world matrix.
+	uint32_t other = 0;
+	for (uint32_t id = 3; id < n && !other; ++id) {
+		other = id;
+		for (uint32_t p = id; p != hierarchyd::none; p = h.parent(p))
+			if (p == 5 || p == n-2) other = 0;
+	}
+	matrix4d saved = h.world(other);
+	h.world_matrices[h.slots[other]] = matrix4d(0);
+	h.set_local(5, (matrix4d)gma::transform::translation<double>(vector3d(0, 0, 2)));
+	h.set_local(n-2, (matrix4d)gma::transform::translation<double>(vector3d(3, 0, 0)));
+	h.update();
+	BOOST_CHECK_EQUAL(h.world(other).m33, 0);
+	h.world_matrices[h.slots[other]] = saved;
+	BOOST_CHECK(hierarchy_matches(h));
+
+	// Reparenting reorders the nodes, and cycles are refused.
+	uint32_t root = n-1;
+	while (h.parent(root) != hierarchyd::none) root = h.parent(root);
+	BOOST_CHECK(!h.set_parent(root, n-1));
+	BOOST_CHECK(h.set_parent(7, 3));
+	BOOST_CHECK(h.set_parent(4, hierarchyd::none));
+	h.update();
+	BOOST_CHECK_EQUAL(h.parent(7), 3u);
+	BOOST_CHECK(hierarchy_matches(h));
+	h.add(matrix4d(2), 7);
+	h.update();
+	BOOST_CHECK(hierarchy_matches(h));
+}
+
+/// Compares skin against blending the transformed positions and normals of
+/// each bone, for meshes with and without normals.
+template <typename T> static void check_skinning(int influences, size_t n, unsigned workers)
+{
+	std::vector<gma::matrix4<T> > palette(11);
+	for (size_t b = 0; b < palette.size(); ++b) {
+		gma::transform::axial_rotation<T> r(gma::vector3<T>(b*0.3, -(T)b*0.2, 0.5));
+		palette[b] = (gma::matrix4<T>)gma::transform::translation<T>(gma::vector3<T>(b, 1, -(T)b)) * (gma::matrix4<T>)r.update();
+	}
+	gma::soa3<T> p(n), nrm(n), op, onrm, only;
+	std::vector<uint16_t> bones(n * influences);
+	std::vector<T> weights(n * influences);
+	for (size_t i = 0; i < n; ++i) {
+		p.set(i, gma::vector3<T>((T)(i%17) - 8, (T)(i%5) * 0.5, (T)(i%3)));
+		nrm.set(i, gma::vector3<T>(0, (T)(i%2), (T)(1 - i%2)));
+		for (int k = 0; k < influences; ++k) {
+			bones[i*influences+k] = (uint16_t)((i*7 + k*3) % palette.size());
+			weights[i*influences+k] = (T)(k + 1) / (influences * (influences + 1) / 2);
+		}
+	}
+	gma::skin(&palette[0], influences, &bones[0], &weights[0], p, nrm, op, onrm, workers);
+	gma::skin(&palette[0], influences, &bones[0], &weights[0], p, only, workers);
+	BOOST_REQUIRE_EQUAL(op.size(), n);
+	for (size_t i = 0; i < n; ++i) {
+		gma::vector4<T> rp(0, 0, 0, 0), rn(0, 0, 0, 0);
+		for (int k = 0; k < influences; ++k) {
+			const gma::matrix4<T>& m = palette[bones[i*influences+k]];
+			rp = rp + m * gma::vector4<T>(p[i], 1) * weights[i*influences+k];
+			rn = rn + m * gma::vector4<T>(nrm[i], 0) * weights[i*influences+k];
+		}
+		BOOST_CHECK_SMALL(op[i].x - rp.x, (T)1e-4);
+		BOOST_CHECK_SMALL(op[i].y - rp.y, (T)1e-4);
+		BOOST_CHECK_SMALL(op[i].z - rp.z, (T)1e-4);
+		BOOST_CHECK_SMALL(onrm[i].x - rn.x, (T)1e-4);
+		BOOST_CHECK_SMALL(onrm[i].y - rn.y, (T)1e-4);
+		BOOST_CHECK_SMALL(onrm[i].z - rn.z, (T)1e-4);
+		BOOST_CHECK(only[i] == op[i]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(skinning)
+{
+	for (int k = 1; k <= 4; ++k) {
+		check_skinning<float>(k, 23, 0);
+		check_skinning<double>(k, 23, 0);
+	}
+	check_skinning<float>(4, 2 * gma::skinning_grain + 5, 3);
+}
+
+/// Round-trips the n floats in f through I and returns the largest error. The
+/// SIMD and scalar paths may differ by one step where the latter is fused.
+template <typename I> float packed_error(const std::vector<float>& f)
+{
+	std::vector<I> q(f.size());
+	std::vector<float> r(f.size());
+	gma::pack(&f[0], f.size(), &q[0]);
+	gma::unpack(&q[0], q.size(), &r[0]);
+	float e = 0;
+	for (size_t i = 0; i < f.size(); ++i) {
+		BOOST_CHECK_LE(std::abs((int)q[i] - (int)gma::detail::quantize<I>(f[i])), 1);
+		e = std::max(e, std::abs(r[i] - f[i]));
+	}
+	return e;
+}
+
+BOOST_AUTO_TEST_CASE(packed)
+{
+	// Odd sizes exercise the scalar tails behind the SIMD loops.
+	std::vector<float> s(1003), u(1003);
+	for (size_t i = 0; i < s.size(); ++i) {
+		s[i] = std::sin(i * 0.37f) * 1.01f;
+		u[i] = std::abs(s[i]);
+	}
+	for (size_t i = 0; i < s.size(); ++i) {
+		s[i] = std::max(-1.0f, std::min(1.0f, s[i]));
+		u[i] = std::min(1.0f, u[i]);
+	}
+	s[0] = -1; s[1] = 1; s[2] = 0; s[3] = 0.5f;
+	BOOST_CHECK_LE(packed_error<int8_t>(s), 0.5f / 127 * 1.0001f);
+	BOOST_CHECK_LE(packed_error<int16_t>(s), 0.5f / 32767 * 1.0001f);
+	BOOST_CHECK_LE(packed_error<uint8_t>(u), 0.5f / 255 * 1.0001f);
+	BOOST_CHECK_LE(packed_error<uint16_t>(u), 0.5f / 65535 * 1.0001f);
+
+	// Out of range values are clamped, and the smallest snorm decodes to -1.
+	float cf[5] = { -2, 2, -1, 1, 0 };
+	int8_t cs[5];
+	uint16_t cu[5];
+	gma::pack(cf, 5, cs);
+	gma::pack(cf, 5, cu);
+	BOOST_CHECK_EQUAL(cs[0], -127);
+	BOOST_CHECK_EQUAL(cs[1], 127);
+	BOOST_CHECK_EQUAL(cu[0], 0);
+	BOOST_CHECK_EQUAL(cu[1], 65535);
+	cs[4] = -128;
+	gma::unpack(cs, 5, cf);
+	BOOST_CHECK_EQUAL(cf[0], -1);
+	BOOST_CHECK_EQUAL(cf[2], -1);
+	BOOST_CHECK_EQUAL(cf[3], 1);
+	BOOST_CHECK_EQUAL(cf[4], -1);
+
+	// Half floats, including the overflow, subnormal and special cases.
+	std::vector<float> h(1003);
+	for (size_t i = 0; i < h.size(); ++i)
+		h[i] = std::sin(i * 0.37f) * std::pow(2.0f, (float)(i % 40) - 26);
+	h[0] = 65504; h[1] = 65520; h[2] = -1e-7f; h[3] = 6e-5f; h[4] = 1.0f / 0.0f;
+	std::vector<gma::half> hq(h.size());
+	std::vector<float> hr(h.size());
+	gma::pack(&h[0], h.size(), &hq[0]);
+	gma::unpack(&hq[0], hq.size(), &hr[0]);
+	for (size_t i = 0; i < h.size(); ++i) {
+		BOOST_CHECK_EQUAL(hq[i].bits, gma::half(h[i]).bits);
+		BOOST_CHECK_EQUAL(hr[i], (float)hq[i]);
+		if (i != 1 && i != 4)
+			BOOST_CHECK_LE(std::abs(hr[i] - h[i]), std::max(std::abs(h[i]) / 2048, std::pow(2.0f, -25.0f)));
+	}
+	BOOST_CHECK_EQUAL(hq[0].bits, 0x7bff);
+	BOOST_CHECK_EQUAL(hq[1].bits, 0x7c00);
+	BOOST_CHECK_EQUAL(hq[4].bits, 0x7c00);
+	BOOST_CHECK_EQUAL(gma::half(std::sqrt(-1.0f)).bits & 0x7fff, 0x7e00);
+
+	// Componentwise vectors.
+	vector4f c[3] = { vector4f(0, 0.25, 0.5, 1), vector4f(1, 1, 0, 0), vector4f(0.2, 0.4, 0.6, 0.8) }, cr[3];
+	vector4b cq[3];
+	gma::pack(c, 3, cq);
+	BOOST_CHECK_EQUAL(cq[0].y, 64);
+	BOOST_CHECK_EQUAL(cq[0].w, 255);
+	gma::unpack(cq, 3, cr);
+	for (int i = 0; i < 3; ++i)
+		BOOST_CHECK_SMALL((cr[i] - c[i]).length(), 1.0 / 255);
+
+	// Octahedral normals, over all octants and near the folds.
+	std::vector<vector3f> n(1003), nr(n.size());
+	for (size_t i = 0; i < n.size(); ++i)
+		n[i] = vector3f(std::sin(i * 0.7f), std::cos(i * 1.3f), std::sin(i * 0.11f) * (i % 5 == 0 ? 1e-4f : 1)).normalized();
+	n[0] = vector3f(0, 0, -1); n[1] = vector3f(0, 0, 1); n[2] = vector3f(-1, 0, 0);
+	std::vector<gma::octahedral> o(n.size());
+	gma::pack(&n[0], n.size(), &o[0]);
+	gma::unpack(&o[0], o.size(), &nr[0]);
+	for (size_t i = 0; i < n.size(); ++i) {
+		gma::octahedral e(n[i]);
+		BOOST_CHECK_LE(std::abs(o[i].u - e.u) + std::abs(o[i].v - e.v), 1);
+		BOOST_CHECK_SMALL(nr[i].length() - 1, 1e-6);
+		BOOST_CHECK_LE(std::atan2(n[i].cross(nr[i]).length(), n[i].dot(nr[i])), 6.5e-5f);
+	}
+	BOOST_CHECK(nr[0] == n[0]);
+	BOOST_CHECK(nr[1] == n[1]);
+}